@@ -5,15 +5,17 @@
 #include <NeedlemanWunsh.h>
 
 #include "Alignment.h"
+#include "IsolateMutation.h"
 
 #include <algorithm>
 
 Alignment Alignment::compute(const ReferenceSequence& ref,
 			     const seq::NTSequence&   target,
 			     seq::AlignmentAlgorithm* algorithm,
-			     int maxFrameShifts)
+			     int maxFrameShifts,
+			     const seq::CodonReference* codonRef)
 {
-  seq::CodonAlign codonAlign(algorithm);
+  seq::CodonAlign codonAlign(algorithm, codonRef);
   Alignment result(ref, target);
 
   for (unsigned j = 0; j < result.target.size(); ++j)
@@ -22,44 +24,111 @@ Alignment Alignment::compute(const ReferenceSequence& ref,
       --j;
     }
 
-  try {
-    if (result.target.size() > 6) {
-      std::pair<double, int> res
-	= codonAlign.align(result.ref, result.target, maxFrameShifts);
+  if (result.target.size() > 6)
+    result.codonAlign(codonAlign, maxFrameShifts, 0, 0, 0);
+  else
+    result.tooShort = true;
 
-      result.score = res.first;
-      result.correctedFrameshifts = res.second;
-      result.success = true;
-    } else
+  result.computeAlignedRanges();
+
+  return result;
+}
+
+void Alignment::compute(const ReferenceSequence& ref,
+			const std::vector<seq::NTSequence>& targets,
+			seq::AlignmentAlgorithm* algorithm,
+			int maxFrameShifts,
+			std::vector<Alignment>& results,
+			const seq::CodonReference* codonRef)
+{
+  seq::CodonAlign codonAlign(algorithm, codonRef);
+
+  const unsigned first = results.size();
+  std::vector<seq::NTSequence> ntAlignedTargets;
+  std::vector<unsigned> aligned;
+
+  for (unsigned i = 0; i < targets.size(); ++i) {
+    results.push_back(Alignment(ref, targets[i]));
+    Alignment& result = results.back();
+
+    for (unsigned j = 0; j < result.target.size(); ++j)
+      if (result.target[j] == seq::Nucleotide::GAP) {
+	result.target.erase(result.target.begin() + j);
+	--j;
+      }
+
+    double maxScore;
+    if (result.target.size() <= 6)
       result.tooShort = true;
-  } catch (seq::AlignmentError e) {
-    result.failure = true;
-    std::cerr << e.nucleotideAlignedTarget().name() << ": " << e.message()
-      << " (scores nt: " << e.nucleotideAlignmentScore() << "; codon: "
-      << e.codonAlignmentScore() << ")" << std::endl;
+    else if (codonAlign.tooDifferent(ref, result.target, maxScore))
+      result.codonAlign(codonAlign, maxFrameShifts, 0, 0, 0); // rejected
+    else {
+      ntAlignedTargets.push_back(result.target);
+      aligned.push_back(first + i);
+    }
   }
 
-  result.computeAlignedRanges(ref.size()/3);
+  std::vector<seq::NTSequence> ntAlignedRefs;
+  std::vector<double> ntScores;
+  algorithm->alignBatch(ref, ntAlignedTargets, ntAlignedRefs, ntScores);
 
-  return result;
+  for (unsigned k = 0; k < aligned.size(); ++k)
+    results[aligned[k]].codonAlign(codonAlign, maxFrameShifts,
+				   &ntAlignedRefs[k], &ntAlignedTargets[k],
+				   ntScores[k]);
+
+  for (unsigned i = first; i < results.size(); ++i)
+    results[i].computeAlignedRanges();
+}
+
+/*
+ * Codon align the (ungapped) target, starting from the given nucleotide
+ * alignment if any.
+ */
+void Alignment::codonAlign(seq::CodonAlign& codonAlign, int maxFrameShifts,
+			   const seq::NTSequence *ntAlignedRef,
+			   const seq::NTSequence *ntAlignedTarget,
+			   double ntScore)
+{
+  try {
+    seq::NTSequence alignedRef = *reference_;
+    std::pair<double, int> res = ntAlignedRef
+      ? codonAlign.align(alignedRef, target, maxFrameShifts,
+			 *ntAlignedRef, *ntAlignedTarget, ntScore)
+      : codonAlign.align(alignedRef, target, maxFrameShifts);
+
+    setAlignedRef(alignedRef);
+    score = res.first;
+    correctedFrameshifts = res.second;
+    success = true;
+  } catch (seq::AlignmentError e) {
+    failure = true;
+    std::ostringstream line;
+    line << e.nucleotideAlignedTarget().name() << ": " << e.message()
+	 << " (scores nt: " << e.nucleotideAlignmentScore() << "; codon: "
+	 << e.codonAlignmentScore() << ")";
+    log_line(line.str());
+  }
 }
 
 Alignment Alignment::given(const ReferenceSequence& ref,
+			   const seq::NTSequence&   alignedRef,
 			   const seq::NTSequence&   target)
 {
-  if (ref.size() != target.size()) {
-    std::cerr << ref.name() << ".length: " << ref.size()
+  if (alignedRef.size() != target.size()) {
+    std::cerr << ref.name() << ".length: " << alignedRef.size()
 	      << ", " << target.name() << ".length: " << target.size()
 	      << std::endl;
 
-    assert(ref.size() == target.size());
+    assert(alignedRef.size() == target.size());
   }
 
   Alignment result(ref, target);
 
+  result.setAlignedRef(alignedRef);
   result.success = true;
 
-  result.computeAlignedRanges(ref.size()/3);
+  result.computeAlignedRanges();
 
   return result;
 }
@@ -70,212 +139,401 @@ Alignment::Alignment(const ReferenceSequence& aref,
     tooShort(false),
     failure(false),
     correctedFrameshifts(0),
-    ref(aref),
-    target(atarget)    
+    score(0),
+    target(atarget),
+    reference_(&aref)
 { }
 
-void Alignment::computeAlignedRanges(int referenceSequenceLength)
+void Alignment::setAlignedRef(const seq::NTSequence& alignedRef)
 {
-  for (unsigned r = 0; r < ref.regions().size(); ++r) {
-    ReferenceSequence::Region& region = ref.regions()[r];
-
-    int regionEnd = std::min(region.end(), referenceSequenceLength);
-
-    if (success) {
-      region.alignedBegin  = alignedPos(region.begin());
-      region.alignedEnd    = alignedPos(regionEnd);
-      region.targetBegin = firstPos(region.begin(), regionEnd);
-      region.targetEnd   = lastPos(region.begin(), regionEnd);
-    } else {
-      region.alignedBegin = region.begin();
-      region.alignedEnd   = regionEnd;
-      region.targetBegin = ref.size();
-      region.targetEnd   = -1;
+  refGaps_.clear();
+
+  for (unsigned i = 0; i < alignedRef.size(); ++i)
+    if (alignedRef[i] == seq::Nucleotide::GAP) {
+      unsigned j = i;
+      while (j < alignedRef.size() && alignedRef[j] == seq::Nucleotide::GAP)
+	++j;
+      addRefGap(i, j - i);
+      i = j;
     }
-  }
+
+  assert(alignedRefSize() == alignedRef.size());
 }
 
-int Alignment::alignedPos(int refPos) const
+void Alignment::addRefGap(int alignedIndex, int length)
 {
-  int j = -1;
-  for (unsigned i = 0; i < ref.size(); i += 3) {
-    if (ref[i] != seq::Nucleotide::GAP)
-      ++j;
+  GapRun run;
+  run.alignedIndex = alignedIndex;
+  run.length = length;
+  run.refIndex = alignedIndex - (alignedRefSize() - reference_->size());
 
-    if (j == refPos)
-      return i/3;
-  }
-  if (j == refPos - 1)
-    return ref.size() / 3;
+  refGaps_.push_back(run);
+}
+
+unsigned Alignment::alignedRefSize() const
+{
+  if (refGaps_.empty())
+    return reference_->size();
   else {
-    std::cerr << refPos << " " << ref.size() << " " << j << std::endl;
-    assert(false);
+    const GapRun& last = refGaps_.back();
+    return reference_->size()
+      + last.alignedIndex + last.length - last.refIndex;
   }
 }
 
-int Alignment::firstPos(int begin, int end) const
+namespace {
+  struct ByAlignedIndex {
+    template <class Run>
+    bool operator()(int index, const Run& run) const {
+      return index < run.alignedIndex;
+    }
+  };
+
+  struct ByRefIndex {
+    template <class Run>
+    bool operator()(int index, const Run& run) const {
+      return index < run.refIndex;
+    }
+  };
+
+  const seq::NTSequence& gapCodon()
+  {
+    static const seq::NTSequence result("", "", "---");
+    return result;
+  }
+}
+
+int Alignment::refIndex(int alignedIndex) const
 {
-  int refPos = -1;
+  std::vector<GapRun>::const_iterator i
+    = std::upper_bound(refGaps_.begin(), refGaps_.end(), alignedIndex,
+		       ByAlignedIndex());
+  if (i == refGaps_.begin())
+    return alignedIndex;
+
+  --i;
+  if (alignedIndex < i->alignedIndex + i->length)
+    return -1;
+  else
+    return alignedIndex - (i->alignedIndex + i->length - i->refIndex);
+}
 
-  for (unsigned i = 0; i < ref.size(); i += 3) {
-    if (ref[i] != seq::Nucleotide::GAP)
-      ++refPos;
+int Alignment::alignedIndex(int refIndex) const
+{
+  std::vector<GapRun>::const_iterator i
+    = std::upper_bound(refGaps_.begin(), refGaps_.end(), refIndex,
+		       ByRefIndex());
+  if (i == refGaps_.begin())
+    return refIndex;
+
+  --i;
+  return refIndex + (i->alignedIndex + i->length - i->refIndex);
+}
 
-    if (refPos >= begin) {
-      if (refPos >= end)
-	return end;
+seq::NTSequence::const_iterator Alignment::refCodon(int alignedIndex) const
+{
+  int i = refIndex(alignedIndex);
+  if (i < 0)
+    return gapCodon().begin();
+  else
+    return reference_->begin() + i;
+}
 
-      if (target[i] != seq::Nucleotide::GAP)
-	return refPos;
-    }
+seq::NTSequence Alignment::alignedRef() const
+{
+  seq::NTSequence result;
+  result.setName(reference_->name());
+  result.setDescription(reference_->description());
+  result.reserve(alignedRefSize());
+
+  unsigned next = 0;
+  for (unsigned k = 0; k < refGaps_.size(); ++k) {
+    const GapRun& run = refGaps_[k];
+    result.insert(result.end(), reference_->begin() + next,
+		  reference_->begin() + run.refIndex);
+    result.insert(result.end(), run.length, seq::Nucleotide::GAP);
+    next = run.refIndex;
   }
+  result.insert(result.end(), reference_->begin() + next, reference_->end());
 
-  return end;
+  return result;
 }
 
-int Alignment::lastPos(int begin, int end) const
+void Alignment::computeAlignedRanges()
 {
-  int refPos = -1;
-  int lastPos = -1;
+  int referenceSequenceLength = reference_->size() / 3;
+  int refLength = (reference_->size() + 2) / 3;
+
+  /*
+   * A single pass over the alignment finds for each reference position
+   * whether the target covers the start, resp. end, of a codon that is
+   * aligned to it (or to an insertion that follows it).
+   */
+  std::vector<int> firstCovered, lastCovered;
+
+  if (success) {
+    std::vector<bool> startCovered(refLength, false);
+    std::vector<bool> endCovered(refLength, false);
+
+    int p = -1;
+    unsigned size = alignedRefSize();
+    for (unsigned i = 0; i < size; i += 3) {
+      if (!refGapAt(i))
+	++p;
+
+      if (p >= 0) {
+	if (target[i] != seq::Nucleotide::GAP)
+	  startCovered[p] = true;
+	if (target[i+2] != seq::Nucleotide::GAP)
+	  endCovered[p] = true;
+      }
+    }
 
-  for (unsigned i = 0; i < ref.size(); i += 3) {
-    if (ref[i] != seq::Nucleotide::GAP)
-      ++refPos;
+    /*
+     * firstCovered[p]: first covered position >= p (or refLength),
+     * lastCovered[p]: last covered position <= p (or -1)
+     */
+    firstCovered.resize(refLength + 1);
+    lastCovered.resize(refLength);
 
-    if (refPos >= begin) {
-      if (refPos >= end)
-	return lastPos;
+    firstCovered[refLength] = refLength;
+    for (int p = refLength - 1; p >= 0; --p)
+      firstCovered[p] = startCovered[p] ? p : firstCovered[p + 1];
 
-      if (target[i+2] != seq::Nucleotide::GAP)
-	lastPos = refPos;
+    for (int p = 0; p < refLength; ++p)
+      lastCovered[p] = endCovered[p] ? p : (p > 0 ? lastCovered[p - 1] : -1);
+  }
+
+  regions_.clear();
+  for (unsigned r = 0; r < reference_->regions().size(); ++r) {
+    const ReferenceSequence::Region& region = reference_->regions()[r];
+    AlignedRegion aligned;
+
+    int regionEnd = std::min(region.end(), referenceSequenceLength);
+
+    if (success) {
+      aligned.alignedBegin  = alignedPos(region.begin());
+      aligned.alignedEnd    = alignedPos(regionEnd);
+
+      int first = region.begin() < refLength
+	? firstCovered[region.begin()] : refLength;
+      aligned.targetBegin = std::min(first, regionEnd);
+
+      int last = regionEnd > 0
+	? lastCovered[std::min(regionEnd, refLength) - 1] : -1;
+      aligned.targetEnd = last >= region.begin() ? last : -1;
+    } else {
+      aligned.alignedBegin = region.begin();
+      aligned.alignedEnd   = regionEnd;
+      aligned.targetBegin = reference_->size();
+      aligned.targetEnd   = -1;
     }
+
+    regions_.push_back(aligned);
   }
+}
+
+int Alignment::alignedPos(int refPos) const
+{
+  int refLength = (reference_->size() + 2) / 3;
 
-  return lastPos;
+  if (refPos < refLength)
+    return alignedIndex(refPos * 3) / 3;
+  else if (refPos == refLength)
+    return alignedRefSize() / 3;
+  else {
+    std::cerr << refPos << " " << alignedRefSize() << " "
+	      << refLength << std::endl;
+    assert(false);
+    return alignedRefSize() / 3;
+  }
 }
 
 std::pair<bool, int>
-Alignment::findAminoAcid(const ReferenceSequence::Region& region,
-			 int posInRegion, int insertion) const
+Alignment::findAminoAcid(unsigned r, int posInRegion, int insertion) const
 {
+  const ReferenceSequence::Region& region = reference_->regions()[r];
+  const AlignedRegion& aligned = regions_[r];
+
   bool withinTarget
-    = ((region.targetBegin < region.targetEnd)
-       && posInRegion >= region.targetBegin - region.begin() + 1
-       && posInRegion <= region.targetEnd   - region.begin() + 1);
+    = ((aligned.targetBegin < aligned.targetEnd)
+       && posInRegion >= aligned.targetBegin - region.begin() + 1
+       && posInRegion <= aligned.targetEnd   - region.begin() + 1);
+
+  if (posInRegion < 1)
+    return std::make_pair(withinTarget, -1);
+
+  int refPos = region.begin() + posInRegion - 1;
+  assert(refPos < (int)(reference_->size() + 2) / 3);
+
+  /*
+   * Insertions are the columns between this and the next reference
+   * position.
+   */
+  int i = alignedPos(refPos) + insertion;
+  int next = alignedPos(refPos + 1);
+
+  if (i < next
+      && i < aligned.alignedEnd
+      && (!withinTarget || (target[i*3] != seq::Nucleotide::GAP)))
+    return std::make_pair(withinTarget, i);
+  else if (next < aligned.alignedEnd)
+    return std::make_pair(withinTarget, -1);
 
-  int pos = 0;
-  int gap = 0;
+  assert(false);
+  return std::make_pair(false, 0);
+}
 
-  for (int i = region.alignedBegin; i < region.alignedEnd; ++i) {
-    if (ref[i*3] != seq::Nucleotide::GAP) {
-      ++pos;
-      gap = 0;
-    } else
-      ++gap;
-
-    if (pos == posInRegion
-	&& gap == insertion
-	&& (!withinTarget || (target[i*3] != seq::Nucleotide::GAP))) {
-      return std::make_pair(withinTarget, i);
-    } else if (pos > posInRegion) {
-      return std::make_pair(withinTarget, -1);
+namespace {
+  /*
+   * The amino acids that a codon may encode, as a bit set.
+   */
+  unsigned translateAll(seq::NTSequence::const_iterator triplet)
+  {
+    if (triplet[0].intRep() <= seq::Nucleotide::NT_T
+	&& triplet[1].intRep() <= seq::Nucleotide::NT_T
+	&& triplet[2].intRep() <= seq::Nucleotide::NT_T)
+      return 1u << seq::Codon::translate(triplet).intRep();
+
+    if (triplet[0] == seq::Nucleotide::GAP
+	&& triplet[1] == seq::Nucleotide::GAP
+	&& triplet[2] == seq::Nucleotide::GAP)
+      return 1u << seq::AminoAcid::AA_GAP;
+
+    unsigned result = 0;
+    std::set<seq::AminoAcid> aas = seq::Codon::translateAll(triplet);
+    for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
+	 k != aas.end(); ++k)
+      result |= 1u << k->intRep();
+
+    return result;
+  }
+
+  // the amino acid with the lowest intRep() in the bit set
+  int firstAminoAcid(unsigned aas)
+  {
+    int result = 0;
+    while (!(aas & 1)) {
+      aas >>= 1;
+      ++result;
     }
+
+    return result;
   }
+}
 
-  assert(false);
-  return std::make_pair(false, 0);
+void Alignment::makeMutation(unsigned r, int refPos, int insertion,
+			     unsigned i, unsigned targetAAs,
+			     IsolateMutation& mutation) const
+{
+  seq::NTSequence::const_iterator ref = refCodon(i);
+
+  mutation.region = r;
+  mutation.position = refPos - reference_->regions()[r].begin() + 1;
+  mutation.insertion = insertion;
+  mutation.alignedPos = i / 3;
+  mutation.refAA = seq::Codon::translate(ref);
+  mutation.targetAAs = targetAAs;
+  for (int k = 0; k < 3; ++k) {
+    mutation.refCodon[k] = ref[k];
+    mutation.targetCodon[k] = target[i + k];
+  }
 }
 
-std::string Alignment::mutations(const ReferenceSequence::Region& region) const
+void Alignment::isolateMutations(unsigned r,
+				 std::vector<IsolateMutation>& mutations) const
 {
-  std::string result;
-  int fp    = region.targetBegin;
-  int lp    = region.targetEnd;
+  mutations.clear();
+
+  int fp    = regions_[r].targetBegin;
+  int lp    = regions_[r].targetEnd;
 
   if (fp >= lp)
-    return result;
+    return;
 
-  int refPos = -1;
+  int refPos = fp - 1;
+  int insertion = 0;
 
-  for (unsigned i = 0; i < ref.size(); i += 3) {
-    if (ref[i] != seq::Nucleotide::GAP)
+  unsigned size = alignedRefSize();
+  for (unsigned i = alignedPos(fp) * 3; i < size; i += 3) {
+    if (!refGapAt(i)) {
       ++refPos;
+      insertion = 0;
+    } else
+      ++insertion;
 
     if (refPos >= fp) {
       if (refPos > lp)
-	return result;
-
-      seq::AminoAcid refAA = seq::Codon::translate(ref.begin() + i);
-      std::set<seq::AminoAcid> targetAAs
-	= seq::Codon::translateAll(target.begin() + i);
-
-      if (((targetAAs.size() > 1)
-	   || (*targetAAs.begin() != refAA))
-	  && (*targetAAs.begin() != seq::AminoAcid::GAP)) {
+	return;
 
-	if (!result.empty())
-	  result += ' ';
-
-	result += refAA.toChar()
-	  + to_string(refPos - region.begin() + 1);
-
-	for (std::set<seq::AminoAcid>::const_iterator k = targetAAs.begin();
-	     k != targetAAs.end(); ++k)
-	  result += k->toChar();
+      seq::AminoAcid refAA = seq::Codon::translate(refCodon(i));
+      unsigned targetAAs = translateAll(target.begin() + i);
 
+      if ((targetAAs != (1u << refAA.intRep()))
+	  && (firstAminoAcid(targetAAs) != seq::AminoAcid::AA_GAP)) {
+	mutations.push_back(IsolateMutation());
+	makeMutation(r, refPos, insertion, i, targetAAs, mutations.back());
       }
     }
   }
-
-  return result;
 }
 
-std::string Alignment::
-codonMutations(const ReferenceSequence::Region& region,
-	       int& start,
-	       int& end) const
+void Alignment::codonMutations(unsigned r,
+			       int& start,
+			       int& end,
+			       std::vector<IsolateMutation>& mutations) const
 {
-  std::string result;
+  const ReferenceSequence::Region& region = reference_->regions()[r];
+  const AlignedRegion& aligned = regions_[r];
+
   int fp    = region.begin();
   int lp    = region.end() - 1;
 
   start = -1;
   end = -1;
+  mutations.clear();
 
   if (fp >= lp)
-    return result;
+    return;
 
-  int refPos = -1;
+  int refPos = fp - 1;
+  int insertion = 0;
 
-  for (unsigned i = 0; i < ref.size(); i += 3) {
-    if (ref[i] != seq::Nucleotide::GAP)
+  unsigned size = alignedRefSize();
+  for (unsigned i = alignedPos(fp) * 3; i < size; i += 3) {
+    if (!refGapAt(i)) {
       ++refPos;
+      insertion = 0;
+    } else
+      ++insertion;
+
+    seq::NTSequence::const_iterator ref = refCodon(i);
 
     int pos = refPos - region.begin() + 1;
 
     if (refPos >= fp) {
       if (refPos > lp)
-	return result;
+	return;
 
       if (target[i] == seq::Nucleotide::GAP &&
 	  target[i + 1] == seq::Nucleotide::GAP &&
 	  target[i + 2] == seq::Nucleotide::GAP &&
-	  (refPos < region.targetBegin || refPos > region.targetEnd))
+	  (refPos < aligned.targetBegin || refPos > aligned.targetEnd))
 	continue;
 
-      if (refPos == region.targetEnd && 
-          ref[i] == seq::Nucleotide::GAP && 
-          ref[i + 1] == seq::Nucleotide::GAP && 
-          ref[i + 2] == seq::Nucleotide::GAP)
+      if (refPos == aligned.targetEnd && 
+          ref[0] == seq::Nucleotide::GAP && 
+          ref[1] == seq::Nucleotide::GAP && 
+          ref[2] == seq::Nucleotide::GAP)
         continue;
 
       //skip incomplete begin codon
-      if(refPos == region.targetBegin-1 &&
+      if(refPos == aligned.targetBegin-1 &&
           target[i] == seq::Nucleotide::GAP)
         continue;
 
       //skip incomplete end codon
-      if(refPos == region.targetEnd+1 &&
+      if(refPos == aligned.targetEnd+1 &&
           target[i + 2] == seq::Nucleotide::GAP)
         continue;
 
@@ -284,37 +542,23 @@ codonMutations(const ReferenceSequence::Region& region,
       end = pos;
 
       bool mutation;
-      mutation = ref[i] != target[i] ||
-                 ref[i + 1] != target[i + 1] ||
-                 ref[i + 2] != target[i + 2];
+      mutation = ref[0] != target[i] ||
+                 ref[1] != target[i + 1] ||
+                 ref[2] != target[i + 2];
 
       if(mutation) {
-	if (!result.empty())
-	  result += ' ';
-
-        seq::AminoAcid refAA = seq::Codon::translate(ref.begin() + i);
-        std::set<seq::AminoAcid> targetAAs = seq::Codon::translateAll(target.begin() + i);
-
-        result += refAA.toChar()
-               + to_string(refPos - region.begin() + 1);
-
-        for (std::set<seq::AminoAcid>::const_iterator k = targetAAs.begin(); k != targetAAs.end(); ++k)
-          result += k->toChar();
-        result += ';';
-
-	result += ref[i].toChar();
-	result += ref[i+1].toChar(); 
-	result += ref[i+2].toChar();
-	result += to_string(pos);
-
-	result += target[i].toChar();
-	result += target[i + 1].toChar();
-	result += target[i + 2].toChar();
+	mutations.push_back(IsolateMutation());
+	makeMutation(r, refPos, insertion, i, translateAll(target.begin() + i),
+		     mutations.back());
       }
     }
   }
+}
 
-  return result;
+void Alignment::revert(const IsolateMutation& mutation)
+{
+  for (int k = 0; k < 3; ++k)
+    target[mutation.alignedPos * 3 + k] = mutation.refCodon[k];
 }
 
 
@@ -7,25 +7,73 @@
 
 class IsolateMutation;
 
+namespace seq {
+  class CodonAlign;
+  class CodonReference;
+};
+
+/**
+ * The alignment of a target against a reference.
+ *
+ * The reference is not copied: it is shared by all alignments against it,
+ * and must outlive them. The alignment only holds the gaps that it inserts
+ * in the reference, and the aligned range of each reference region.
+ */
 class Alignment
 {
 public:
+  /*
+   * The aligned range of a reference region, for this target.
+   */
+  struct AlignedRegion {
+    // aligned positions of begin, end
+    int alignedBegin, alignedEnd; // AA position [0 -- N[
+    // reference position of first/last non-gap in target within region
+    int targetBegin, targetEnd;   // AA position [0 -- N[
+  };
+
   bool   success;
   bool   tooShort;
   bool   failure;
   int    correctedFrameshifts;
   double score;
 
-  ReferenceSequence ref;
   seq::NTSequence   target;
 
-  std::string 
-  mutations(const ReferenceSequence::Region& region) const;
-  std::string 
-  codonMutations(const ReferenceSequence::Region& region,
-		 int& start,
-		 int& end) const;
-  void isolateMutations(const ReferenceSequence::Region& regioni, std::vector<IsolateMutation>& mutations) const;
+  const ReferenceSequence& reference() const { return *reference_; }
+
+  /*
+   * The reference with the gaps of this alignment.
+   */
+  seq::NTSequence alignedRef() const;
+
+  const AlignedRegion& alignedRegion(unsigned region) const {
+    return regions_[region];
+  }
+
+  /*
+   * The alignment column (AA position) of a reference (AA) position.
+   */
+  int alignedPos(int refPos) const;
+
+  /*
+   * The amino acid mutations of the target within a region (within the
+   * range covered by the target), including insertions.
+   *
+   * The vector is cleared first, so that it can be reused.
+   */
+  void isolateMutations(unsigned region,
+			std::vector<IsolateMutation>& mutations) const;
+
+  /*
+   * The codons of the target that differ from the reference within a
+   * region, also synonymous ones; start and end are set to the first and
+   * last position in the region covered by the target.
+   */
+  void codonMutations(unsigned region,
+		      int& start,
+		      int& end,
+		      std::vector<IsolateMutation>& mutations) const;
 
   /*! \brief Return the amino acid position of the given mutation, if there
    *         is information on that mutation in the alignment
@@ -37,28 +85,77 @@ public:
    * an insertion which is not contained in the sequence, this value is
    * -1.
    */
-  std::pair<bool, int> findAminoAcid(const ReferenceSequence::Region& region,
+  std::pair<bool, int> findAminoAcid(unsigned region,
 				     int positionInRegion, int insertion)
     const;
 
+  /*
+   * Compute the alignment of target against ref. If given, codonRef is
+   * ref prepared for codon alignment, see seq::CodonReference.
+   */
   static Alignment compute(const ReferenceSequence& ref,
 			   const seq::NTSequence& target,
 			   seq::AlignmentAlgorithm* algorithm,
-			   int maxFrameShifts = 5);
+			   int maxFrameShifts = 5,
+			   const seq::CodonReference* codonRef = 0);
 
+  /*
+   * Compute the alignments of all targets against ref, and append them to
+   * results (in order). The nucleotide alignments, with which every codon
+   * alignment starts, are computed together with
+   * AlignmentAlgorithm::alignBatch().
+   */
+  static void compute(const ReferenceSequence& ref,
+		      const std::vector<seq::NTSequence>& targets,
+		      seq::AlignmentAlgorithm* algorithm,
+		      int maxFrameShifts,
+		      std::vector<Alignment>& results,
+		      const seq::CodonReference* codonRef = 0);
+
+  /*
+   * An alignment of which the aligned reference (ref with gaps) and target
+   * are given.
+   */
   static Alignment given(const ReferenceSequence& ref,
+			 const seq::NTSequence& alignedRef,
 			 const seq::NTSequence& target);
 
+  /*
+   * Replace the target codon of the mutation with the reference codon.
+   */
   void revert(const IsolateMutation& mutation);
 
 private:
+  friend class ResultsStore;
+  friend class AlignmentDeltas;
+
+  // a run of gaps in the aligned reference, before reference[refIndex]
+  struct GapRun {
+    int refIndex, alignedIndex, length;
+  };
+
+  const ReferenceSequence   *reference_;
+  std::vector<GapRun>        refGaps_;
+  std::vector<AlignedRegion> regions_;
+
   Alignment(const ReferenceSequence& aref,
 	    const seq::NTSequence&   atarget);
 
-  void     computeAlignedRanges(int referenceSequenceLength);
-  int      alignedPos(int refPos) const;
-  int      firstPos(int begin, int end) const;
-  int      lastPos(int begin, int end) const;
+  void     codonAlign(seq::CodonAlign& codonAlign, int maxFrameShifts,
+		      const seq::NTSequence *ntAlignedRef,
+		      const seq::NTSequence *ntAlignedTarget, double ntScore);
+  void     setAlignedRef(const seq::NTSequence& alignedRef);
+  void     addRefGap(int alignedIndex, int length);
+  void     computeAlignedRanges();
+
+  unsigned alignedRefSize() const;
+  int      refIndex(int alignedIndex) const;
+  int      alignedIndex(int refIndex) const;
+  bool     refGapAt(int alignedIndex) const { return refIndex(alignedIndex) < 0; }
+  seq::NTSequence::const_iterator refCodon(int alignedIndex) const;
+  void     makeMutation(unsigned region, int refPos, int insertion,
+			unsigned alignedIndex, unsigned targetAAs,
+			IsolateMutation& mutation) const;
 };
 
 #endif // ALIGNMENT_H_
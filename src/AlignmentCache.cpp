@@ -0,0 +1,166 @@
+#include "Utils.h"
+
+#include "AlignmentCache.h"
+#include "AlignmentDeltas.h"
+#include "Alignment.h"
+
+#include <AlignmentAlgorithm.h>
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+  const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+  const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+  // 64-bit FNV-1a
+  void hash(unsigned long long& h, const std::string& s)
+  {
+    for (unsigned i = 0; i < s.size(); ++i) {
+      h ^= (unsigned char)s[i];
+      h *= FNV_PRIME;
+    }
+  }
+
+  void hash(unsigned long long& h, const seq::ScoringMatrix& m)
+  {
+    for (int i = 0; i < m.size(); ++i)
+      for (int j = 0; j < m.size(); ++j)
+	hash(h, to_string(m.weight(i, j)) + ",");
+  }
+
+  std::string ungapped(const seq::NTSequence& s)
+  {
+    std::string result;
+    result.reserve(s.size());
+    for (unsigned i = 0; i < s.size(); ++i)
+      if (s[i] != seq::Nucleotide::GAP)
+	result += s[i].toChar();
+    return result;
+  }
+}
+
+AlignmentCache::AlignmentCache(const std::string& directory,
+			       const ReferenceSequence& ref,
+			       double gapOpenPenalty,
+			       double gapExtensionPenalty,
+			       int maxFrameShifts,
+			       const std::string& aligner,
+			       double xDrop,
+			       const seq::ScoringMatrix& ntMatrix,
+			       const seq::ScoringMatrix& aaMatrix)
+  : directory_(directory),
+    reference_(ref),
+    parametersHash_(FNV_OFFSET_BASIS)
+{
+#ifdef _WIN32
+  _mkdir(directory.c_str());
+#else
+  mkdir(directory.c_str(), 0777);
+#endif
+
+  struct stat st;
+  if (stat(directory.c_str(), &st) != 0 || !(st.st_mode & S_IFDIR))
+    throw std::runtime_error("Could not create cache directory " + directory);
+
+  hash(parametersHash_, ungapped(ref));
+  hash(parametersHash_, "," + to_string(gapOpenPenalty)
+       + "," + to_string(gapExtensionPenalty)
+       + "," + to_string(maxFrameShifts)
+       + "," + aligner + ",");
+  if (xDrop > 0)
+    hash(parametersHash_, "xDrop=" + to_string(xDrop) + ",");
+  if (ntMatrix != seq::ScoringMatrix(seq::ScoringMatrix::Nucleotides,
+				     seq::AlignmentAlgorithm::IUB())) {
+    hash(parametersHash_, "ntMatrix=");
+    hash(parametersHash_, ntMatrix);
+  }
+  if (aaMatrix != seq::ScoringMatrix(seq::ScoringMatrix::AminoAcids,
+				     seq::AlignmentAlgorithm::BLOSUM30())) {
+    hash(parametersHash_, "aaMatrix=");
+    hash(parametersHash_, aaMatrix);
+  }
+}
+
+std::string AlignmentCache::fileName(const seq::NTSequence& target) const
+{
+  unsigned long long h = parametersHash_;
+  hash(h, ungapped(target));
+
+  char name[17];
+  std::sprintf(name, "%016llx", h);
+
+  return directory_ + "/" + name + ".csv";
+}
+
+bool AlignmentCache::find(const seq::NTSequence& target,
+			  std::vector<Alignment>& results) const
+{
+  std::ifstream f(fileName(target).c_str());
+  if (!f)
+    return false;
+
+  std::vector<Alignment> cached;
+  try {
+    AlignmentDeltas::read(reference_, f, cached);
+  } catch (std::runtime_error&) {
+    return false; // a damaged entry: align again
+  }
+
+  if (cached.size() != 1)
+    return false;
+
+  Alignment& result = cached[0];
+
+  /*
+   * The deltas hold the (frameshift corrected) target only for successful
+   * alignments.
+   */
+  if (!result.success) {
+    result.target = target;
+    for (unsigned j = 0; j < result.target.size(); ++j)
+      if (result.target[j] == seq::Nucleotide::GAP) {
+	result.target.erase(result.target.begin() + j);
+	--j;
+      }
+  }
+
+  result.target.setName(target.name());
+  result.target.setDescription(target.description());
+
+  results.push_back(result);
+
+  return true;
+}
+
+void AlignmentCache::store(const seq::NTSequence& target,
+			   const Alignment& result) const
+{
+  std::string name = fileName(target);
+
+  /*
+   * Write to a temporary file first, so that other runs never see a
+   * partially written entry.
+   */
+  std::string tmp = name + ".tmp";
+  {
+    std::ofstream f(tmp.c_str());
+    AlignmentDeltas::write(std::vector<Alignment>(1, result), f);
+    if (!f) {
+      std::remove(tmp.c_str());
+      return;
+    }
+  }
+
+#ifdef _WIN32
+  std::remove(name.c_str());
+#endif
+  std::rename(tmp.c_str(), name.c_str());
+}
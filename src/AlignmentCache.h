@@ -0,0 +1,61 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef ALIGNMENT_CACHE_H_
+#define ALIGNMENT_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include <NTSequence.h>
+#include <ScoringMatrix.h>
+
+class Alignment;
+class ReferenceSequence;
+
+/**
+ * A persistent cache of alignment results, in a directory.
+ *
+ * Every result is stored in its own file, as an AlignmentDeltas row,
+ * named after a (64-bit) hash of the reference sequence, the alignment
+ * parameters and the (ungapped) target. Results can thus be reused by
+ * later runs with the same reference and parameters, and by concurrent
+ * runs.
+ */
+class AlignmentCache
+{
+public:
+  /**
+   * Use (and create if needed) directory as cache for alignments against
+   * ref with the given parameters and (the name of the) aligner, and
+   * X-drop (see seq::NeedlemanWunsh::setXDrop()) if not 0, and scoring
+   * matrices if not the default ones.
+   *
+   * @throws std::runtime_error if the directory cannot be created.
+   */
+  AlignmentCache(const std::string& directory, const ReferenceSequence& ref,
+		 double gapOpenPenalty, double gapExtensionPenalty,
+		 int maxFrameShifts, const std::string& aligner,
+		 double xDrop, const seq::ScoringMatrix& ntMatrix,
+		 const seq::ScoringMatrix& aaMatrix);
+
+  /**
+   * Append the cached alignment of target to results, if any.
+   *
+   * The alignment shares the reference, which must outlive it.
+   */
+  bool find(const seq::NTSequence& target,
+	    std::vector<Alignment>& results) const;
+
+  /**
+   * Store the alignment result of target.
+   */
+  void store(const seq::NTSequence& target, const Alignment& result) const;
+
+private:
+  std::string              directory_;
+  const ReferenceSequence& reference_;
+  unsigned long long       parametersHash_;
+
+  std::string fileName(const seq::NTSequence& target) const;
+};
+
+#endif // ALIGNMENT_CACHE_H_
@@ -0,0 +1,300 @@
+#include "Utils.h"
+
+#include "AlignmentDeltas.h"
+#include "Alignment.h"
+
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+  const char *HEADER = "seqid,status,score,frameshifts,begin,end,"
+    "substitutions,deletions,insertions,missing,description";
+
+  // exports of earlier versions, without the descriptions
+  const char *HEADER_WITHOUT_DESCRIPTION = "seqid,status,score,frameshifts,"
+    "begin,end,substitutions,deletions,insertions,missing";
+
+  const unsigned FIELDS = 10;
+
+  const char *statusName(const Alignment& result)
+  {
+    if (result.success)
+      return "Success";
+    else if (result.tooShort)
+      return "FailTooShort";
+    else if (result.failure)
+      return "Failure";
+    else
+      return "InternalError";
+  }
+
+  void appendItem(std::string& list, const std::string& item)
+  {
+    if (!list.empty())
+      list += ' ';
+    list += item;
+  }
+
+  std::string range(int begin, int end)
+  {
+    if (begin == end)
+      return to_string(begin);
+    else
+      return to_string(begin) + "-" + to_string(end);
+  }
+
+  /*
+   * A reference position, 1-based, with 0 allowed for insertions before
+   * the first position.
+   */
+  int parsePosition(const std::string& s, int first, int last)
+  {
+    int result = lexical_cast<int>(s);
+    if (result < first || result > last)
+      throw std::runtime_error("position " + s + " outside the reference");
+    return result;
+  }
+
+  void parseRange(const std::string& s, int length, int& begin, int& end)
+  {
+    std::string::size_type dash = s.find('-');
+    if (dash == std::string::npos)
+      begin = end = parsePosition(s, 1, length);
+    else {
+      begin = parsePosition(s.substr(0, dash), 1, length);
+      end = parsePosition(s.substr(dash + 1), begin, length);
+    }
+  }
+
+  std::vector<std::string> items(const std::string& list)
+  {
+    std::vector<std::string> result;
+    if (!list.empty())
+      result = split(list, ' ');
+    return result;
+  }
+}
+
+void AlignmentDeltas::write(const std::vector<Alignment>& results,
+			    std::ostream& s)
+{
+  s << HEADER << std::endl;
+
+  for (unsigned i = 0; i < results.size(); ++i) {
+    const Alignment& result = results[i];
+
+    s << result.target.name() << "," << statusName(result);
+
+    if (!result.success) {
+      s << ",,,,,,,,," << result.target.description() << std::endl;
+      continue;
+    }
+
+    seq::NTSequence ref = result.alignedRef();
+    const seq::NTSequence& target = result.target;
+
+    /*
+     * The target covers the reference from the first to the last column
+     * in which both have a nucleotide: gaps in the target within that
+     * range are deletions.
+     */
+    int first = 0;
+    while (first < (int)ref.size()
+	   && (ref[first] == seq::Nucleotide::GAP
+	       || target[first] == seq::Nucleotide::GAP))
+      ++first;
+
+    int last = ref.size() - 1;
+    while (last > first
+	   && (ref[last] == seq::Nucleotide::GAP
+	       || target[last] == seq::Nucleotide::GAP))
+      --last;
+
+    std::string substitutions, deletions, insertions, missing;
+    std::string insertion;
+    int pos = 0, begin = 0, end = 0, deletionBegin = 0, missingBegin = 0;
+
+    for (int j = 0; j <= (int)ref.size(); ++j) {
+      if (j < (int)ref.size() && ref[j] == seq::Nucleotide::GAP) {
+	if (target[j] != seq::Nucleotide::GAP)
+	  insertion += target[j].toChar();
+	continue;
+      }
+
+      if (!insertion.empty()) {
+	appendItem(insertions, to_string(pos) + ":" + insertion);
+	insertion.clear();
+      }
+
+      bool deleted = false, isMissing = false;
+      if (j < (int)ref.size()) {
+	++pos;
+	deleted = j > first && j < last
+	  && target[j] == seq::Nucleotide::GAP;
+	isMissing = target[j] == seq::Nucleotide::N;
+      }
+
+      if (deletionBegin && !deleted) {
+	appendItem(deletions, range(deletionBegin, pos - 1));
+	deletionBegin = 0;
+      } else if (deleted && !deletionBegin)
+	deletionBegin = pos;
+
+      if (missingBegin && !isMissing) {
+	appendItem(missing, range(missingBegin, pos - 1));
+	missingBegin = 0;
+      } else if (isMissing && !missingBegin)
+	missingBegin = pos;
+
+      if (j == first)
+	begin = pos;
+      if (j == last)
+	end = pos;
+
+      if (j < (int)ref.size() && !isMissing
+	  && target[j] != seq::Nucleotide::GAP && target[j] != ref[j])
+	appendItem(substitutions, ref[j].toChar() + to_string(pos)
+		   + target[j].toChar());
+    }
+
+    s << "," << result.score << "," << result.correctedFrameshifts
+      << "," << begin << "," << end
+      << "," << substitutions << "," << deletions
+      << "," << insertions << "," << missing
+      << "," << result.target.description() << std::endl;
+  }
+}
+
+void AlignmentDeltas::read(const ReferenceSequence& ref, std::istream& stream,
+			   std::vector<Alignment>& results)
+{
+  std::string line;
+  if (std::getline(stream, line)
+      && !line.empty() && line[line.size() - 1] == '\r')
+    line.erase(line.size() - 1);
+  if (!stream || (line != HEADER && line != HEADER_WITHOUT_DESCRIPTION))
+    throw std::runtime_error("not a virulign deltas export");
+  bool withDescriptions = line == HEADER;
+
+  const int length = ref.size();
+
+  for (int lineNumber = 2; std::getline(stream, line); ++lineNumber) {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty())
+      continue;
+
+    try {
+      /*
+       * The description is the last field, and may itself hold commas.
+       */
+      std::string description;
+      if (withDescriptions) {
+	std::string::size_type comma = 0;
+	for (unsigned k = 0; k < FIELDS && comma != std::string::npos; ++k)
+	  comma = line.find(',', k == 0 ? 0 : comma + 1);
+	if (comma == std::string::npos)
+	  throw std::runtime_error("expected " + to_string(FIELDS + 1)
+				   + " fields");
+	description = line.substr(comma + 1);
+	line.erase(comma);
+      }
+
+      std::vector<std::string> fields = split(line, ',');
+      if (fields.size() != FIELDS)
+	throw std::runtime_error("expected " + to_string(FIELDS) + " fields");
+
+      Alignment result(ref, seq::NTSequence());
+      result.target.setName(fields[0]);
+
+      const std::string& status = fields[1];
+      result.success = status == "Success";
+      result.tooShort = status == "FailTooShort";
+      result.failure = status == "Failure";
+      if (!result.success && !result.tooShort && !result.failure
+	  && status != "InternalError")
+	throw std::runtime_error("invalid status " + status);
+
+      if (result.success) {
+	result.score = lexical_cast<double>(fields[2]);
+	result.correctedFrameshifts = lexical_cast<int>(fields[3]);
+	int begin = parsePosition(fields[4], 1, length);
+	int end = parsePosition(fields[5], begin, length);
+
+	/*
+	 * Apply the differences on the covered part of the reference, and
+	 * then add the insertions.
+	 */
+	std::vector<seq::Nucleotide> row(length, seq::Nucleotide::GAP);
+	std::copy(ref.begin() + begin - 1, ref.begin() + end,
+		  row.begin() + begin - 1);
+
+	std::vector<std::string> list = items(fields[6]);
+	for (unsigned k = 0; k < list.size(); ++k) {
+	  const std::string& item = list[k];
+	  if (item.size() < 3)
+	    throw std::runtime_error("invalid substitution " + item);
+	  int p = parsePosition(item.substr(1, item.size() - 2), 1, length);
+	  if (seq::Nucleotide(item[0]) != ref[p - 1])
+	    throw std::runtime_error("substitution " + item
+				     + " does not match the reference");
+	  row[p - 1] = seq::Nucleotide(item[item.size() - 1]);
+	}
+
+	int b, e;
+	list = items(fields[7]);
+	for (unsigned k = 0; k < list.size(); ++k) {
+	  parseRange(list[k], length, b, e);
+	  std::fill(row.begin() + b - 1, row.begin() + e,
+		    seq::Nucleotide::GAP);
+	}
+
+	list = items(fields[9]);
+	for (unsigned k = 0; k < list.size(); ++k) {
+	  parseRange(list[k], length, b, e);
+	  std::fill(row.begin() + b - 1, row.begin() + e, seq::Nucleotide::N);
+	}
+
+	std::map<int, std::string> insertions;
+	list = items(fields[8]);
+	for (unsigned k = 0; k < list.size(); ++k) {
+	  std::string::size_type colon = list[k].find(':');
+	  if (colon == std::string::npos || colon + 1 == list[k].size())
+	    throw std::runtime_error("invalid insertion " + list[k]);
+	  int p = parsePosition(list[k].substr(0, colon), 0, length);
+	  insertions[p] += list[k].substr(colon + 1);
+	}
+
+	seq::NTSequence& target = result.target;
+	target.reserve(row.size());
+	int next = 0;
+	for (std::map<int, std::string>::const_iterator k = insertions.begin();
+	     k != insertions.end(); ++k) {
+	  target.insert(target.end(), row.begin() + next,
+			row.begin() + k->first);
+	  next = k->first;
+
+	  result.addRefGap(target.size(), k->second.size());
+	  for (unsigned c = 0; c < k->second.size(); ++c)
+	    target.push_back(seq::Nucleotide(k->second[c]));
+	}
+	target.insert(target.end(), row.begin() + next, row.end());
+      }
+
+      result.target.setDescription(description);
+
+      result.computeAlignedRanges();
+      results.push_back(result);
+    } catch (std::bad_cast&) {
+      throw std::runtime_error("line " + to_string(lineNumber)
+			       + ": invalid number");
+    } catch (seq::ParseException& e) {
+      throw std::runtime_error("line " + to_string(lineNumber)
+			       + ": " + e.message());
+    } catch (std::runtime_error& e) {
+      throw std::runtime_error("line " + to_string(lineNumber)
+			       + ": " + e.what());
+    }
+  }
+}
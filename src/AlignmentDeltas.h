@@ -0,0 +1,50 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef ALIGNMENT_DELTAS_H_
+#define ALIGNMENT_DELTAS_H_
+
+#include <iostream>
+#include <vector>
+
+class Alignment;
+class ReferenceSequence;
+
+/**
+ * A compact CSV export of alignments as differences with the reference.
+ *
+ * Every target is described by one row, with the range of reference
+ * (nucleotide, 1-based) positions that it covers, and lists of
+ * space-separated differences, in reference positions:
+ *  - substitutions: C241T
+ *  - deletions: 11288-11296 (or 11288 for a single nucleotide)
+ *  - insertions after a reference position (0 for before the first
+ *    one): 22204:GAGCCAGAA
+ *  - missing (runs of N): 1-54
+ *
+ * followed by the FASTA description of the target (the last field, which
+ * is not quoted, may hold commas).
+ *
+ * The size of the export thus depends on the number of differences rather
+ * than on the length of the reference, and the aligned rows can be
+ * reconstructed from it, given the reference.
+ */
+class AlignmentDeltas
+{
+public:
+  static void write(const std::vector<Alignment>& results,
+		    std::ostream& stream);
+
+  /**
+   * Reconstruct the alignments of a deltas export against the reference,
+   * without realigning, with the names and descriptions of the targets.
+   * Exports of earlier versions, without descriptions, are read as well.
+   *
+   * The alignments share the reference, which must therefore outlive them.
+   *
+   * @throws std::runtime_error if the stream is not a valid deltas export
+   *         against this reference.
+   */
+  static void read(const ReferenceSequence& ref, std::istream& stream,
+		   std::vector<Alignment>& results);
+};
+
+#endif // ALIGNMENT_DELTAS_H_
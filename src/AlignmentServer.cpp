@@ -0,0 +1,225 @@
+#include "AlignmentServer.h"
+#include "Alignment.h"
+#include "ResultsExporter.h"
+#include "CLIUtils.h"
+#include "Utils.h"
+
+#include <NeedlemanWunsh.h>
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+AlignmentServer::AlignmentServer(const ReferenceSequence& ref,
+				 double gapOpenPenalty,
+				 double gapExtensionPenalty,
+				 int maxFrameShifts,
+				 double xDrop,
+				 const seq::ScoringMatrix& ntMatrix,
+				 const seq::ScoringMatrix& aaMatrix)
+  : ref_(ref),
+    codonRef_(ref),
+    ntMatrix_(ntMatrix),
+    aaMatrix_(aaMatrix),
+    gapOpenPenalty_(gapOpenPenalty),
+    gapExtensionPenalty_(gapExtensionPenalty),
+    maxFrameShifts_(maxFrameShifts),
+    xDrop_(xDrop)
+{ }
+
+void AlignmentServer::handle(std::istream& request, std::ostream& response)
+{
+  ExportKind exportKind = Mutations;
+  ExportAlphabet exportAlphabet = AminoAcids;
+  bool exportWithInsertions = true;
+  ExportFormat exportFormat = Csv;
+
+  if (request.peek() == '#') {
+    std::string line;
+    std::getline(request, line);
+
+    std::vector<std::string> words;
+    std::istringstream ss(line.substr(1));
+    std::string word;
+    while (ss >> word)
+      words.push_back(word);
+
+    if (words.size() % 2 == 1) {
+      response << "Error: please provide parameters as: --parameterName parameterValue" << std::endl;
+      return;
+    }
+
+    for (unsigned i = 0; i < words.size(); i += 2) {
+      try {
+	if (!parseExportParameter(&words[i][0], &words[i+1][0], exportKind,
+				  exportAlphabet, exportWithInsertions,
+				  exportFormat)) {
+	  response << "Error: Unkown parameter name: " << words[i] << std::endl;
+	  return;
+	}
+      } catch (std::invalid_argument& e) {
+	response << "Error: " << e.what() << std::endl;
+	return;
+      }
+    }
+
+    if (exportFormat == Arrow
+	&& exportKind != PositionTable && exportKind != MutationTable) {
+      response << "Error: --exportFormat Arrow is only supported for PositionTable and MutationTable" << std::endl;
+      return;
+    }
+  }
+
+  std::vector<seq::NTSequence> targets;
+  try {
+    while (request) {
+      seq::NTSequence s;
+      request >> s;
+      if (request)
+	targets.push_back(s);
+    }
+  } catch (seq::ParseException& e) {
+    response << "Error: " << e.message() << std::endl;
+    return;
+  }
+
+  /*
+   * The workers already occupy the cores: a request is aligned on a
+   * single thread, with an aligner of its own.
+   */
+  seq::NeedlemanWunsh algorithm(-gapOpenPenalty_, -gapExtensionPenalty_,
+				ntMatrix_.weights(), aaMatrix_.weights());
+  algorithm.setXDrop(xDrop_);
+
+  std::vector<Alignment> results;
+  results.reserve(targets.size());
+  for (unsigned i = 0; i < targets.size(); ++i)
+    results.push_back(Alignment::compute(ref_, targets[i], &algorithm,
+					 maxFrameShifts_, &codonRef_));
+
+  ResultsExporter exporter(results, exportKind, exportAlphabet,
+			   exportWithInsertions, exportFormat);
+  exporter.streamData(response);
+}
+
+void AlignmentServer::worker()
+{
+  for (;;) {
+    int fd;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (connections_.empty())
+	queued_.wait(lock);
+
+      fd = connections_.front();
+      connections_.pop_front();
+    }
+
+    connection(fd);
+  }
+}
+
+#ifndef _WIN32
+
+void AlignmentServer::serve(const std::string& socketPath, unsigned workers)
+{
+  sockaddr_un address;
+  if (socketPath.size() >= sizeof(address.sun_path))
+    throw std::runtime_error("Socket path too long: " + socketPath);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    throw std::runtime_error("Could not create socket");
+
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  unlink(socketPath.c_str());
+  if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0
+      || listen(listener, SOMAXCONN) != 0) {
+    close(listener);
+    throw std::runtime_error("Could not listen on " + socketPath);
+  }
+
+  /*
+   * A client that goes away should not take the server with it.
+   */
+  signal(SIGPIPE, SIG_IGN);
+
+  log_line("Serving " + ref_.name() + " on " + socketPath);
+
+  for (unsigned i = 0; i < workers; ++i)
+    std::thread(&AlignmentServer::worker, this).detach();
+
+  for (;;) {
+    int fd = accept(listener, 0, 0);
+    if (fd < 0)
+      continue;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      connections_.push_back(fd);
+    }
+    queued_.notify_one();
+  }
+}
+
+void AlignmentServer::connection(int fd)
+{
+  std::string request;
+  char buf[65536];
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    request.append(buf, n);
+  }
+
+  std::istringstream in(request);
+  std::ostringstream out;
+  try {
+    handle(in, out);
+  } catch (std::exception& e) {
+    /*
+     * A request that fails (e.g. runs out of memory) should not take the
+     * server with it.
+     */
+    out.str(std::string());
+    out << "Error: " << e.what() << std::endl;
+  }
+
+  std::string response = out.str();
+  const char *p = response.data();
+  size_t left = response.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n <= 0)
+      break;
+    p += n;
+    left -= n;
+  }
+
+  close(fd);
+}
+
+#else
+
+void AlignmentServer::serve(const std::string&, unsigned)
+{
+  throw std::runtime_error("virulign serve is not supported on Windows");
+}
+
+void AlignmentServer::connection(int)
+{ }
+
+#endif
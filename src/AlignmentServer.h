@@ -0,0 +1,69 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef ALIGNMENT_SERVER_H_
+#define ALIGNMENT_SERVER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include <CodonReference.h>
+#include <ScoringMatrix.h>
+
+#include "ReferenceSequence.h"
+
+/**
+ * Serves alignment requests over a local (UNIX domain) socket, keeping the
+ * reference loaded between requests.
+ *
+ * A request is a FASTA file with the target sequences, optionally preceded
+ * by a line starting with '#' that holds export parameters, e.g.:
+ *
+ *   # --exportKind PositionTable --exportAlphabet Nucleotides
+ *
+ * The client signals the end of the request by shutting down its write
+ * side of the connection. The response is the export (by default the
+ * Mutations CSV), or a single line starting with "Error: ". Connections
+ * are queued and handled by a fixed pool of workers (see serve()), and
+ * each request is aligned on its own worker thread, with its own aligner.
+ */
+class AlignmentServer
+{
+public:
+  AlignmentServer(const ReferenceSequence& ref,
+		  double gapOpenPenalty, double gapExtensionPenalty,
+		  int maxFrameShifts, double xDrop,
+		  const seq::ScoringMatrix& ntMatrix,
+		  const seq::ScoringMatrix& aaMatrix);
+
+  /**
+   * Listen on the socket, and serve requests with the given number of
+   * workers until the process is killed.
+   *
+   * @throws std::runtime_error if the socket could not be set up.
+   */
+  void serve(const std::string& socketPath, unsigned workers);
+
+  /**
+   * Handle a single request, on the calling thread.
+   */
+  void handle(std::istream& request, std::ostream& response);
+
+private:
+  const ReferenceSequence& ref_;
+  seq::CodonReference      codonRef_;
+  seq::ScoringMatrix       ntMatrix_, aaMatrix_;
+  double                   gapOpenPenalty_, gapExtensionPenalty_;
+  int                      maxFrameShifts_;
+  double                   xDrop_;
+
+  std::mutex               mutex_;
+  std::condition_variable  queued_;
+  std::deque<int>          connections_;
+
+  void worker();
+  void connection(int fd);
+};
+
+#endif // ALIGNMENT_SERVER_H_
@@ -0,0 +1,630 @@
+#include "ArrowWriter.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+  /*
+   * A minimal FlatBuffers builder, sufficient for the Arrow IPC metadata
+   * (Schema.fbs, Message.fbs and File.fbs).
+   *
+   * Like the reference implementation, the buffer is built back to front:
+   * an object is identified by its offset from the end of the buffer.
+   */
+  class FlatBufferBuilder
+  {
+  public:
+    FlatBufferBuilder()
+      : buf_(1024),
+	head_(buf_.size()),
+	minAlign_(1)
+    { }
+
+    int size() const { return buf_.size() - head_; }
+
+    template <typename T>
+    void push(T value) {
+      align(sizeof(T), sizeof(T));
+      prepend(&value, sizeof(T));
+    }
+
+    void pushOffset(int offset) {
+      align(4, 4);
+      push<unsigned>(size() + 4 - offset);
+    }
+
+    void startTable() {
+      fields_.clear();
+      tableStart_ = size();
+    }
+
+    template <typename T>
+    void addScalar(int id, T value) {
+      push(value);
+      fields_.push_back(std::make_pair(id, size()));
+    }
+
+    void addOffset(int id, int offset) {
+      pushOffset(offset);
+      fields_.push_back(std::make_pair(id, size()));
+    }
+
+    int endTable() {
+      push<int>(0);
+      int table = size();
+
+      int fieldCount = 0;
+      for (unsigned i = 0; i < fields_.size(); ++i)
+	fieldCount = std::max(fieldCount, fields_[i].first + 1);
+
+      std::vector<unsigned short> vtable(fieldCount, 0);
+      for (unsigned i = 0; i < fields_.size(); ++i)
+	vtable[fields_[i].first] = table - fields_[i].second;
+
+      for (int i = fieldCount - 1; i >= 0; --i)
+	push<unsigned short>(vtable[i]);
+      push<unsigned short>(table - tableStart_);
+      push<unsigned short>((2 + fieldCount) * 2);
+
+      int soffset = size() - table;
+      std::memcpy(&buf_[buf_.size() - table], &soffset, sizeof(soffset));
+
+      return table;
+    }
+
+    int createString(const std::string& s) {
+      align(s.size() + 1, 4);
+      push<char>(0);
+      prepend(s.data(), s.size());
+      push<unsigned>(s.size());
+      return size();
+    }
+
+    int createOffsetVector(const std::vector<int>& offsets) {
+      align(offsets.size() * 4, 4);
+      for (int i = offsets.size() - 1; i >= 0; --i)
+	pushOffset(offsets[i]);
+      push<unsigned>(offsets.size());
+      return size();
+    }
+
+    int createStructVector(const void *data, int elementSize, int count,
+			   int alignment) {
+      align(elementSize * count, alignment);
+      prepend(data, elementSize * count);
+      push<unsigned>(count);
+      return size();
+    }
+
+    void finish(int root, std::vector<char>& result) {
+      align(4, minAlign_);
+      pushOffset(root);
+      result.assign(buf_.begin() + head_, buf_.end());
+    }
+
+  private:
+    std::vector<char> buf_;
+    int               head_;
+    int               minAlign_;
+    int               tableStart_;
+    std::vector<std::pair<int, int> > fields_;
+
+    void align(int size, int alignment) {
+      minAlign_ = std::max(minAlign_, alignment);
+      int padding = (alignment - ((this->size() + size) % alignment))
+	% alignment;
+      for (int i = 0; i < padding; ++i)
+	push<char>(0);
+    }
+
+    void prepend(const void *data, int n) {
+      if (head_ < n) {
+	int grow = std::max((int)buf_.size(), n);
+	std::vector<char> b(buf_.size() + grow);
+	std::memcpy(&b[head_ + grow], &buf_[head_], size());
+	head_ += grow;
+	buf_.swap(b);
+      }
+      head_ -= n;
+      if (n)
+	std::memcpy(&buf_[head_], data, n);
+    }
+  };
+
+  // Schema.fbs: MetadataVersion.V5
+  const short METADATA_VERSION = 4;
+
+  // Schema.fbs: Type union
+  const unsigned char TYPE_UTF8 = 5;
+  const unsigned char TYPE_BOOL = 6;
+
+  // Message.fbs: MessageHeader union
+  const unsigned char HEADER_SCHEMA = 1;
+  const unsigned char HEADER_DICTIONARY_BATCH = 2;
+  const unsigned char HEADER_RECORD_BATCH = 3;
+
+  const char MAGIC[] = "ARROW1";
+
+  struct FieldNode {
+    long long length, nullCount;
+  };
+
+  struct BufferSpec {
+    long long offset, length;
+  };
+
+  struct BlockSpec {
+    long long offset;
+    int       metaDataLength;
+    int       padding;
+    long long bodyLength;
+  };
+
+  typedef std::vector<unsigned char> Bytes;
+
+  long long padded(long long size)
+  {
+    return (size + 7) & ~7LL;
+  }
+
+  /*
+   * Builds a RecordBatch table, for the given field nodes and buffers,
+   * returns its offset.
+   */
+  int recordBatch(FlatBufferBuilder& b, long long length,
+		  const std::vector<FieldNode>& nodes,
+		  const std::vector<Bytes>& body)
+  {
+    std::vector<BufferSpec> buffers;
+    long long offset = 0;
+    for (unsigned i = 0; i < body.size(); ++i) {
+      BufferSpec spec;
+      spec.offset = offset;
+      spec.length = body[i].size();
+      buffers.push_back(spec);
+      offset += padded(body[i].size());
+    }
+
+    int buffersVector = b.createStructVector
+      (buffers.empty() ? 0 : &buffers[0], sizeof(BufferSpec),
+       buffers.size(), 8);
+    int nodesVector = b.createStructVector
+      (nodes.empty() ? 0 : &nodes[0], sizeof(FieldNode), nodes.size(), 8);
+
+    b.startTable();
+    b.addScalar<long long>(0, length);
+    b.addOffset(1, nodesVector);
+    b.addOffset(2, buffersVector);
+    return b.endTable();
+  }
+
+  int message(FlatBufferBuilder& b, unsigned char headerType, int header,
+	      long long bodyLength)
+  {
+    b.startTable();
+    b.addScalar<long long>(3, bodyLength);
+    b.addOffset(2, header);
+    b.addScalar<short>(0, METADATA_VERSION);
+    b.addScalar<unsigned char>(1, headerType);
+    return b.endTable();
+  }
+
+  /*
+   * Builds a Schema table, for the given column names, types (one of
+   * TYPE_UTF8 or TYPE_BOOL) and dictionary index bit widths (0 for
+   * columns that are not dictionary encoded), returns its offset.
+   */
+  int schemaTable(FlatBufferBuilder& b,
+		  const std::vector<std::string>& names,
+		  const std::vector<unsigned char>& types,
+		  const std::vector<int>& indexWidths)
+  {
+    std::vector<int> fields;
+    for (unsigned i = 0; i < names.size(); ++i) {
+      int children = b.createOffsetVector(std::vector<int>());
+      int name = b.createString(names[i]);
+
+      b.startTable();
+      int type = b.endTable(); // Utf8 and Bool have no properties
+
+      int dictionary = 0;
+      if (indexWidths[i]) {
+	b.startTable();
+	b.addScalar<int>(0, indexWidths[i]);
+	b.addScalar<unsigned char>(1, 1);
+	int indexType = b.endTable();
+
+	b.startTable();
+	b.addScalar<long long>(0, i);
+	b.addOffset(1, indexType);
+	b.addScalar<unsigned char>(2, 0);
+	dictionary = b.endTable();
+      }
+
+      b.startTable();
+      b.addOffset(0, name);
+      b.addOffset(3, type);
+      if (dictionary)
+	b.addOffset(4, dictionary);
+      b.addOffset(5, children);
+      b.addScalar<unsigned char>(1, 1);
+      b.addScalar<unsigned char>(2, types[i]);
+      fields.push_back(b.endTable());
+    }
+
+    int fieldsVector = b.createOffsetVector(fields);
+    b.startTable();
+    b.addOffset(1, fieldsVector);
+    b.addScalar<short>(0, 0); // Little endian
+    return b.endTable();
+  }
+
+  long long bodyLength(const std::vector<Bytes>& body)
+  {
+    long long result = 0;
+    for (unsigned i = 0; i < body.size(); ++i)
+      result += padded(body[i].size());
+    return result;
+  }
+
+  void appendUtf8(Bytes& values, std::vector<int>& offsets,
+		  const std::string& s)
+  {
+    values.insert(values.end(), s.begin(), s.end());
+    offsets.push_back(values.size());
+  }
+
+  Bytes offsetsBuffer(const std::vector<int>& offsets)
+  {
+    Bytes result(offsets.size() * sizeof(int));
+    if (!offsets.empty())
+      std::memcpy(&result[0], &offsets[0], result.size());
+    return result;
+  }
+}
+
+ArrowWriter::ArrowWriter(std::ostream& stream, int batchSize)
+  : stream_(stream),
+    batchSize_(batchSize),
+    rows_(0),
+    position_(0),
+    started_(false)
+{ }
+
+int ArrowWriter::addColumn(const std::string& name, ColumnType type,
+			   int dictionarySize)
+{
+  assert(!started_);
+
+  Column c;
+  c.name = name;
+  c.type = type;
+  c.dictionaryWritten = false;
+  c.wideIndex = dictionarySize > 127;
+  c.offsets.assign(1, 0);
+  c.nullCount = 0;
+  columns_.push_back(c);
+
+  return columns_.size() - 1;
+}
+
+void ArrowWriter::setValid(Column& c, bool valid)
+{
+  if (rows_ % 8 == 0)
+    c.validity.push_back(0);
+  if (valid)
+    c.validity.back() |= (1 << (rows_ % 8));
+  else
+    ++c.nullCount;
+}
+
+void ArrowWriter::appendNull(int column)
+{
+  Column& c = columns_[column];
+  setValid(c, false);
+
+  switch (c.type) {
+  case Utf8:
+    c.offsets.push_back(c.values.size());
+    break;
+  case DictionaryUtf8:
+    c.values.insert(c.values.end(), c.wideIndex ? 2 : 1, 0);
+    break;
+  case Bool:
+    if (rows_ % 8 == 0)
+      c.values.push_back(0);
+  }
+}
+
+void ArrowWriter::appendString(int column, const std::string& value)
+{
+  Column& c = columns_[column];
+  setValid(c, true);
+
+  if (c.type == Utf8) {
+    appendUtf8(c.values, c.offsets, value);
+    return;
+  }
+
+  assert(c.type == DictionaryUtf8);
+
+  std::map<std::string, int>::iterator i = c.dictionary.find(value);
+  if (i == c.dictionary.end()) {
+    int size = c.dictionary.size();
+    if (size == (c.wideIndex ? 32767 : 127))
+      throw std::runtime_error("ArrowWriter: dictionary too large for "
+			       + c.name);
+    i = c.dictionary.insert(std::make_pair(value, size)).first;
+    c.newValues.push_back(value);
+  }
+
+  if (c.wideIndex) {
+    short index = i->second;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(&index);
+    c.values.insert(c.values.end(), p, p + sizeof(index));
+  } else
+    c.values.push_back((unsigned char)i->second);
+}
+
+void ArrowWriter::appendBool(int column, bool value)
+{
+  Column& c = columns_[column];
+  assert(c.type == Bool);
+  setValid(c, true);
+
+  if (rows_ % 8 == 0)
+    c.values.push_back(0);
+  if (value)
+    c.values.back() |= (1 << (rows_ % 8));
+}
+
+void ArrowWriter::endRow()
+{
+  if (!started_)
+    start();
+
+  ++rows_;
+  if (rows_ == batchSize_)
+    writeRecordBatch();
+}
+
+void ArrowWriter::close()
+{
+  if (!started_)
+    start();
+
+  if (rows_ > 0)
+    writeRecordBatch();
+  else
+    writeDictionaries();
+
+  /*
+   * End-of-stream marker, followed by the file footer.
+   */
+  int eos[] = { -1, 0 };
+  write(reinterpret_cast<const char *>(eos), sizeof(eos));
+
+  FlatBufferBuilder b;
+
+  std::vector<BlockSpec> dictionaries, records;
+  for (unsigned i = 0; i < dictionaryBlocks_.size() + recordBlocks_.size();
+       ++i) {
+    const Block& block = i < dictionaryBlocks_.size()
+      ? dictionaryBlocks_[i]
+      : recordBlocks_[i - dictionaryBlocks_.size()];
+    BlockSpec spec;
+    spec.offset = block.offset;
+    spec.metaDataLength = block.metaDataLength;
+    spec.padding = 0;
+    spec.bodyLength = block.bodyLength;
+    if (i < dictionaryBlocks_.size())
+      dictionaries.push_back(spec);
+    else
+      records.push_back(spec);
+  }
+
+  int recordsVector = b.createStructVector
+    (records.empty() ? 0 : &records[0], sizeof(BlockSpec), records.size(), 8);
+  int dictionariesVector = b.createStructVector
+    (dictionaries.empty() ? 0 : &dictionaries[0], sizeof(BlockSpec),
+     dictionaries.size(), 8);
+
+  std::vector<std::string> names;
+  std::vector<unsigned char> types;
+  std::vector<int> indexWidths;
+  schemaFields(names, types, indexWidths);
+  int schema = schemaTable(b, names, types, indexWidths);
+
+  b.startTable();
+  b.addOffset(1, schema);
+  b.addOffset(2, dictionariesVector);
+  b.addOffset(3, recordsVector);
+  b.addScalar<short>(0, METADATA_VERSION);
+  int footer = b.endTable();
+
+  std::vector<char> metadata;
+  b.finish(footer, metadata);
+  write(&metadata[0], metadata.size());
+
+  int footerLength = metadata.size();
+  write(reinterpret_cast<const char *>(&footerLength), sizeof(footerLength));
+  write(MAGIC, 6);
+
+  stream_.flush();
+}
+
+void ArrowWriter::schemaFields(std::vector<std::string>& names,
+			       std::vector<unsigned char>& types,
+			       std::vector<int>& indexWidths) const
+{
+  for (unsigned i = 0; i < columns_.size(); ++i) {
+    const Column& c = columns_[i];
+    names.push_back(c.name);
+    types.push_back(c.type == Bool ? TYPE_BOOL : TYPE_UTF8);
+    indexWidths.push_back(c.type == DictionaryUtf8
+			  ? (c.wideIndex ? 16 : 8) : 0);
+  }
+}
+
+void ArrowWriter::start()
+{
+  started_ = true;
+
+  write(MAGIC, 6);
+  write("\0\0", 2);
+
+  /*
+   * Schema message
+   */
+  FlatBufferBuilder b;
+
+  std::vector<std::string> names;
+  std::vector<unsigned char> types;
+  std::vector<int> indexWidths;
+  schemaFields(names, types, indexWidths);
+  int schema = schemaTable(b, names, types, indexWidths);
+
+  std::vector<char> metadata;
+  b.finish(message(b, HEADER_SCHEMA, schema, 0), metadata);
+  writeMessage(metadata, std::vector<Bytes>());
+}
+
+/*
+ * Writes the dictionary values that are new since the previous record
+ * batch, as a delta of the dictionary written before.
+ */
+void ArrowWriter::writeDictionaries()
+{
+  for (unsigned i = 0; i < columns_.size(); ++i) {
+    const Column& c = columns_[i];
+    if (c.type == DictionaryUtf8
+	&& (!c.dictionaryWritten || !c.newValues.empty()))
+      writeDictionary(i);
+  }
+}
+
+void ArrowWriter::writeDictionary(int column)
+{
+  Column& c = columns_[column];
+
+  Bytes values;
+  std::vector<int> offsets(1, 0);
+  for (unsigned i = 0; i < c.newValues.size(); ++i)
+    appendUtf8(values, offsets, c.newValues[i]);
+
+  std::vector<Bytes> body;
+  body.push_back(Bytes());
+  body.push_back(offsetsBuffer(offsets));
+  body.push_back(values);
+
+  FieldNode node;
+  node.length = c.newValues.size();
+  node.nullCount = 0;
+
+  FlatBufferBuilder b;
+  int data = recordBatch(b, node.length, std::vector<FieldNode>(1, node),
+			 body);
+
+  b.startTable();
+  b.addScalar<long long>(0, column);
+  b.addOffset(1, data);
+  b.addScalar<unsigned char>(2, c.dictionaryWritten); // isDelta
+  int batch = b.endTable();
+
+  std::vector<char> metadata;
+  b.finish(message(b, HEADER_DICTIONARY_BATCH, batch, bodyLength(body)),
+	   metadata);
+  dictionaryBlocks_.push_back(writeMessage(metadata, body));
+
+  c.newValues.clear();
+  c.dictionaryWritten = true;
+}
+
+void ArrowWriter::writeRecordBatch()
+{
+  writeDictionaries();
+
+  std::vector<FieldNode> nodes;
+  std::vector<Bytes> body;
+
+  for (unsigned i = 0; i < columns_.size(); ++i) {
+    Column& c = columns_[i];
+
+    FieldNode node;
+    node.length = rows_;
+    node.nullCount = c.nullCount;
+    nodes.push_back(node);
+
+    body.push_back(c.nullCount ? c.validity : Bytes());
+    if (c.type == Utf8)
+      body.push_back(offsetsBuffer(c.offsets));
+    body.push_back(c.values);
+  }
+
+  FlatBufferBuilder b;
+  int batch = recordBatch(b, rows_, nodes, body);
+
+  std::vector<char> metadata;
+  b.finish(message(b, HEADER_RECORD_BATCH, batch, bodyLength(body)),
+	   metadata);
+  recordBlocks_.push_back(writeMessage(metadata, body));
+
+  resetBatch();
+}
+
+void ArrowWriter::resetBatch()
+{
+  rows_ = 0;
+  for (unsigned i = 0; i < columns_.size(); ++i) {
+    Column& c = columns_[i];
+    c.validity.clear();
+    c.values.clear();
+    c.offsets.assign(1, 0);
+    c.nullCount = 0;
+  }
+}
+
+ArrowWriter::Block
+ArrowWriter::writeMessage(const std::vector<char>& metadata,
+			  const std::vector<Bytes>& body)
+{
+  Block block;
+  block.offset = position_;
+
+  /*
+   * Encapsulated message: continuation marker, metadata length, metadata
+   * padded to 8 bytes, body
+   */
+  int metadataLength = padded(metadata.size() + 8) - 8;
+  int prefix[] = { -1, metadataLength };
+  write(reinterpret_cast<const char *>(prefix), sizeof(prefix));
+  write(&metadata[0], metadata.size());
+  pad();
+
+  block.metaDataLength = metadataLength + 8;
+
+  for (unsigned i = 0; i < body.size(); ++i) {
+    if (!body[i].empty())
+      write(reinterpret_cast<const char *>(&body[i][0]), body[i].size());
+    pad();
+  }
+  block.bodyLength = bodyLength(body);
+
+  return block;
+}
+
+void ArrowWriter::write(const char *data, int size)
+{
+  stream_.write(data, size);
+  position_ += size;
+}
+
+void ArrowWriter::pad()
+{
+  static const char zeros[8] = { 0 };
+  if (position_ % 8)
+    write(zeros, 8 - position_ % 8);
+}
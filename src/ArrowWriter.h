@@ -0,0 +1,96 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef ARROW_WRITER_H_
+#define ARROW_WRITER_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Writes a table in the Apache Arrow IPC file format (also known as
+ * Feather V2), without depending on the Arrow libraries.
+ *
+ * Columns are declared first, then rows are appended cell by cell. Rows
+ * are buffered and written as record batches of batchSize rows, so that
+ * memory use is independent of the number of rows.
+ *
+ * Dictionary columns hold strings that are encoded as indices into a
+ * dictionary, which grows as new values are appended: the values that are
+ * new in a record batch are written before it as a dictionary delta.
+ */
+class ArrowWriter
+{
+public:
+  enum ColumnType { Utf8, DictionaryUtf8, Bool };
+
+  ArrowWriter(std::ostream& stream, int batchSize = 1024);
+
+  /**
+   * Declare a column, returns its index.
+   *
+   * dictionarySize is the greatest number of distinct values of a
+   * DictionaryUtf8 column: its indices are 8-bit when that is less than
+   * 128, 16-bit otherwise.
+   */
+  int addColumn(const std::string& name, ColumnType type,
+		int dictionarySize = 32767);
+
+  void appendNull(int column);
+  void appendString(int column, const std::string& value);
+  void appendBool(int column, bool value);
+
+  /**
+   * Finish the current row: every column must have received a value.
+   */
+  void endRow();
+
+  /**
+   * Flush the remaining rows and write the file footer.
+   */
+  void close();
+
+private:
+  struct Column {
+    std::string              name;
+    ColumnType               type;
+    std::map<std::string, int> dictionary;
+    std::vector<std::string>   newValues; // not yet written
+    bool                       dictionaryWritten;
+    bool                       wideIndex;
+
+    std::vector<unsigned char> validity, values;
+    std::vector<int>           offsets;
+    int                        nullCount;
+  };
+
+  struct Block {
+    long long offset;
+    int       metaDataLength;
+    long long bodyLength;
+  };
+
+  std::ostream&       stream_;
+  int                 batchSize_;
+  std::vector<Column> columns_;
+  int                 rows_;
+  long long           position_;
+  bool                started_;
+  std::vector<Block>  dictionaryBlocks_, recordBlocks_;
+
+  void start();
+  void schemaFields(std::vector<std::string>& names,
+		    std::vector<unsigned char>& types,
+		    std::vector<int>& indexWidths) const;
+  void resetBatch();
+  void writeRecordBatch();
+  void writeDictionaries();
+  void writeDictionary(int column);
+  Block writeMessage(const std::vector<char>& metadata,
+		     const std::vector<std::vector<unsigned char> >& body);
+  void write(const char *data, int size);
+  void pad();
+  void setValid(Column& c, bool valid);
+};
+
+#endif // ARROW_WRITER_H_
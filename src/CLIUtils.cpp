@@ -3,9 +3,14 @@
 #include <fstream> 
 #include <string.h>
 #include <stdexcept>
+#include <thread>
+#include <algorithm>
+
+#include <AlignmentAlgorithm.h>
 
 #include "ReferenceSequence.h" 
 #include "CLIUtils.h" 
+#include "Utils.h"
 
 ReferenceSequence loadRefSeqFromFile(const char* refSeqFileName) {
   std::ifstream f_ref(refSeqFileName);
@@ -37,6 +42,26 @@ ReferenceSequence loadRefSeqFromFile(const char* refSeqFileName) {
   }
 }
 
+seq::ScoringMatrix loadScoringMatrix(seq::ScoringMatrix::Alphabet alphabet,
+				     const std::string& fileName)
+{
+  if (fileName.empty())
+    return seq::ScoringMatrix(alphabet,
+			      alphabet == seq::ScoringMatrix::Nucleotides
+			      ? seq::AlignmentAlgorithm::IUB()
+			      : seq::AlignmentAlgorithm::BLOSUM30());
+
+  std::ifstream f(fileName.c_str());
+  if (!f)
+    throw std::runtime_error("Could not open " + fileName);
+
+  try {
+    return seq::ScoringMatrix(alphabet, f, fileName);
+  } catch (seq::ParseException& e) {
+    throw std::runtime_error(e.name() + ": " + e.message());
+  }
+}
+
 bool equalsS(char* str1, char* str2) {
   return strcmp(str1, str2) == 0;
 }
@@ -44,3 +69,127 @@ bool equalsS(char* str1, char* str2) {
 bool equalsString(std::string str1, std::string str2){
   return str1.compare(str2) == 0;
 }
+
+unsigned defaultThreads()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string unknownValue(const std::string& parameterName,
+			 const std::string& parameterValue)
+{
+  return "Unkown value " + parameterValue + " for parameter : " + parameterName;
+}
+
+/*
+ * Parses the parameters that configure the ResultsExporter, returns false if
+ * parameterName is not an export parameter.
+ *
+ * @throws std::invalid_argument for an unknown value.
+ */
+bool parseExportParameter(char* parameterName, char* parameterValue,
+			  ExportKind& exportKind,
+			  ExportAlphabet& exportAlphabet,
+			  bool& exportWithInsertions,
+			  ExportFormat& exportFormat)
+{
+  if(equalsString(parameterName,"--exportKind")) {
+    if(equalsString(parameterValue, "Mutations")) {
+      exportKind = Mutations;
+    } else if(equalsString(parameterValue, "PairwiseAlignments")) {
+      exportKind = PairwiseAlignments;
+    } else if(equalsString(parameterValue, "GlobalAlignment")) {
+      exportKind = GlobalAlignment;
+    } else if(equalsString(parameterValue, "PositionTable")) {
+      exportKind = PositionTable;
+    } else if(equalsString(parameterValue, "MutationTable")) {
+      exportKind = MutationTable;
+    } else if(equalsString(parameterValue, "Binary")) {
+      exportKind = Binary;
+    } else if(equalsString(parameterValue, "MutationFrequencies")) {
+      exportKind = MutationFrequencies;
+    } else if(equalsString(parameterValue, "Deltas")) {
+      exportKind = Deltas;
+    } else if(equalsString(parameterValue, "Consensus")) {
+      exportKind = Consensus;
+    } else {
+      throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+    }
+  } else if(equalsString(parameterName,"--exportAlphabet")) {
+    if(equalsString(parameterValue, "AminoAcids")) {
+      exportAlphabet = AminoAcids;
+    } else if(equalsString(parameterValue, "Nucleotides")) {
+      exportAlphabet = Nucleotides;
+    } else {
+      throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+    }
+  } else if(equalsString(parameterName,"--exportWithInsertions")) {
+    if(equalsString(parameterValue,"yes")) {
+      exportWithInsertions = true;
+    } else if(equalsString(parameterValue,"no")) {
+      exportWithInsertions = false;
+    } else {
+      throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+    } 
+  } else if(equalsString(parameterName,"--exportFormat")) {
+    if(equalsString(parameterValue,"Csv")) {
+      exportFormat = Csv;
+    } else if(equalsString(parameterValue,"Arrow")) {
+      exportFormat = Arrow;
+    } else {
+      throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+    } 
+  } else
+    return false;
+
+  return true;
+}
+
+bool parseAlignmentParameter(char* parameterName, char* parameterValue,
+			     double& gapOpenPenalty,
+			     double& gapExtensionPenalty,
+			     int& maxFrameShifts,
+			     double& xDrop,
+			     std::string& ntMatrixFile,
+			     std::string& aaMatrixFile)
+{
+  try {
+    if(equalsString(parameterName,"--gapExtensionPenalty")) {
+      gapExtensionPenalty = lexical_cast<double>(parameterValue);
+    } else if(equalsString(parameterName,"--gapOpenPenalty")) {
+      gapOpenPenalty = lexical_cast<double>(parameterValue);
+    } else if(equalsString(parameterName,"--maxFrameShifts")) {
+      maxFrameShifts = lexical_cast<int>(parameterValue);
+    } else if(equalsString(parameterName,"--xDrop")) {
+      xDrop = lexical_cast<double>(parameterValue);
+    } else if(equalsString(parameterName,"--ntMatrix")) {
+      ntMatrixFile = parameterValue;
+    } else if(equalsString(parameterName,"--aaMatrix")) {
+      aaMatrixFile = parameterValue;
+    } else
+      return false;
+  } catch (std::bad_cast& e) {
+    throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+  }
+
+  return true;
+}
+
+bool parseThreadsParameter(char* parameterName, char* parameterValue,
+			   unsigned& threads)
+{
+  if (!equalsString(parameterName, "--nthreads"))
+    return false;
+
+  int value = 0;
+  try {
+    value = lexical_cast<int>(parameterValue);
+  } catch (std::bad_cast& e) {
+  }
+
+  if (value < 1)
+    throw std::invalid_argument(unknownValue(parameterName, parameterValue));
+
+  threads = value;
+  return true;
+}
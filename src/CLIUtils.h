@@ -4,8 +4,51 @@
 
 #include <string>
 
+#include <ScoringMatrix.h>
+
+#include "ResultsExporter.h"
+
+class ReferenceSequence;
+
 ReferenceSequence loadRefSeqFromFile(const char* refSeqFileName); 
+
+/*
+ * Loads the scoring matrix in fileName, or returns the default matrix of
+ * the alphabet (IUB or BLOSUM30) if fileName is empty.
+ *
+ * @throws std::runtime_error if the file cannot be read or parsed.
+ */
+seq::ScoringMatrix loadScoringMatrix(seq::ScoringMatrix::Alphabet alphabet,
+				     const std::string& fileName);
 bool equalsS(char* str1, char* str2); 
 bool equalsString(std::string str1, std::string str2);
 
+/*
+ * The default number of threads: one per core.
+ */
+unsigned defaultThreads();
+
+std::string unknownValue(const std::string& parameterName,
+			 const std::string& parameterValue);
+
+/*
+ * Parsers for parameters shared by the virulign commands: they return false
+ * if parameterName is not theirs, and throw std::invalid_argument for an
+ * unknown value.
+ */
+bool parseExportParameter(char* parameterName, char* parameterValue,
+			  ExportKind& exportKind,
+			  ExportAlphabet& exportAlphabet,
+			  bool& exportWithInsertions,
+			  ExportFormat& exportFormat);
+bool parseAlignmentParameter(char* parameterName, char* parameterValue,
+			     double& gapOpenPenalty,
+			     double& gapExtensionPenalty,
+			     int& maxFrameShifts,
+			     double& xDrop,
+			     std::string& ntMatrixFile,
+			     std::string& aaMatrixFile);
+bool parseThreadsParameter(char* parameterName, char* parameterValue,
+			   unsigned& threads);
+
 #endif // CLI_UTILS_H_ 
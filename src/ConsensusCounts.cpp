@@ -0,0 +1,195 @@
+#include "ConsensusCounts.h"
+#include "Alignment.h"
+
+#include <set>
+#include <thread>
+
+ConsensusCounts::ConsensusCounts(const ReferenceSequence& ref)
+  : ref_(ref),
+    positions_(ref.size() * SYMBOLS, 0),
+    insertions_(ref.size() + 1),
+    insertionDepth_(ref.size() + 1, 0)
+{ }
+
+void ConsensusCounts::add(const Alignment& result)
+{
+  if (!result.success)
+    return;
+
+  seq::NTSequence ref = result.alignedRef();
+  const seq::NTSequence& target = result.target;
+  const int length = ref_.size();
+
+  int first = 0;
+  while (first < (int)target.size() && target[first] == seq::Nucleotide::GAP)
+    ++first;
+
+  int last = target.size() - 1;
+  while (last >= first && target[last] == seq::Nucleotide::GAP)
+    --last;
+
+  /*
+   * As in the global alignment, insertions before the first and after
+   * the last reference position are not counted.
+   */
+  int p = 0;            // reference positions passed
+  unsigned slot = 0;    // next insertion slot after p
+  bool spanned = false; // the target was counted in insertionDepth_[p]
+
+  for (int j = 0; j <= last; ++j) {
+    if (ref[j] != seq::Nucleotide::GAP) {
+      ++p;
+      slot = 0;
+      spanned = false;
+
+      if (j >= first) {
+	++positions_[(p - 1) * SYMBOLS + target[j].intRep()];
+
+	if (j < last && p < length) {
+	  ++insertionDepth_[p];
+	  spanned = true;
+	}
+      }
+    } else if (j >= first && p > 0 && p < length
+	       && target[j] != seq::Nucleotide::GAP) {
+      std::vector<unsigned>& slots = insertions_[p];
+      if (slots.size() < (slot + 1) * SYMBOLS)
+	slots.resize((slot + 1) * SYMBOLS, 0);
+
+      ++slots[slot * SYMBOLS + target[j].intRep()];
+      ++slot;
+
+      if (!spanned) {
+	++insertionDepth_[p];
+	spanned = true;
+      }
+    }
+  }
+}
+
+void ConsensusCounts::addShare(ConsensusCounts *counts,
+			       const std::vector<Alignment> *results,
+			       unsigned begin, unsigned end)
+{
+  for (unsigned i = begin; i < end; ++i)
+    counts->add((*results)[i]);
+}
+
+void ConsensusCounts::add(const std::vector<Alignment>& results,
+			  unsigned threads)
+{
+  threads = std::max(1u, std::min(threads, (unsigned)results.size()));
+
+  if (threads == 1) {
+    for (unsigned i = 0; i < results.size(); ++i)
+      add(results[i]);
+    return;
+  }
+
+  std::vector<ConsensusCounts> partial(threads, ConsensusCounts(ref_));
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; ++t) {
+    unsigned begin = results.size() * t / threads;
+    unsigned end = results.size() * (t + 1) / threads;
+    workers.push_back(std::thread(&addShare, &partial[t], &results,
+				  begin, end));
+  }
+
+  for (unsigned t = 0; t < threads; ++t) {
+    workers[t].join();
+    merge(partial[t]);
+  }
+}
+
+void ConsensusCounts::merge(const ConsensusCounts& other)
+{
+  for (unsigned i = 0; i < positions_.size(); ++i)
+    positions_[i] += other.positions_[i];
+
+  for (unsigned p = 0; p < insertions_.size(); ++p) {
+    std::vector<unsigned>& slots = insertions_[p];
+    const std::vector<unsigned>& o = other.insertions_[p];
+
+    if (slots.size() < o.size())
+      slots.resize(o.size(), 0);
+    for (unsigned i = 0; i < o.size(); ++i)
+      slots[i] += o[i];
+
+    insertionDepth_[p] += other.insertionDepth_[p];
+  }
+}
+
+/*
+ * The ambiguity code for all nucleotides that were observed, or a gap
+ * if none were.
+ */
+seq::Nucleotide ConsensusCounts::consensus(const unsigned *counts)
+{
+  std::set<seq::Nucleotide> all;
+  for (int k = 0; k < seq::Nucleotide::NT_GAP; ++k)
+    if (counts[k])
+      all.insert(seq::Nucleotide::fromRep(k));
+
+  if (all.empty())
+    return seq::Nucleotide::GAP;
+  else
+    return seq::Nucleotide::singleNucleotide(all);
+}
+
+void ConsensusCounts::streamCsv(std::ostream& s, bool withInsertions) const
+{
+  s << "position,insertion,reference,depth";
+  for (int k = 0; k < seq::Nucleotide::NT_GAP; ++k)
+    s << "," << seq::Nucleotide::fromRep(k).toChar();
+  s << ",gap,consensus" << std::endl;
+
+  for (unsigned p = 1; p <= ref_.size(); ++p) {
+    const unsigned *counts = &positions_[(p - 1) * SYMBOLS];
+
+    unsigned depth = 0;
+    for (int k = 0; k < SYMBOLS; ++k)
+      depth += counts[k];
+
+    s << p << ",0," << ref_[p - 1] << "," << depth;
+    for (int k = 0; k < SYMBOLS; ++k)
+      s << "," << counts[k];
+    s << "," << consensus(counts) << std::endl;
+
+    if (!withInsertions || p == ref_.size())
+      continue;
+
+    const std::vector<unsigned>& slots = insertions_[p];
+    for (unsigned i = 0; i < slots.size() / SYMBOLS; ++i) {
+      counts = &slots[i * SYMBOLS];
+
+      unsigned observed = 0;
+      for (int k = 0; k < seq::Nucleotide::NT_GAP; ++k)
+	observed += counts[k];
+
+      s << p << "," << i + 1 << ",-," << insertionDepth_[p];
+      for (int k = 0; k < seq::Nucleotide::NT_GAP; ++k)
+	s << "," << counts[k];
+      s << "," << insertionDepth_[p] - observed
+	<< "," << consensus(counts) << std::endl;
+    }
+  }
+}
+
+void ConsensusCounts::streamConsensus(std::ostream& s,
+				      bool withInsertions) const
+{
+  s << ">consensus" << std::endl;
+
+  for (unsigned p = 1; p <= ref_.size(); ++p) {
+    s << consensus(&positions_[(p - 1) * SYMBOLS]);
+
+    if (withInsertions && p < ref_.size()) {
+      const std::vector<unsigned>& slots = insertions_[p];
+      for (unsigned i = 0; i < slots.size() / SYMBOLS; ++i)
+	s << consensus(&slots[i * SYMBOLS]);
+    }
+  }
+
+  s << std::endl;
+}
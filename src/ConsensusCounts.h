@@ -0,0 +1,72 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef CONSENSUS_COUNTS_H_
+#define CONSENSUS_COUNTS_H_
+
+#include <iostream>
+#include <vector>
+
+#include "ReferenceSequence.h"
+
+class Alignment;
+
+/**
+ * Counts, for every nucleotide position of a reference, how many targets
+ * have each nucleotide (or ambiguity code, or a deletion) at that
+ * position. Nucleotides that are inserted after a position are counted in
+ * insertion slots: the k-th inserted nucleotide of every target is counted
+ * in the k-th slot.
+ *
+ * Alignments are counted one by one, so memory use depends only on the
+ * length of the reference (and the insertions), not on the number of
+ * targets.
+ */
+class ConsensusCounts
+{
+public:
+  ConsensusCounts(const ReferenceSequence& ref);
+
+  /**
+   * Count a (successful) alignment, within the range that the target
+   * covers.
+   */
+  void add(const Alignment& result);
+
+  /**
+   * Count all successful alignments, using up to threads threads that
+   * each count a share of the results, and are merged at the end.
+   */
+  void add(const std::vector<Alignment>& results, unsigned threads);
+
+  void merge(const ConsensusCounts& other);
+
+  /**
+   * Stream the depth and nucleotide counts of every position (and
+   * insertion slot), with the consensus nucleotide.
+   */
+  void streamCsv(std::ostream& stream, bool withInsertions) const;
+
+  /**
+   * Stream the consensus sequence as FASTA.
+   */
+  void streamConsensus(std::ostream& stream, bool withInsertions) const;
+
+private:
+  static const int SYMBOLS = seq::Nucleotide::NT_GAP + 1;
+
+  const ReferenceSequence&             ref_;
+
+  // SYMBOLS counts per reference position, by Nucleotide::intRep()
+  std::vector<unsigned>                positions_;
+
+  // per reference position p, SYMBOLS counts per slot after p, and the
+  // number of targets that span the slots after p
+  std::vector<std::vector<unsigned> >  insertions_;
+  std::vector<unsigned>                insertionDepth_;
+
+  static seq::Nucleotide consensus(const unsigned *counts);
+  static void addShare(ConsensusCounts *counts,
+		       const std::vector<Alignment> *results,
+		       unsigned begin, unsigned end);
+};
+
+#endif // CONSENSUS_COUNTS_H_
@@ -0,0 +1,31 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef ISOLATE_MUTATION_H_
+#define ISOLATE_MUTATION_H_
+
+#include <AminoAcid.h>
+#include <Nucleotide.h>
+
+/**
+ * A difference between a target and the reference, at an amino acid
+ * position of a region.
+ */
+class IsolateMutation
+{
+public:
+  int             region;      // index of the region in the reference
+  int             position;    // AA position in the region [1 -- N]
+  int             insertion;   // 0, or n for the n-th AA inserted after
+                               // position
+  int             alignedPos;  // AA position in the alignment
+  seq::AminoAcid  refAA;       // AminoAcid::GAP for an insertion
+  unsigned        targetAAs;   // bit (1 << AminoAcid::intRep()) for every
+                               // amino acid the target codon may encode
+  seq::Nucleotide refCodon[3];
+  seq::Nucleotide targetCodon[3];
+
+  bool hasTargetAA(const seq::AminoAcid aa) const {
+    return (targetAAs & (1u << aa.intRep())) != 0;
+  }
+};
+
+#endif // ISOLATE_MUTATION_H_
@@ -0,0 +1,171 @@
+#include "MutationCounts.h"
+#include "Alignment.h"
+
+#include <set>
+#include <thread>
+
+#include <AminoAcid.h>
+#include <Codon.h>
+
+MutationCounts::MutationCounts(const ReferenceSequence& ref,
+			       ExportAlphabet alphabet)
+  : ref_(ref),
+    alphabet_(alphabet)
+{
+  for (unsigned r = 0; r < ref_.regions().size(); ++r) {
+    const ReferenceSequence::Region& region = ref_.regions()[r];
+    int regionEnd = std::min(region.end(), (int)ref_.size() / 3);
+
+    Position empty;
+    empty.coverage = 0;
+    if (alphabet_ == AminoAcids)
+      empty.aminoAcids.assign(seq::AminoAcid::AA_J + 1, 0);
+
+    regions_.push_back(std::vector<Position>
+		       (std::max(0, regionEnd - region.begin()), empty));
+  }
+}
+
+unsigned MutationCounts::codon(seq::NTSequence::const_iterator triplet)
+{
+  return (triplet[0].intRep() << 8)
+    | (triplet[1].intRep() << 4)
+    | triplet[2].intRep();
+}
+
+void MutationCounts::add(const Alignment& result)
+{
+  if (!result.success)
+    return;
+
+  for (unsigned r = 0; r < regions_.size(); ++r) {
+    const ReferenceSequence::Region& region = ref_.regions()[r];
+    const Alignment::AlignedRegion& aligned = result.alignedRegion(r);
+    std::vector<Position>& positions = regions_[r];
+
+    int last = std::min(aligned.targetEnd,
+			region.begin() + (int)positions.size() - 1);
+
+    for (int p = aligned.targetBegin; p <= last; ++p) {
+      Position& position = positions[p - region.begin()];
+      seq::NTSequence::const_iterator triplet
+	= result.target.begin() + result.alignedPos(p) * 3;
+
+      ++position.coverage;
+
+      if (alphabet_ == AminoAcids) {
+	std::set<seq::AminoAcid> aas = seq::Codon::translateAll(triplet);
+	for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
+	     k != aas.end(); ++k)
+	  ++position.aminoAcids[k->intRep()];
+      } else
+	++position.codons[codon(triplet)];
+    }
+  }
+}
+
+void MutationCounts::addShare(MutationCounts *counts,
+			      const std::vector<Alignment> *results,
+			      unsigned begin, unsigned end)
+{
+  for (unsigned i = begin; i < end; ++i)
+    counts->add((*results)[i]);
+}
+
+void MutationCounts::add(const std::vector<Alignment>& results,
+			 unsigned threads)
+{
+  threads = std::max(1u, std::min(threads, (unsigned)results.size()));
+
+  if (threads == 1) {
+    for (unsigned i = 0; i < results.size(); ++i)
+      add(results[i]);
+    return;
+  }
+
+  /*
+   * Every thread counts a contiguous share of the results in its own
+   * histogram, so that no synchronization is needed until merging.
+   */
+  std::vector<MutationCounts> partial(threads,
+				      MutationCounts(ref_, alphabet_));
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; ++t) {
+    unsigned begin = results.size() * t / threads;
+    unsigned end = results.size() * (t + 1) / threads;
+    workers.push_back(std::thread(&addShare, &partial[t], &results,
+				  begin, end));
+  }
+
+  for (unsigned t = 0; t < threads; ++t) {
+    workers[t].join();
+    merge(partial[t]);
+  }
+}
+
+void MutationCounts::merge(const MutationCounts& other)
+{
+  for (unsigned r = 0; r < regions_.size(); ++r)
+    for (unsigned p = 0; p < regions_[r].size(); ++p) {
+      Position& position = regions_[r][p];
+      const Position& o = other.regions_[r][p];
+
+      position.coverage += o.coverage;
+      for (unsigned k = 0; k < position.aminoAcids.size(); ++k)
+	position.aminoAcids[k] += o.aminoAcids[k];
+      for (std::map<unsigned, unsigned>::const_iterator k = o.codons.begin();
+	   k != o.codons.end(); ++k)
+	position.codons[k->first] += k->second;
+    }
+}
+
+void MutationCounts::streamCsv(std::ostream& s) const
+{
+  if (alphabet_ == AminoAcids)
+    s << "region,position,reference,aminoacid,count,coverage,prevalence";
+  else
+    s << "region,position,reference,codon,count,coverage,prevalence";
+  s << std::endl;
+
+  for (unsigned r = 0; r < regions_.size(); ++r) {
+    const ReferenceSequence::Region& region = ref_.regions()[r];
+
+    for (unsigned p = 0; p < regions_[r].size(); ++p) {
+      const Position& position = regions_[r][p];
+      if (position.coverage == 0)
+	continue;
+
+      seq::NTSequence::const_iterator refTriplet
+	= ref_.begin() + (region.begin() + p) * 3;
+
+      if (alphabet_ == AminoAcids) {
+	char refAA = seq::Codon::translate(refTriplet).toChar();
+
+	for (unsigned k = 0; k < position.aminoAcids.size(); ++k)
+	  if (position.aminoAcids[k])
+	    s << region.prefix() << "," << p + 1 << "," << refAA << ","
+	      << seq::AminoAcid::fromRep(k).toChar() << ","
+	      << position.aminoAcids[k] << "," << position.coverage << ","
+	      << (double)position.aminoAcids[k] / position.coverage
+	      << std::endl;
+      } else {
+	std::string refCodon;
+	for (int k = 0; k < 3; ++k)
+	  refCodon += refTriplet[k].toChar();
+
+	for (std::map<unsigned, unsigned>::const_iterator k
+	       = position.codons.begin(); k != position.codons.end(); ++k) {
+	  std::string codon;
+	  codon += seq::Nucleotide::fromRep(k->first >> 8).toChar();
+	  codon += seq::Nucleotide::fromRep((k->first >> 4) & 0xF).toChar();
+	  codon += seq::Nucleotide::fromRep(k->first & 0xF).toChar();
+
+	  s << region.prefix() << "," << p + 1 << "," << refCodon << ","
+	    << codon << "," << k->second << "," << position.coverage << ","
+	    << (double)k->second / position.coverage << std::endl;
+	}
+      }
+    }
+  }
+}
@@ -0,0 +1,64 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef MUTATION_COUNTS_H_
+#define MUTATION_COUNTS_H_
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "ReferenceSequence.h"
+#include "ResultsExporter.h"
+
+class Alignment;
+
+/**
+ * Counts, for every position of every region of a reference, how many
+ * targets cover the position and how many of those have each amino acid
+ * (or codon) at that position.
+ *
+ * Only reference positions are counted, insertions are not. A target with
+ * an ambiguous codon counts once for each of the amino acids that it may
+ * encode.
+ */
+class MutationCounts
+{
+public:
+  MutationCounts(const ReferenceSequence& ref, ExportAlphabet alphabet);
+
+  /**
+   * Count a (successful) alignment.
+   */
+  void add(const Alignment& result);
+
+  /**
+   * Count all successful alignments, using up to threads threads that
+   * each count a share of the results, and are merged at the end.
+   */
+  void add(const std::vector<Alignment>& results, unsigned threads);
+
+  void merge(const MutationCounts& other);
+
+  /**
+   * Stream the prevalence table: a row for each amino acid (or codon)
+   * observed at each position.
+   */
+  void streamCsv(std::ostream& stream) const;
+
+private:
+  struct Position {
+    unsigned                     coverage;
+    std::vector<unsigned>        aminoAcids; // by AminoAcid::intRep()
+    std::map<unsigned, unsigned> codons;     // by codon()
+  };
+
+  const ReferenceSequence&             ref_;
+  ExportAlphabet                       alphabet_;
+  std::vector<std::vector<Position> >  regions_;
+
+  static unsigned codon(seq::NTSequence::const_iterator triplet);
+  static void addShare(MutationCounts *counts,
+		       const std::vector<Alignment> *results,
+		       unsigned begin, unsigned end);
+};
+
+#endif // MUTATION_COUNTS_H_
@@ -0,0 +1,217 @@
+#include "ReferencePanel.h"
+#include "Alignment.h"
+
+#include <algorithm>
+
+namespace {
+  /*
+   * Minimum number of shared k-mers to locate a reference, and maximum
+   * distance between diagonals of k-mers that vote for the same location.
+   */
+  const int MIN_VOTES = 4;
+  const int DIAGONAL_BAND = 32;
+}
+
+ReferencePanel::ReferencePanel(const std::vector<ReferenceSequence>& references)
+  : references_(references)
+{
+  std::vector<Kmer> k;
+  for (unsigned i = 0; i < references_.size(); ++i) {
+    codonRefs_.push_back(seq::CodonReference(references_[i]));
+    kmers(references_[i], i, k);
+    index_.insert(index_.end(), k.begin(), k.end());
+  }
+
+  std::sort(index_.begin(), index_.end());
+}
+
+/*
+ * Collects the k-mers of a sequence, 2 bits per nucleotide, with their
+ * position (of the first nucleotide). K-mers with ambiguous nucleotides
+ * are skipped, gaps are ignored.
+ */
+void ReferencePanel::kmers(const seq::NTSequence& seq, int reference,
+			   std::vector<Kmer>& result)
+{
+  const unsigned mask = (1u << (2 * K)) - 1;
+
+  result.clear();
+
+  std::vector<int> positions(K);
+  unsigned kmer = 0;
+  int length = 0;
+  for (unsigned i = 0; i < seq.size(); ++i) {
+    int rep = seq[i].intRep();
+    if (rep == seq::Nucleotide::NT_GAP)
+      continue;
+
+    if (rep > seq::Nucleotide::NT_T) {
+      length = 0;
+      continue;
+    }
+
+    kmer = ((kmer << 2) | rep) & mask;
+    positions[length % K] = i;
+    if (++length >= K) {
+      Kmer k;
+      k.kmer = kmer;
+      k.reference = reference;
+      k.position = positions[length % K];
+      result.push_back(k);
+    }
+  }
+}
+
+namespace {
+  struct ByCount {
+    const std::vector<int>& counts;
+
+    ByCount(const std::vector<int>& c) : counts(c) { }
+
+    bool operator()(int a, int b) const {
+      return counts[a] > counts[b];
+    }
+  };
+
+  struct ByKmer {
+    template <class A, class B>
+    bool operator()(const A& a, const B& b) const {
+      return a.kmer < b.kmer;
+    }
+  };
+}
+
+std::vector<int> ReferencePanel::classify(const seq::NTSequence& target,
+					  int topK) const
+{
+  std::vector<Kmer> k;
+  kmers(target, -1, k);
+  std::sort(k.begin(), k.end(), ByKmer());
+
+  std::vector<int> counts(references_.size(), 0);
+
+  std::vector<Kmer>::const_iterator i = index_.begin();
+  for (unsigned j = 0; j < k.size() && i != index_.end(); ++j) {
+    if (j > 0 && k[j].kmer == k[j - 1].kmer)
+      continue;
+
+    i = std::lower_bound(i, index_.end(), k[j], ByKmer());
+    int last = -1;
+    for (; i != index_.end() && i->kmer == k[j].kmer; ++i)
+      if (i->reference != last) {
+	++counts[i->reference];
+	last = i->reference;
+      }
+  }
+
+  std::vector<int> result;
+  for (unsigned r = 0; r < references_.size(); ++r)
+    result.push_back(r);
+
+  std::stable_sort(result.begin(), result.end(), ByCount(counts));
+
+  if (topK > 0 && (unsigned)topK < result.size())
+    result.resize(topK);
+
+  return result;
+}
+
+Alignment ReferencePanel::align(const seq::NTSequence& target,
+				seq::AlignmentAlgorithm* algorithm,
+				int maxFrameShifts, int topK) const
+{
+  std::vector<int> candidates = classify(target, topK);
+
+  Alignment best = Alignment::compute(references_[candidates[0]], target,
+				      algorithm, maxFrameShifts,
+				      &codonRefs_[candidates[0]]);
+
+  for (unsigned i = 1; i < candidates.size(); ++i) {
+    Alignment result = Alignment::compute(references_[candidates[i]], target,
+					  algorithm, maxFrameShifts,
+					  &codonRefs_[candidates[i]]);
+
+    if (result.success && (!best.success || result.score > best.score))
+      best = result;
+  }
+
+  return best;
+}
+
+void ReferencePanel::locate(const seq::NTSequence& target,
+			    std::vector<std::pair<int, int> >& windows) const
+{
+  std::vector<Kmer> k;
+  kmers(target, -1, k);
+
+  /*
+   * Diagonals of all k-mer hits, per reference.
+   */
+  std::vector<std::vector<int> > diagonals(references_.size());
+
+  for (unsigned j = 0; j < k.size(); ++j) {
+    std::pair<std::vector<Kmer>::const_iterator,
+	      std::vector<Kmer>::const_iterator> hits
+      = std::equal_range(index_.begin(), index_.end(), k[j], ByKmer());
+
+    for (std::vector<Kmer>::const_iterator i = hits.first; i != hits.second;
+	 ++i)
+      diagonals[i->reference].push_back(k[j].position - i->position);
+  }
+
+  windows.clear();
+  for (unsigned r = 0; r < references_.size(); ++r) {
+    std::vector<int>& d = diagonals[r];
+    std::sort(d.begin(), d.end());
+
+    /*
+     * The densest band of diagonals.
+     */
+    int bestVotes = 0, bestDiagonal = 0;
+    for (unsigned first = 0, last = 0; last < d.size(); ++last) {
+      while (d[last] - d[first] > DIAGONAL_BAND)
+	++first;
+      int votes = last - first + 1;
+      if (votes > bestVotes) {
+	bestVotes = votes;
+	bestDiagonal = d[first + votes / 2];
+      }
+    }
+
+    if (bestVotes < MIN_VOTES) {
+      windows.push_back(std::make_pair(0, (int)target.size()));
+      continue;
+    }
+
+    /*
+     * Leave room for indels on either side of the diagonal.
+     */
+    int length = references_[r].size();
+    int margin = 100 + length / 10;
+
+    int begin = std::max(0, bestDiagonal - margin);
+    int end = std::min((int)target.size(), bestDiagonal + length + margin);
+
+    windows.push_back(std::make_pair(begin, std::max(begin, end)));
+  }
+}
+
+void ReferencePanel::alignAll(const seq::NTSequence& target,
+			      seq::AlignmentAlgorithm* algorithm,
+			      int maxFrameShifts,
+			      std::vector<Alignment>& results) const
+{
+  std::vector<std::pair<int, int> > windows;
+  locate(target, windows);
+
+  results.clear();
+  for (unsigned r = 0; r < references_.size(); ++r) {
+    seq::NTSequence window(target.begin() + windows[r].first,
+			   target.begin() + windows[r].second);
+    window.setName(target.name());
+    window.setDescription(target.description());
+
+    results.push_back(Alignment::compute(references_[r], window, algorithm,
+					 maxFrameShifts, &codonRefs_[r]));
+  }
+}
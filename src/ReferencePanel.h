@@ -0,0 +1,96 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef REFERENCE_PANEL_H_
+#define REFERENCE_PANEL_H_
+
+#include <vector>
+
+#include <AlignmentAlgorithm.h>
+#include <CodonReference.h>
+
+#include "ReferenceSequence.h"
+
+class Alignment;
+
+/**
+ * A panel of references, indexed by their k-mers.
+ *
+ * The panel is either a set of alternative references (e.g. the DENV
+ * serotypes), against which each target is aligned with the reference that
+ * fits it best, or the ORFs of one genome, which are each located within
+ * a target genome.
+ *
+ * Candidate references are ranked with a k-mer classifier: the number of
+ * distinct k-mers that a target shares with each reference. Only the best
+ * ranking candidates are then fully aligned, and the best scoring of those
+ * alignments is kept.
+ *
+ * ORFs are located by voting with the shared k-mers for the diagonal
+ * (target position - reference position) on which the ORF lies; only the
+ * window of the target around that diagonal is then aligned.
+ */
+class ReferencePanel
+{
+public:
+  static const int K = 11;
+
+  ReferencePanel(const std::vector<ReferenceSequence>& references);
+
+  const std::vector<ReferenceSequence>& references() const {
+    return references_;
+  }
+
+  /**
+   * Returns (at most) the topK references sharing the most k-mers with the
+   * target, best first.
+   */
+  std::vector<int> classify(const seq::NTSequence& target, int topK) const;
+
+  /**
+   * Aligns the target against the topK candidate references, and returns
+   * the best scoring (successful) alignment.
+   */
+  Alignment align(const seq::NTSequence& target,
+		  seq::AlignmentAlgorithm* algorithm,
+		  int maxFrameShifts, int topK) const;
+
+  /**
+   * Locates every reference within the target: returns for each reference
+   * the window [begin, end[ of the target that contains it, or the entire
+   * target if it could not be located.
+   */
+  void locate(const seq::NTSequence& target,
+	      std::vector<std::pair<int, int> >& windows) const;
+
+  /**
+   * Aligns every reference against its window of the target.
+   */
+  void alignAll(const seq::NTSequence& target,
+		seq::AlignmentAlgorithm* algorithm,
+		int maxFrameShifts,
+		std::vector<Alignment>& results) const;
+
+private:
+  struct Kmer {
+    unsigned kmer;
+    int      reference;
+    int      position;
+
+    bool operator< (const Kmer& other) const {
+      if (kmer != other.kmer)
+	return kmer < other.kmer;
+      else if (reference != other.reference)
+	return reference < other.reference;
+      else
+	return position < other.position;
+    }
+  };
+
+  std::vector<ReferenceSequence>   references_;
+  std::vector<seq::CodonReference> codonRefs_; // by reference
+  std::vector<Kmer>                index_; // sorted
+
+  static void kmers(const seq::NTSequence& seq, int reference,
+		    std::vector<Kmer>& result);
+};
+
+#endif // REFERENCE_PANEL_H_
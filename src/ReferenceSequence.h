@@ -22,11 +22,6 @@ public:
     int         begin()   const { return begin_; }   // AA position [0 -- N[
     int         end()     const { return end_; }     // AA position [0 -- N[
     std::string prefix()  const { return prefix_; }
-    
-    // aligned positions of begin, end
-    int         alignedBegin, alignedEnd; // AA position [0 -- N[
-    // reference position of first/last non-gap in target within region
-    int         targetBegin, targetEnd;   // AA position [0 -- N[
 
   private:
     int                       begin_, end_;
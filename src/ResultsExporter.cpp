@@ -1,23 +1,39 @@
 #include "Utils.h"
 
 #include <set>
+#include <map>
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #include <AASequence.h>
 #include <Codon.h>
 
 #include "Alignment.h"
+#include "IsolateMutation.h"
+#include "ArrowWriter.h"
 #include "ResultsExporter.h"
 #include "ReferenceSequence.h"
+#include "ResultsStore.h"
+#include "AlignmentDeltas.h"
+#include "MutationCounts.h"
+#include "ConsensusCounts.h"
 
 ResultsExporter::ResultsExporter(const std::vector<Alignment>& results,
 				 ExportKind kind,
 				 ExportAlphabet alphabet,
-				 bool withInsertions)
+				 bool withInsertions,
+				 ExportFormat format,
+				 bool withReference)
   : results_(results),
     kind_(kind),
     alphabet_(alphabet),
-    withInsertions_(withInsertions)
+    withInsertions_(withInsertions),
+    format_(format),
+    withReference_(withReference),
+    threads_(1)
 { }
 
 void ResultsExporter::streamData(std::ostream& stream)
@@ -33,10 +49,28 @@ void ResultsExporter::streamData(std::ostream& stream)
     streamGlobalAlignment(stream);
     break;
   case PositionTable:
-    streamPositionTable(stream);
+    if (format_ == Arrow)
+      streamPositionTableArrow(stream);
+    else
+      streamPositionTable(stream);
     break;
   case MutationTable:
-    streamMutationTable(stream);
+    if (format_ == Arrow)
+      streamMutationTableArrow(stream);
+    else
+      streamMutationTable(stream);
+    break;
+  case Binary:
+    ResultsStore::write(results_, stream);
+    break;
+  case MutationFrequencies:
+    streamMutationFrequencies(stream);
+    break;
+  case Deltas:
+    AlignmentDeltas::write(results_, stream);
+    break;
+  case Consensus:
+    streamConsensus(stream);
   }
 }
 
@@ -57,13 +91,13 @@ void ResultsExporter::streamPairwiseAlignments(std::ostream& s)
     const Alignment& result = results_[i];
 
     if (alphabet_ == Nucleotides) {
-      seq::NTSequence seq = result.ref;
+      seq::NTSequence seq = result.alignedRef();
       seq.setDescription(seq.description() + " aligned for "
 			 + result.target.name());
       s << seq;
       s << result.target;
     } else {
-      seq::AASequence seq = ::translate(result.ref);
+      seq::AASequence seq = ::translate(result.alignedRef());
       seq.setDescription(seq.description() + " aligned for "
 			 + result.target.name());
       s << seq;
@@ -118,14 +152,281 @@ void alignToGlobalAlignment(seq::NTSequence& globalRef,
   assert(ref == globalRef);
 }
 
+/*
+ * Trims the insertions before the first and after the last reference
+ * nucleotide from the pairwise alignment of a result.
+ */
+void trimmedAlignment(const Alignment& result,
+		      seq::NTSequence& ref, seq::NTSequence& target)
+{
+  ref = result.alignedRef();
+  target = result.target;
+
+  while (ref[0] == seq::Nucleotide::GAP) {
+    ref.erase(ref.begin());
+    target.erase(target.begin());
+  }
+  while (ref[ref.size() - 1] == seq::Nucleotide::GAP) {
+    ref.erase(ref.begin() + ref.size() - 1);
+    target.erase(target.begin() + target.size() - 1);
+  }
+}
+
+/*
+ * The row of a (successful) result in the global alignment.
+ */
+void globalAlignmentRow(const seq::NTSequence& globalRef,
+			const Alignment& result, bool withInsertions,
+			seq::NTSequence& row)
+{
+  /*
+   * globalRef already has the insertions of every result, so that
+   * aligning to it leaves it unchanged.
+   */
+  seq::NTSequence ref, global = globalRef;
+  std::vector<seq::NTSequence> noTargets;
+
+  trimmedAlignment(result, ref, row);
+  alignToGlobalAlignment(global, noTargets, ref, row, withInsertions);
+}
+
+/*
+ * Streams the rows of the global alignment, one for every successful
+ * result, in chunks of rows that are aligned to the global reference and
+ * formatted in parallel: a fixed pool of threads takes the chunks in
+ * order, each formatted into its own buffer, while the calling thread
+ * writes the buffers in order. A thread takes no chunk that is more than
+ * two chunks per thread ahead of the one being written, so that the
+ * buffered output stays bounded.
+ */
+const unsigned ROW_CHUNK = 64;
+
+template <class RowFormatter>
+class RowStreamer
+{
+public:
+  RowStreamer(const std::vector<Alignment>& results,
+	      const seq::NTSequence& globalRef, bool withInsertions,
+	      const RowFormatter& formatter, unsigned threads);
+
+  void stream(std::ostream& s);
+
+private:
+  const std::vector<Alignment>& results_;
+  const seq::NTSequence&   globalRef_;
+  const bool               withInsertions_;
+  const RowFormatter&      formatter_;
+  std::vector<unsigned>    rows_; // indexes of the successful results
+  unsigned                 threads_, chunk_, window_;
+
+  std::mutex               mutex_;
+  std::condition_variable  formatted_, freed_;
+  unsigned                 next_;    // the next chunk to be formatted
+  unsigned                 written_; // chunks taken for writing
+  std::vector<std::string> buffers_; // by chunk % window_
+  std::vector<bool>        ready_;
+
+  unsigned chunks() const { return (rows_.size() + chunk_ - 1) / chunk_; }
+  void format(unsigned chunk, std::string& buffer) const;
+  void worker();
+};
+
+template <class RowFormatter>
+RowStreamer<RowFormatter>::RowStreamer(const std::vector<Alignment>& results,
+				       const seq::NTSequence& globalRef,
+				       bool withInsertions,
+				       const RowFormatter& formatter,
+				       unsigned threads)
+  : results_(results),
+    globalRef_(globalRef),
+    withInsertions_(withInsertions),
+    formatter_(formatter),
+    threads_(std::max(1u, threads)),
+    next_(0),
+    written_(0)
+{
+  for (unsigned i = 0; i < results.size(); ++i)
+    if (results[i].success)
+      rows_.push_back(i);
+
+  chunk_ = std::max(1u, std::min(ROW_CHUNK,
+				 (unsigned)(rows_.size() + threads_ - 1)
+				 / threads_));
+  window_ = 2 * threads_;
+  buffers_.resize(window_);
+  ready_.resize(window_, false);
 }
 
-void ResultsExporter
-::computeGlobalAlignment(seq::NTSequence& globalRef,
-			 std::vector<seq::NTSequence>& globalAlignment)
+template <class RowFormatter>
+void RowStreamer<RowFormatter>::format(unsigned chunk,
+				       std::string& buffer) const
 {
-  std::cerr << "Computing global alignment...";
-  globalRef = results_[0].ref;
+  std::ostringstream s;
+  seq::NTSequence row;
+
+  unsigned end = std::min((chunk + 1) * chunk_, (unsigned)rows_.size());
+  for (unsigned i = chunk * chunk_; i < end; ++i) {
+    globalAlignmentRow(globalRef_, results_[rows_[i]], withInsertions_, row);
+    formatter_(s, row);
+  }
+
+  buffer = s.str();
+}
+
+template <class RowFormatter>
+void RowStreamer<RowFormatter>::worker()
+{
+  for (;;) {
+    unsigned chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (next_ < chunks() && next_ >= written_ + window_)
+	freed_.wait(lock);
+
+      if (next_ == chunks())
+	return;
+
+      chunk = next_++;
+    }
+
+    std::string buffer;
+    format(chunk, buffer);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      buffers_[chunk % window_].swap(buffer);
+      ready_[chunk % window_] = true;
+    }
+    formatted_.notify_one();
+  }
+}
+
+template <class RowFormatter>
+void RowStreamer<RowFormatter>::stream(std::ostream& s)
+{
+  std::string buffer;
+
+  if (threads_ == 1) {
+    for (unsigned c = 0; c < chunks(); ++c) {
+      format(c, buffer);
+      s << buffer;
+    }
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads_; ++t)
+    workers.push_back(std::thread(&RowStreamer::worker, this));
+
+  for (unsigned c = 0; c < chunks(); ++c) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!ready_[c % window_])
+	formatted_.wait(lock);
+
+      buffer.swap(buffers_[c % window_]);
+      ready_[c % window_] = false;
+      ++written_;
+    }
+    freed_.notify_all();
+
+    s << buffer;
+  }
+
+  for (unsigned t = 0; t < workers.size(); ++t)
+    workers[t].join();
+}
+
+template <class RowFormatter>
+void streamRows(std::ostream& s,
+		const std::vector<Alignment>& results,
+		const seq::NTSequence& globalRef, bool withInsertions,
+		const RowFormatter& formatter, unsigned threads)
+{
+  RowStreamer<RowFormatter> streamer(results, globalRef, withInsertions,
+				     formatter, threads);
+  streamer.stream(s);
+}
+
+typedef std::vector<std::set<seq::AminoAcid> > ColumnAminoAcids;
+
+void addAminoAcids(const std::vector<Alignment> *results,
+		   const seq::NTSequence *globalRef, bool withInsertions,
+		   unsigned begin, unsigned end,
+		   ColumnAminoAcids *aminoAcids)
+{
+  seq::NTSequence seq;
+
+  for (unsigned i = begin; i < end; ++i) {
+    if (!(*results)[i].success)
+      continue;
+
+    globalAlignmentRow(*globalRef, (*results)[i], withInsertions, seq);
+
+    for (unsigned j = 0; j + 2 < seq.size(); j += 3) {
+      std::set<seq::AminoAcid> 
+	aas = seq::Codon::translateAll(seq.begin() + j);
+
+      for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
+	   k != aas.end(); ++k)
+	if (*k != seq::AminoAcid::GAP)
+	  (*aminoAcids)[j/3].insert(*k);
+    }
+  }
+}
+
+/*
+ * The amino acids that are found in every (aligned AA) column of the
+ * global alignment, which are the columns of the MutationTable.
+ */
+void columnAminoAcids(const std::vector<Alignment>& results,
+		      const seq::NTSequence& globalRef, bool withInsertions,
+		      unsigned threads, ColumnAminoAcids& aminoAcids)
+{
+  threads = std::max(1u, std::min(threads, (unsigned)results.size()));
+
+  /*
+   * Every thread adds the rows of a contiguous share of the results to
+   * its own sets, which are merged.
+   */
+  std::vector<ColumnAminoAcids> partial
+    (threads, ColumnAminoAcids(globalRef.size() / 3));
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; ++t) {
+    unsigned begin = results.size() * t / threads;
+    unsigned end = results.size() * (t + 1) / threads;
+    workers.push_back(std::thread(&addAminoAcids, &results, &globalRef,
+				  withInsertions, begin, end, &partial[t]));
+  }
+
+  for (unsigned t = 0; t < threads; ++t) {
+    workers[t].join();
+    if (t == 0)
+      aminoAcids.swap(partial[0]);
+    else
+      for (unsigned j = 0; j < aminoAcids.size(); ++j)
+	aminoAcids[j].insert(partial[t][j].begin(), partial[t][j].end());
+  }
+}
+
+struct FastaRow {
+  ExportAlphabet alphabet;
+
+  void operator()(std::ostream& s, const seq::NTSequence& seq) const {
+    if (alphabet == Nucleotides)
+      s << seq;
+    else
+      s << ::translate(seq);
+  }
+};
+
+}
+
+void ResultsExporter::computeGlobalReference(seq::NTSequence& globalRef)
+{
+  log_line("Computing global alignment...");
+  globalRef = results_[0].alignedRef();
 
   if (!withInsertions_) {
     for (;;) {
@@ -136,41 +437,26 @@ void ResultsExporter
       else
 	break;
     }
-  } else {
-    /*
-     * No insertions before first and after last nucleotide
-     */
-    while (globalRef[0] == seq::Nucleotide::GAP)
-      globalRef.erase(globalRef.begin());
-    while (globalRef[globalRef.size() - 1] == seq::Nucleotide::GAP)
-      globalRef.erase(globalRef.begin() + globalRef.size() - 1);
+
+    return;
   }
 
+  /*
+   * No insertions before first and after last nucleotide
+   */
+  while (globalRef[0] == seq::Nucleotide::GAP)
+    globalRef.erase(globalRef.begin());
+  while (globalRef[globalRef.size() - 1] == seq::Nucleotide::GAP)
+    globalRef.erase(globalRef.begin() + globalRef.size() - 1);
+
+  std::vector<seq::NTSequence> noTargets;
   for (unsigned j = 0; j < results_.size(); ++j) {
     if (results_[j].success) {
-      seq::NTSequence ref = results_[j].ref;
-      seq::NTSequence target = results_[j].target;
-
-      /*
-       * No insertions before first and after last nucleotide
-       */
-      while (ref[0] == seq::Nucleotide::GAP) {
-	ref.erase(ref.begin());
-	target.erase(target.begin());
-      }
-      while (ref[ref.size() - 1] == seq::Nucleotide::GAP) {
-	ref.erase(ref.begin() + ref.size() - 1);
-	target.erase(target.begin() + target.size() - 1);
-      }
-
-      alignToGlobalAlignment(globalRef, globalAlignment, ref, target,
-			     withInsertions_);
-
-      globalAlignment.push_back(target);
+      seq::NTSequence ref, target;
+      trimmedAlignment(results_[j], ref, target);
+      alignToGlobalAlignment(globalRef, noTargets, ref, target, true);
     }
   }
-
-  std::cerr << " done." << std::endl;
 }
 
 void ResultsExporter::streamGlobalAlignment(std::ostream& s)
@@ -179,35 +465,20 @@ void ResultsExporter::streamGlobalAlignment(std::ostream& s)
     return;
 
   seq::NTSequence globalRef;
-  std::vector<seq::NTSequence> globalAlignment;
-  computeGlobalAlignment(globalRef, globalAlignment);
+  computeGlobalReference(globalRef);
 
-  if (alphabet_ == Nucleotides) {
-    for (unsigned i = 0; i < globalAlignment.size(); ++i)
-      s << globalAlignment[i];
-  } else {
-    for (unsigned i = 0; i < globalAlignment.size(); ++i)
-      s << ::translate(globalAlignment[i]);
-  }
+  FastaRow row = { alphabet_ };
+  streamRows(s, results_, globalRef, withInsertions_, row, threads_);
 }
 
 void ResultsExporter::streamConsensusSequence(std::ostream& s)
 {
-	if (results_.empty())
-		return;
-
-	seq::NTSequence globalRef;
-	std::vector<seq::NTSequence> globalAlignment;
-	computeGlobalAlignment(globalRef, globalAlignment);
-	
-	s << ">consensus" << std::endl;
-	for (unsigned pos = 0; pos < globalRef.size(); ++pos) {
-		std::set<seq::Nucleotide> all;
-		for (unsigned i = 0; i < globalAlignment.size(); ++i) {
-			all.insert(globalAlignment[i][pos]);
-		}
-		s << seq::Nucleotide::singleNucleotide(all);
-	}
+  if (results_.empty())
+    return;
+
+  ConsensusCounts counts(results_[0].reference());
+  counts.add(results_, threads_);
+  counts.streamConsensus(s, withInsertions_);
 }
 
 namespace {
@@ -232,6 +503,135 @@ int alignedAAPos(const seq::NTSequence& seq, int aapos)
   return j;
 }
 
+/*
+ * The columns of the global alignment spanned by a region, as aligned AA
+ * positions [first, last]. These are the same for every row of a table.
+ */
+struct RegionColumns {
+  int first, last;
+};
+
+std::vector<RegionColumns> regionColumns(const seq::NTSequence& globalRef,
+					 const ReferenceSequence& ref)
+{
+  std::vector<RegionColumns> result;
+
+  for (unsigned r = 0; r < ref.regions().size(); ++r) {
+    const ReferenceSequence::Region& region = ref.regions()[r];
+
+    RegionColumns c;
+    c.first = alignedAAPos(globalRef, region.begin());
+    c.last = alignedAAPos(globalRef, region.end() - 1);
+    result.push_back(c);
+  }
+
+  return result;
+}
+
+struct PositionTableRow {
+  const std::vector<RegionColumns>& columns;
+  ExportAlphabet alphabet;
+
+  void operator()(std::ostream& s, const seq::NTSequence& seq) const;
+};
+
+void PositionTableRow::operator()(std::ostream& s,
+				  const seq::NTSequence& seq) const
+{
+  s << seq.name();
+
+  for (unsigned r = 0; r < columns.size(); ++r) {
+    int first = columns[r].first;
+    int last = columns[r].last;
+
+    int seqLast = last;
+    while ((seqLast >= first)
+	   && (seq[seqLast * 3] == seq::Nucleotide::GAP))
+      --seqLast;
+
+    bool beforeFirst = true;
+
+    for (int j = first; j <= seqLast; ++j) {
+      if (seq[j*3] == seq::Nucleotide::GAP && beforeFirst) {
+	if (alphabet == Nucleotides)
+	  s << ",,,";
+	else
+	  s << ",";
+      } else {
+	beforeFirst = false;
+	if (alphabet == Nucleotides)
+	  s << "," << seq[j*3]
+	    << "," << seq[j*3 + 1]
+	    << "," << seq[j*3 + 2];
+	else {
+	  std::set<seq::AminoAcid>
+	    aas = seq::Codon::translateAll(seq.begin() + j*3);
+
+	  s << ",";
+	  for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
+	       k != aas.end(); ++k)
+	    s << *k;
+	}
+      }
+    }
+
+    for (int j = seqLast+1; j <= last; ++j) {
+      if (alphabet == Nucleotides)
+	s << ",,,";
+      else
+	s << ",";
+    }
+  }
+
+  s << std::endl;
+}
+
+struct MutationTableRow {
+  const std::vector<RegionColumns>& columns;
+  const std::vector<std::set<seq::AminoAcid> >& aminoAcids;
+
+  void operator()(std::ostream& s, const seq::NTSequence& seq) const;
+};
+
+void MutationTableRow::operator()(std::ostream& s,
+				  const seq::NTSequence& seq) const
+{
+  s << seq.name();
+
+  for (unsigned r = 0; r < columns.size(); ++r) {
+    int first = columns[r].first;
+    int last = columns[r].last;
+
+    int seqLast = last;
+    while ((seqLast >= first)
+	   && (seq[seqLast * 3] == seq::Nucleotide::GAP))
+      --seqLast;
+
+    bool beforeFirst = true;
+
+    for (int j = first; j <= last; ++j) {
+      if (seq[j*3] != seq::Nucleotide::GAP)
+	beforeFirst = false;
+
+      std::set<seq::AminoAcid>
+	aas = seq::Codon::translateAll(seq.begin() + j*3);
+
+      for (std::set<seq::AminoAcid>::const_iterator
+	     k = aminoAcids[j].begin();
+	   k != aminoAcids[j].end(); ++k)
+	if (aas.find(*k) != aas.end())
+	  s << ",y";
+	else
+	  if (beforeFirst || j > seqLast)
+	    s << ",";
+	  else
+	    s << ",n";
+    }
+  }
+
+  s << std::endl;
+}
+
 }
 
 void ResultsExporter::streamPositionTable(std::ostream& s)
@@ -239,19 +639,20 @@ void ResultsExporter::streamPositionTable(std::ostream& s)
   if (results_.empty())
     return;
 
-  const ReferenceSequence& ref = results_[0].ref;
+  const ReferenceSequence& ref = results_[0].reference();
 
   seq::NTSequence globalRef;
-  std::vector<seq::NTSequence> globalAlignment;
-  computeGlobalAlignment(globalRef, globalAlignment);
+  computeGlobalReference(globalRef);
+
+  std::vector<RegionColumns> columns = regionColumns(globalRef, ref);
 
   s << "seqid";
 
   for (unsigned r = 0; r < ref.regions().size(); ++r) {
     const ReferenceSequence::Region& region = ref.regions()[r];
 
-    int first = alignedAAPos(globalRef, region.begin());
-    int last = alignedAAPos(globalRef, region.end() - 1);
+    int first = columns[r].first;
+    int last = columns[r].last;
 
     int pos = 0;
     int insert = 0;
@@ -281,58 +682,8 @@ void ResultsExporter::streamPositionTable(std::ostream& s)
   }
   s << std::endl;
 
-  for (unsigned i = 0; i < globalAlignment.size(); ++i) {
-    const seq::NTSequence& seq = globalAlignment[i];
-
-    s << seq.name();
-
-    for (unsigned r = 0; r < ref.regions().size(); ++r) {
-      const ReferenceSequence::Region& region = ref.regions()[r];
-
-      int first = alignedAAPos(globalRef, region.begin());
-      int last = alignedAAPos(globalRef, region.end() - 1);
-
-      int seqLast = last;
-      while ((seqLast >= first)
-	     && (seq[seqLast * 3] == seq::Nucleotide::GAP))
-	--seqLast;
-
-      bool beforeFirst = true;
-
-      for (int j = first; j <= seqLast; ++j) {
-	if (seq[j*3] == seq::Nucleotide::GAP && beforeFirst) {
-	  if (alphabet_ == Nucleotides)
-	    s << ",,,";
-	  else
-	    s << ",";
-	} else {
-	  beforeFirst = false;
-	  if (alphabet_ == Nucleotides)
-	    s << "," << seq[j*3]
-	      << "," << seq[j*3 + 1]
-	      << "," << seq[j*3 + 2];
-	  else {
-	    std::set<seq::AminoAcid>
-	      aas = seq::Codon::translateAll(seq.begin() + j*3);
-
-	    s << ",";
-	    for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
-		 k != aas.end(); ++k)
-	      s << *k;
-	  }
-	}
-      }
-
-      for (int j = seqLast+1; j <= last; ++j) {
-	if (alphabet_ == Nucleotides)
-	  s << ",,,";
-	else
-	  s << ",";
-      }
-    }
-
-    s << std::endl;
-  }
+  PositionTableRow row = { columns, alphabet_ };
+  streamRows(s, results_, globalRef, withInsertions_, row, threads_);
 }
 
 void ResultsExporter::streamMutationTable(std::ostream& s)
@@ -340,37 +691,24 @@ void ResultsExporter::streamMutationTable(std::ostream& s)
   if (results_.empty())
     return;
 
-  const ReferenceSequence& ref = results_[0].ref;
+  const ReferenceSequence& ref = results_[0].reference();
 
   seq::NTSequence globalRef;
-  std::vector<seq::NTSequence> globalAlignment;
-  computeGlobalAlignment(globalRef, globalAlignment);
-
-  std::vector<std::set<seq::AminoAcid> > aminoAcids;
-  for (unsigned j = 0; j < globalRef.size(); ++j)
-    aminoAcids.push_back(std::set<seq::AminoAcid>());
-
-  for (unsigned i = 0; i < globalAlignment.size(); ++i) {
-    const seq::NTSequence& seq = globalAlignment[i];
+  computeGlobalReference(globalRef);
 
-    for (unsigned j = 0; j < seq.size(); j += 3) {
-      std::set<seq::AminoAcid> 
-	aas = seq::Codon::translateAll(seq.begin() + j);
+  std::vector<RegionColumns> columns = regionColumns(globalRef, ref);
 
-      for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
-	   k != aas.end(); ++k)
-	if (*k != seq::AminoAcid::GAP)
-	  aminoAcids[j/3].insert(*k);
-    }
-  }
+  ColumnAminoAcids aminoAcids;
+  columnAminoAcids(results_, globalRef, withInsertions_, threads_,
+		   aminoAcids);
 
   s << "seqid";
 
   for (unsigned r = 0; r < ref.regions().size(); ++r) {
     const ReferenceSequence::Region& region = ref.regions()[r];
 
-    int first = alignedAAPos(globalRef, region.begin());
-    int last = alignedAAPos(globalRef, region.end() - 1);
+    int first = columns[r].first;
+    int last = columns[r].last;
 
     int pos = 0;
     int insert = 0;
@@ -396,46 +734,29 @@ void ResultsExporter::streamMutationTable(std::ostream& s)
 
   s << std::endl;
 
-  for (unsigned i = 0; i < globalAlignment.size(); ++i) {
-    const seq::NTSequence& seq = globalAlignment[i];
-
-    s << seq.name();
-
-    for (unsigned r = 0; r < ref.regions().size(); ++r) {
-      const ReferenceSequence::Region& region = ref.regions()[r];
+  MutationTableRow row = { columns, aminoAcids };
+  streamRows(s, results_, globalRef, withInsertions_, row, threads_);
+}
 
-      int first = alignedAAPos(globalRef, region.begin());
-      int last = alignedAAPos(globalRef, region.end() - 1);
+namespace {
 
-      int seqLast = last;
-      while ((seqLast >= first)
-	     && (seq[seqLast * 3] == seq::Nucleotide::GAP))
-	--seqLast;
+void streamMutations(std::ostream& s,
+		     const std::vector<IsolateMutation>& mutations)
+{
+  for (unsigned i = 0; i < mutations.size(); ++i) {
+    const IsolateMutation& m = mutations[i];
 
-      bool beforeFirst = true;
+    if (i > 0)
+      s << ' ';
 
-      for (int j = first; j <= last; ++j) {
-	if (seq[j*3] != seq::Nucleotide::GAP)
-	  beforeFirst = false;
+    s << m.refAA.toChar() << m.position;
 
-	std::set<seq::AminoAcid>
-	  aas = seq::Codon::translateAll(seq.begin() + j*3);
-
-	for (std::set<seq::AminoAcid>::const_iterator 
-	       k = aminoAcids[j].begin();
-	     k != aminoAcids[j].end(); ++k)
-	  if (aas.find(*k) != aas.end())
-	    s << ",y";
-	  else
-	    if (beforeFirst || j > seqLast)
-	      s << ",";
-	    else
-	      s << ",n";
-      }
-    }
+    for (int k = 0; k <= seq::AminoAcid::AA_J; ++k)
+      if (m.targetAAs & (1u << k))
+	s << seq::AminoAcid::fromRep(k).toChar();
+  }
+}
 
-    s << std::endl;
-  }  
 }
 
 void ResultsExporter::streamMutationsCsv(std::ostream& s)
@@ -443,9 +764,12 @@ void ResultsExporter::streamMutationsCsv(std::ostream& s)
   if (results_.empty())
     return;
 
-  const ReferenceSequence& ref = results_[0].ref;
+  const ReferenceSequence& ref = results_[0].reference();
 
-  s << "seqid,status,score,frameshifts";
+  s << "seqid";
+  if (withReference_)
+    s << ",reference";
+  s << ",status,score,frameshifts";
 
   for (unsigned i = 0; i < ref.regions().size(); ++i) {
     std::string prefix;
@@ -458,11 +782,16 @@ void ResultsExporter::streamMutationsCsv(std::ostream& s)
   }
   s << std::endl;
 
+  std::vector<IsolateMutation> mutations;
+
   for (unsigned i = 0; i < results_.size(); ++i) {
     const Alignment& result = results_[i];
 
     s << result.target.name();
 
+    if (withReference_)
+      s << "," << result.reference().name();
+
     if (result.success)
       s << ",Success";
     else if (result.tooShort)
@@ -476,10 +805,10 @@ void ResultsExporter::streamMutationsCsv(std::ostream& s)
       s << "," << result.score
 	<< "," << result.correctedFrameshifts;
 
-      for (unsigned i = 0; i < result.ref.regions().size(); ++i) {
-	const ReferenceSequence::Region& region = result.ref.regions()[i];
-	int begin = region.targetBegin;
-	int end = region.targetEnd;
+      for (unsigned i = 0; i < result.reference().regions().size(); ++i) {
+	const ReferenceSequence::Region& region = result.reference().regions()[i];
+	int begin = result.alignedRegion(i).targetBegin;
+	int end = result.alignedRegion(i).targetEnd;
 
 	if (begin < end)
 	  s << "," << begin - region.begin() + 1
@@ -487,14 +816,266 @@ void ResultsExporter::streamMutationsCsv(std::ostream& s)
 	else
 	  s << ",,";
 
-	s << "," << result.mutations(region);
+	result.isolateMutations(i, mutations);
+	s << ",";
+	streamMutations(s, mutations);
       }
     } else {
       s << ",,";
-      for (unsigned i = 0; i < result.ref.regions().size(); ++i)
+      for (unsigned i = 0; i < result.reference().regions().size(); ++i)
 	s << ",";
     }
 
     s << std::endl;
   }
 }
+
+namespace {
+
+/*
+ * Computes the PositionTable cells of one row (a sequence of the global
+ * alignment), as in streamPositionTable(). An empty cell means that the
+ * sequence does not cover the position.
+ */
+void positionTableRow(const std::vector<RegionColumns>& columns,
+		      ExportAlphabet alphabet,
+		      const seq::NTSequence& seq,
+		      std::vector<std::string>& cells)
+{
+  cells.clear();
+
+  for (unsigned r = 0; r < columns.size(); ++r) {
+    int first = columns[r].first;
+    int last = columns[r].last;
+
+    int seqLast = last;
+    while ((seqLast >= first)
+	   && (seq[seqLast * 3] == seq::Nucleotide::GAP))
+      --seqLast;
+
+    bool beforeFirst = true;
+
+    for (int j = first; j <= last; ++j) {
+      if (j > seqLast || (seq[j*3] == seq::Nucleotide::GAP && beforeFirst)) {
+	cells.insert(cells.end(), alphabet == Nucleotides ? 3 : 1,
+		     std::string());
+      } else {
+	beforeFirst = false;
+	if (alphabet == Nucleotides) {
+	  for (int k = 0; k < 3; ++k)
+	    cells.push_back(std::string(1, seq[j*3 + k].toChar()));
+	} else {
+	  std::set<seq::AminoAcid>
+	    aas = seq::Codon::translateAll(seq.begin() + j*3);
+
+	  std::string cell;
+	  for (std::set<seq::AminoAcid>::const_iterator k = aas.begin();
+	       k != aas.end(); ++k)
+	    cell += k->toChar();
+	  cells.push_back(cell);
+	}
+      }
+    }
+  }
+}
+
+}
+
+void ResultsExporter::streamPositionTableArrow(std::ostream& s)
+{
+  ArrowWriter writer(s);
+
+  if (results_.empty()) {
+    writer.close();
+    return;
+  }
+
+  const ReferenceSequence& ref = results_[0].reference();
+
+  seq::NTSequence globalRef;
+  computeGlobalReference(globalRef);
+
+  std::vector<RegionColumns> columns = regionColumns(globalRef, ref);
+
+  writer.addColumn("seqid", ArrowWriter::Utf8);
+
+  for (unsigned r = 0; r < ref.regions().size(); ++r) {
+    const ReferenceSequence::Region& region = ref.regions()[r];
+
+    int first = columns[r].first;
+    int last = columns[r].last;
+
+    int pos = 0;
+    int insert = 0;
+
+    for (int j = first; j <= last; ++j) {
+      std::string varName;
+      if (globalRef[j*3] != seq::Nucleotide::GAP) {
+	++pos;
+	varName = region.prefix() + "_" + to_string(pos);
+	insert = 0;
+      } else {
+	++insert;
+	varName = region.prefix() + "_" + to_string(pos)
+	  + "ins" + to_string(insert);
+      }
+
+      if (alphabet_ == Nucleotides)
+	for (int k = 1; k <= 3; ++k)
+	  writer.addColumn(varName + "_" + to_string(k),
+			   ArrowWriter::DictionaryUtf8,
+			   seq::Nucleotide::NT_N + 2);
+      else
+	writer.addColumn(varName, ArrowWriter::DictionaryUtf8);
+    }
+  }
+
+  /*
+   * Every row is written as it is aligned to the global reference, with
+   * the new values of the dictionaries.
+   */
+  std::vector<std::string> cells;
+  seq::NTSequence row;
+
+  for (unsigned i = 0; i < results_.size(); ++i) {
+    if (!results_[i].success)
+      continue;
+
+    globalAlignmentRow(globalRef, results_[i], withInsertions_, row);
+
+    writer.appendString(0, row.name());
+
+    positionTableRow(columns, alphabet_, row, cells);
+    for (unsigned c = 0; c < cells.size(); ++c)
+      if (cells[c].empty())
+	writer.appendNull(c + 1);
+      else
+	writer.appendString(c + 1, cells[c]);
+
+    writer.endRow();
+  }
+
+  writer.close();
+}
+
+void ResultsExporter::streamMutationTableArrow(std::ostream& s)
+{
+  ArrowWriter writer(s);
+
+  if (results_.empty()) {
+    writer.close();
+    return;
+  }
+
+  const ReferenceSequence& ref = results_[0].reference();
+
+  seq::NTSequence globalRef;
+  computeGlobalReference(globalRef);
+
+  std::vector<RegionColumns> columns = regionColumns(globalRef, ref);
+
+  /*
+   * The columns depend on the amino acids found in all rows, which are
+   * thus aligned to the global reference twice: first (in parallel) to
+   * find these, and then to write them.
+   */
+  ColumnAminoAcids aminoAcids;
+  columnAminoAcids(results_, globalRef, withInsertions_, threads_,
+		   aminoAcids);
+
+  writer.addColumn("seqid", ArrowWriter::Utf8);
+
+  for (unsigned r = 0; r < ref.regions().size(); ++r) {
+    const ReferenceSequence::Region& region = ref.regions()[r];
+
+    int first = columns[r].first;
+    int last = columns[r].last;
+
+    int pos = 0;
+    int insert = 0;
+
+    for (int j = first; j <= last; ++j) {
+      std::string varName;
+      if (globalRef[j*3] != seq::Nucleotide::GAP) {
+	++pos;
+	varName = region.prefix() + "_" + to_string(pos);
+	insert = 0;
+      } else {
+	++insert;
+	varName = region.prefix() + "_" + to_string(pos)
+	  + "ins" + to_string(insert);
+      }
+
+      for (std::set<seq::AminoAcid>::const_iterator k = aminoAcids[j].begin();
+	   k != aminoAcids[j].end(); ++k)
+	writer.addColumn(varName + k->toChar(), ArrowWriter::Bool);
+    }
+  }
+
+  seq::NTSequence seq;
+
+  for (unsigned i = 0; i < results_.size(); ++i) {
+    if (!results_[i].success)
+      continue;
+
+    globalAlignmentRow(globalRef, results_[i], withInsertions_, seq);
+
+    writer.appendString(0, seq.name());
+    int column = 1;
+
+    for (unsigned r = 0; r < columns.size(); ++r) {
+      int first = columns[r].first;
+      int last = columns[r].last;
+
+      int seqLast = last;
+      while ((seqLast >= first)
+	     && (seq[seqLast * 3] == seq::Nucleotide::GAP))
+	--seqLast;
+
+      bool beforeFirst = true;
+
+      for (int j = first; j <= last; ++j) {
+	if (seq[j*3] != seq::Nucleotide::GAP)
+	  beforeFirst = false;
+
+	std::set<seq::AminoAcid>
+	  aas = seq::Codon::translateAll(seq.begin() + j*3);
+
+	for (std::set<seq::AminoAcid>::const_iterator 
+	       k = aminoAcids[j].begin();
+	     k != aminoAcids[j].end(); ++k, ++column)
+	  if (aas.find(*k) != aas.end())
+	    writer.appendBool(column, true);
+	  else
+	    if (beforeFirst || j > seqLast)
+	      writer.appendNull(column);
+	    else
+	      writer.appendBool(column, false);
+      }
+    }
+
+    writer.endRow();
+  }
+
+  writer.close();
+}
+
+void ResultsExporter::streamMutationFrequencies(std::ostream& s)
+{
+  if (results_.empty())
+    return;
+
+  MutationCounts counts(results_[0].reference(), alphabet_);
+  counts.add(results_, threads_);
+  counts.streamCsv(s);
+}
+
+void ResultsExporter::streamConsensus(std::ostream& s)
+{
+  if (results_.empty())
+    return;
+
+  ConsensusCounts counts(results_[0].reference());
+  counts.add(results_, threads_);
+  counts.streamCsv(s, withInsertions_);
+}
@@ -7,18 +7,33 @@
 
 class Alignment;
 
+namespace seq {
+  class NTSequence;
+};
+
 enum ExportKind { Mutations, PairwiseAlignments, GlobalAlignment,
-		  PositionTable, MutationTable };
+		  PositionTable, MutationTable, Binary, MutationFrequencies,
+		  Deltas, Consensus };
 enum ExportAlphabet { Nucleotides, AminoAcids };
+enum ExportFormat { Csv, Arrow };
 
 class ResultsExporter
 {
 public:
   ResultsExporter(const std::vector<Alignment>& results, ExportKind kind,
-		  ExportAlphabet alphabet, bool withInsertions = false);
+		  ExportAlphabet alphabet, bool withInsertions = false,
+		  ExportFormat format = Csv, bool withReference = false);
 
   ExportKind     kind()     const { return kind_; }
   ExportAlphabet alphabet() const { return alphabet_; }
+  ExportFormat   format()   const { return format_; }
+
+  // whether the Mutations CSV has a column with the reference of each target
+  bool           withReference() const { return withReference_; }
+
+  // the number of threads that format or count the results (default 1)
+  void setThreads(unsigned threads) { threads_ = threads; }
+  unsigned threads() const { return threads_; }
 
   void streamData(std::ostream& stream);
 	void streamConsensusSequence(std::ostream& stream);
@@ -28,14 +43,20 @@ private:
   const ExportKind      kind_;
   const ExportAlphabet  alphabet_;
   const bool            withInsertions_;
+  const ExportFormat    format_;
+  const bool            withReference_;
+  unsigned              threads_;
 
   void streamMutationsCsv(std::ostream& stream);
   void streamPairwiseAlignments(std::ostream& stream);
   void streamPositionTable(std::ostream& stream);
   void streamMutationTable(std::ostream& stream);
+  void streamPositionTableArrow(std::ostream& stream);
+  void streamMutationTableArrow(std::ostream& stream);
+  void streamMutationFrequencies(std::ostream& stream);
+  void streamConsensus(std::ostream& stream);
 
-  void computeGlobalAlignment(seq::NTSequence& globalRef,
-			      std::vector<seq::NTSequence>& globalAlignment);
+  void computeGlobalReference(seq::NTSequence& globalRef);
   void streamGlobalAlignment(std::ostream& stream);
 };
 
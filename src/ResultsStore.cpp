@@ -0,0 +1,440 @@
+#include "Utils.h"
+
+#include "ResultsStore.h"
+#include "Alignment.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+  const char MAGIC[8] = { 'V', 'I', 'R', 'U', 'L', 'I', 'G', 'N' };
+  const unsigned BYTE_ORDER_MARK = 0x01020304;
+  const unsigned VERSION = 1;
+
+  enum Section {
+    REFERENCE,    // reference name, description, sequence and regions
+    STATUS,       // uint8 per target
+    SCORE,        // double per target
+    FRAMESHIFTS,  // int32 per target
+    RANGES,       // int32 [alignedBegin, alignedEnd, targetBegin, targetEnd]
+                  //   per region per target
+    NAME_INDEX,   // uint64 offsets into NAMES, per target + 1
+    NAMES,        // "name\0description\0" per target
+    EDIT_INDEX,   // uint64 offsets (in int32 units) into EDITS, per target + 1
+    EDITS,        // int32 runs: n, (pos, length) x n for the reference,
+                  //   then the same for the target
+    SEQ_INDEX,    // uint64 offsets (in nucleotides) into SEQS, per target + 1
+    SEQS,         // 4-bit packed ungapped target nucleotides
+    SECTION_COUNT
+  };
+
+  struct Header {
+    char     magic[8];
+    unsigned byteOrder;
+    unsigned version;
+    unsigned targetCount;
+    unsigned regionCount;
+    unsigned long long offset[SECTION_COUNT];
+    unsigned long long size[SECTION_COUNT];
+  };
+
+  typedef std::vector<char> Buffer;
+
+  template <typename T>
+  void append(Buffer& b, const T& v)
+  {
+    const char *p = reinterpret_cast<const char *>(&v);
+    b.insert(b.end(), p, p + sizeof(T));
+  }
+
+  void appendString(Buffer& b, const std::string& s)
+  {
+    append(b, (unsigned)s.size());
+    b.insert(b.end(), s.begin(), s.end());
+  }
+
+  std::string readString(const char *& p)
+  {
+    unsigned length;
+    std::memcpy(&length, p, sizeof(length));
+    p += sizeof(length);
+    std::string result(p, length);
+    p += length;
+    return result;
+  }
+
+  void appendGapRuns(Buffer& b, const seq::NTSequence& s)
+  {
+    std::vector<int> runs;
+    for (unsigned i = 0; i < s.size(); ++i)
+      if (s[i] == seq::Nucleotide::GAP) {
+	unsigned j = i;
+	while (j < s.size() && s[j] == seq::Nucleotide::GAP)
+	  ++j;
+	runs.push_back(i);
+	runs.push_back(j - i);
+	i = j;
+      }
+
+    append(b, (int)runs.size() / 2);
+    for (unsigned i = 0; i < runs.size(); ++i)
+      append(b, runs[i]);
+  }
+
+  /*
+   * Reinserts the gap runs into an ungapped sequence, advancing runs past
+   * the runs that were used.
+   */
+  void insertGapRuns(const int *& runs, std::vector<seq::Nucleotide>& s)
+  {
+    int n = *runs++;
+    if (n == 0)
+      return;
+
+    std::vector<seq::Nucleotide> result;
+    unsigned next = 0;
+    for (int k = 0; k < n; ++k) {
+      int pos = runs[2*k], length = runs[2*k + 1];
+      unsigned copy = pos - result.size();
+      result.insert(result.end(), s.begin() + next, s.begin() + next + copy);
+      next += copy;
+      result.insert(result.end(), length, seq::Nucleotide::GAP);
+    }
+    result.insert(result.end(), s.begin() + next, s.end());
+    runs += 2 * n;
+
+    s.swap(result);
+  }
+
+  void pad(Buffer& b)
+  {
+    while (b.size() % 8)
+      b.push_back(0);
+  }
+
+  ResultsStore::Status statusOf(const Alignment& result)
+  {
+    if (result.success)
+      return ResultsStore::Success;
+    else if (result.tooShort)
+      return ResultsStore::FailTooShort;
+    else if (result.failure)
+      return ResultsStore::Failure;
+    else
+      return ResultsStore::InternalError;
+  }
+}
+
+void ResultsStore::write(const std::vector<Alignment>& results,
+			 std::ostream& stream)
+{
+  Buffer sections[SECTION_COUNT];
+
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.byteOrder = BYTE_ORDER_MARK;
+  header.version = VERSION;
+  header.targetCount = results.size();
+
+  if (!results.empty()) {
+    const ReferenceSequence& ref = results[0].reference();
+    header.regionCount = ref.regions().size();
+
+    std::string refSeq;
+    for (unsigned i = 0; i < ref.size(); ++i)
+      if (ref[i] != seq::Nucleotide::GAP)
+	refSeq += ref[i].toChar();
+
+    Buffer& b = sections[REFERENCE];
+    appendString(b, ref.name());
+    appendString(b, ref.description());
+    appendString(b, refSeq);
+    for (unsigned r = 0; r < ref.regions().size(); ++r) {
+      append(b, ref.regions()[r].begin());
+      append(b, ref.regions()[r].end());
+      appendString(b, ref.regions()[r].prefix());
+    }
+  }
+
+  append(sections[NAME_INDEX], (unsigned long long)0);
+  append(sections[EDIT_INDEX], (unsigned long long)0);
+  append(sections[SEQ_INDEX], (unsigned long long)0);
+  unsigned long long nucleotides = 0;
+
+  for (unsigned i = 0; i < results.size(); ++i) {
+    const Alignment& result = results[i];
+
+    sections[STATUS].push_back((char)statusOf(result));
+    append(sections[SCORE], result.score);
+    append(sections[FRAMESHIFTS], result.correctedFrameshifts);
+
+    for (unsigned r = 0; r < header.regionCount; ++r) {
+      const Alignment::AlignedRegion& region = result.alignedRegion(r);
+      append(sections[RANGES], region.alignedBegin);
+      append(sections[RANGES], region.alignedEnd);
+      append(sections[RANGES], region.targetBegin);
+      append(sections[RANGES], region.targetEnd);
+    }
+
+    Buffer& names = sections[NAMES];
+    std::string name = result.target.name();
+    std::string description = result.target.description();
+    names.insert(names.end(), name.begin(), name.end());
+    names.push_back(0);
+    names.insert(names.end(), description.begin(), description.end());
+    names.push_back(0);
+    append(sections[NAME_INDEX], (unsigned long long)names.size());
+
+    Buffer& edits = sections[EDITS];
+    append(edits, (int)result.refGaps_.size());
+    for (unsigned k = 0; k < result.refGaps_.size(); ++k) {
+      append(edits, result.refGaps_[k].alignedIndex);
+      append(edits, result.refGaps_[k].length);
+    }
+    appendGapRuns(sections[EDITS], result.target);
+    append(sections[EDIT_INDEX],
+	   (unsigned long long)(sections[EDITS].size() / sizeof(int)));
+
+    Buffer& seqs = sections[SEQS];
+    for (unsigned j = 0; j < result.target.size(); ++j) {
+      int rep = result.target[j].intRep();
+      if (rep == seq::Nucleotide::NT_GAP)
+	continue;
+      if (nucleotides % 2 == 0)
+	seqs.push_back((char)rep);
+      else
+	seqs.back() |= (char)(rep << 4);
+      ++nucleotides;
+    }
+    append(sections[SEQ_INDEX], nucleotides);
+  }
+
+  unsigned long long offset = sizeof(Header);
+  for (int s = 0; s < SECTION_COUNT; ++s) {
+    header.offset[s] = offset;
+    header.size[s] = sections[s].size();
+    pad(sections[s]);
+    offset += sections[s].size();
+  }
+
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (int s = 0; s < SECTION_COUNT; ++s)
+    if (!sections[s].empty())
+      stream.write(&sections[s][0], sections[s].size());
+}
+
+ResultsStore::ResultsStore(const std::string& fileName)
+  : data_(0),
+    size_(0),
+    mapping_(0),
+    targetCount_(0),
+    regionCount_(0),
+    reference_(seq::NTSequence())
+{
+  open(fileName);
+
+  Header header;
+  if (size_ < sizeof(Header)) {
+    close();
+    throw std::runtime_error(fileName + " is not a virulign results store");
+  }
+  std::memcpy(&header, data_, sizeof(header));
+
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+      || header.byteOrder != BYTE_ORDER_MARK) {
+    close();
+    throw std::runtime_error(fileName + " is not a virulign results store");
+  }
+
+  if (header.version != VERSION) {
+    close();
+    throw std::runtime_error(fileName + ": unsupported results store version "
+			     + to_string(header.version));
+  }
+
+  for (int s = 0; s < SECTION_COUNT; ++s)
+    if (header.offset[s] + header.size[s] > size_) {
+      close();
+      throw std::runtime_error(fileName + ": truncated results store");
+    }
+
+  targetCount_ = header.targetCount;
+  regionCount_ = header.regionCount;
+
+  if (targetCount_ > 0) {
+    const char *p = section(REFERENCE);
+    std::string name = readString(p);
+    std::string description = readString(p);
+    std::string sequence = readString(p);
+    reference_ = ReferenceSequence(seq::NTSequence(name, description,
+						   sequence));
+    for (unsigned r = 0; r < regionCount_; ++r) {
+      int begin, end;
+      std::memcpy(&begin, p, sizeof(begin)); p += sizeof(begin);
+      std::memcpy(&end, p, sizeof(end)); p += sizeof(end);
+      std::string prefix = readString(p);
+      reference_.addRegion(ReferenceSequence::Region(begin, end, prefix));
+    }
+  }
+}
+
+ResultsStore::~ResultsStore()
+{
+  close();
+}
+
+void ResultsStore::open(const std::string& fileName)
+{
+#ifndef _WIN32
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error(std::string("Could not open ") + fileName);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error(std::string("Could not open ") + fileName);
+  }
+
+  size_ = st.st_size;
+  if (size_ > 0) {
+    mapping_ = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping_ == MAP_FAILED) {
+      mapping_ = 0;
+      ::close(fd);
+      throw std::runtime_error(std::string("Could not map ") + fileName);
+    }
+    data_ = static_cast<const char *>(mapping_);
+  }
+  ::close(fd);
+#else
+  std::ifstream f(fileName.c_str(), std::ios::binary);
+  if (!f)
+    throw std::runtime_error(std::string("Could not open ") + fileName);
+
+  buffer_.assign(std::istreambuf_iterator<char>(f),
+		 std::istreambuf_iterator<char>());
+  size_ = buffer_.size();
+  data_ = buffer_.empty() ? 0 : &buffer_[0];
+#endif
+}
+
+void ResultsStore::close()
+{
+#ifndef _WIN32
+  if (mapping_)
+    munmap(mapping_, size_);
+#endif
+  mapping_ = 0;
+  data_ = 0;
+  buffer_.clear();
+}
+
+const char *ResultsStore::section(int s) const
+{
+  const Header *header = reinterpret_cast<const Header *>(data_);
+  return data_ + header->offset[s];
+}
+
+ResultsStore::Status ResultsStore::status(unsigned i) const
+{
+  return (Status)section(STATUS)[i];
+}
+
+double ResultsStore::score(unsigned i) const
+{
+  return reinterpret_cast<const double *>(section(SCORE))[i];
+}
+
+int ResultsStore::frameshifts(unsigned i) const
+{
+  return reinterpret_cast<const int *>(section(FRAMESHIFTS))[i];
+}
+
+const int *ResultsStore::ranges(unsigned i, unsigned region) const
+{
+  return reinterpret_cast<const int *>(section(RANGES))
+    + (i * regionCount_ + region) * 4;
+}
+
+int ResultsStore::targetBegin(unsigned i, unsigned region) const
+{
+  return ranges(i, region)[2];
+}
+
+int ResultsStore::targetEnd(unsigned i, unsigned region) const
+{
+  return ranges(i, region)[3];
+}
+
+std::string ResultsStore::name(unsigned i) const
+{
+  const unsigned long long *index
+    = reinterpret_cast<const unsigned long long *>(section(NAME_INDEX));
+  return std::string(section(NAMES) + index[i]);
+}
+
+Alignment ResultsStore::alignment(unsigned i) const
+{
+  const unsigned long long *index
+    = reinterpret_cast<const unsigned long long *>(section(NAME_INDEX));
+  const char *name = section(NAMES) + index[i];
+  const char *description = name + std::strlen(name) + 1;
+
+  const unsigned long long *seqIndex
+    = reinterpret_cast<const unsigned long long *>(section(SEQ_INDEX));
+  const unsigned char *seqs
+    = reinterpret_cast<const unsigned char *>(section(SEQS));
+
+  seq::NTSequence target;
+  target.setName(name);
+  target.setDescription(description);
+  target.reserve(seqIndex[i + 1] - seqIndex[i]);
+  for (unsigned long long j = seqIndex[i]; j < seqIndex[i + 1]; ++j) {
+    int rep = (j % 2 == 0) ? (seqs[j / 2] & 0xF) : (seqs[j / 2] >> 4);
+    target.push_back(seq::Nucleotide::fromRep(rep));
+  }
+
+  const unsigned long long *editIndex
+    = reinterpret_cast<const unsigned long long *>(section(EDIT_INDEX));
+  const int *runs = reinterpret_cast<const int *>(section(EDITS))
+    + editIndex[i];
+
+  Alignment result(reference_, seq::NTSequence());
+
+  int n = *runs++;
+  for (int k = 0; k < n; ++k)
+    result.addRefGap(runs[2*k], runs[2*k + 1]);
+  runs += 2 * n;
+
+  insertGapRuns(runs, target);
+  result.target = target;
+
+  Status s = status(i);
+  result.success = (s == Success);
+  result.tooShort = (s == FailTooShort);
+  result.failure = (s == Failure);
+  result.score = score(i);
+  result.correctedFrameshifts = frameshifts(i);
+
+  result.computeAlignedRanges();
+
+  return result;
+}
+
+void ResultsStore::alignments(std::vector<Alignment>& results) const
+{
+  results.reserve(results.size() + targetCount_);
+  for (unsigned i = 0; i < targetCount_; ++i)
+    results.push_back(alignment(i));
+}
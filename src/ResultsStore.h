@@ -0,0 +1,88 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef RESULTS_STORE_H_
+#define RESULTS_STORE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ReferenceSequence.h"
+
+class Alignment;
+
+/**
+ * A compact binary store of alignment results.
+ *
+ * The file holds the (ungapped) reference with its regions once,
+ * followed by one column per per-target property: status, score,
+ * corrected frameshifts, region ranges, names, the alignment edit script
+ * (gap runs in the reference and in the target) and the 4-bit packed,
+ * ungapped target nucleotides.
+ *
+ * Every column starts at an 8-byte aligned offset, recorded in the file
+ * header, so that the file can be memory-mapped and individual columns
+ * can be read without decoding the others.
+ */
+class ResultsStore
+{
+public:
+  enum Status { Success = 0, FailTooShort = 1, Failure = 2, InternalError = 3 };
+
+  /**
+   * Serialize the results to the stream.
+   */
+  static void write(const std::vector<Alignment>& results,
+		    std::ostream& stream);
+
+  /**
+   * Open (memory-map) a stored results file.
+   *
+   * @throws std::runtime_error if the file cannot be read or is not a
+   *         valid results store.
+   */
+  ResultsStore(const std::string& fileName);
+  ~ResultsStore();
+
+  const ReferenceSequence& reference() const { return reference_; }
+
+  unsigned size() const { return targetCount_; }
+
+  Status status(unsigned i) const;
+  double score(unsigned i) const;
+  int    frameshifts(unsigned i) const;
+  int    targetBegin(unsigned i, unsigned region) const;
+  int    targetEnd(unsigned i, unsigned region) const;
+  std::string name(unsigned i) const;
+
+  /**
+   * Reconstruct the alignment of target i, without realigning.
+   *
+   * The alignment shares the reference of the store, which must therefore
+   * outlive it.
+   */
+  Alignment alignment(unsigned i) const;
+
+  /**
+   * Reconstruct all alignments, in the order they were stored.
+   */
+  void alignments(std::vector<Alignment>& results) const;
+
+private:
+  const char       *data_;
+  unsigned long     size_;
+  void             *mapping_;
+  std::vector<char> buffer_;
+
+  unsigned          targetCount_, regionCount_;
+  ReferenceSequence reference_;
+
+  const char *section(int s) const;
+  const int  *ranges(unsigned i, unsigned region) const;
+  void open(const std::string& fileName);
+  void close();
+
+  ResultsStore(const ResultsStore&);
+  ResultsStore& operator=(const ResultsStore&);
+};
+
+#endif // RESULTS_STORE_H_
@@ -3,6 +3,8 @@
 #include <string>
 #include <algorithm>
 #include <sstream>
+#include <iostream>
+#include <mutex>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -17,6 +19,22 @@ std::string to_upper_copy(const std::string& s)
   return copy;
 }
 
+std::vector<std::string> split(const std::string& s, char separator)
+{
+  std::vector<std::string> result;
+
+  std::string::size_type start = 0;
+  for (;;) {
+    std::string::size_type end = s.find(separator, start);
+    result.push_back(s.substr(start, end - start));
+    if (end == std::string::npos)
+      break;
+    start = end + 1;
+  }
+
+  return result;
+}
+
 bool ends_with(const std::string& s, const std::string& p)
 {
   if (p.size() > s.size())
@@ -65,3 +83,11 @@ std::string format_time(const long long& milliseconds)
 
   return ss.str();
 }
+
+void log_line(const std::string& line)
+{
+  static std::mutex mutex;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::cerr << line << std::endl;
+}
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <algorithm>
 #include <typeinfo>
+#include <vector>
 
 template <typename T>
 T lexical_cast(const std::string& s)
@@ -33,8 +34,16 @@ std::string to_upper_copy(const std::string& s);
 
 bool ends_with(const std::string& s, const std::string& p);
 
+std::vector<std::string> split(const std::string& s, char separator);
+
 long long current_time_ms();
 
 std::string format_time(const long long& milliseconds);
 
+/*
+ * Writes a line to std::cerr in one piece, also when lines are logged
+ * concurrently (e.g. by the connections of an AlignmentServer).
+ */
+void log_line(const std::string& line);
+
 #endif // UTILS_H_ 
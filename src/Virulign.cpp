@@ -4,12 +4,28 @@
 #include <vector>
 #include <stdexcept>
 #include <iomanip>
+#include <thread>
+#include <unordered_map>
 
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <CodonReference.h>
 #include <NeedlemanWunsh.h>
+#include <WavefrontAligner.h>
 
 #include "ReferenceSequence.h"
+#include "ReferencePanel.h"
 #include "Alignment.h"
 #include "ResultsExporter.h"
+#include "ResultsStore.h"
+#include "AlignmentDeltas.h"
+#include "AlignmentCache.h"
+#include "AlignmentServer.h"
+#include "MutationCounts.h"
+#include "ConsensusCounts.h"
 #include "CLIUtils.h"
 #include "Utils.h"
 
@@ -22,24 +38,401 @@ ReferenceSequence loadRefSeq(const std::string& fn) {
   throw std::runtime_error("Unsupported reference sequence format");
 }
 
+/*
+ * Finds targets that are identical when ignoring gaps (nucleotides are
+ * already case-insensitive), so that these are aligned only once: returns
+ * for every target the index of the first target that is identical to it.
+ */
+std::vector<unsigned> identicalTargets(const std::vector<seq::NTSequence>& targets)
+{
+  std::vector<unsigned> result(targets.size());
+  std::unordered_map<std::string, unsigned> first;
+
+  for (unsigned i = 0; i < targets.size(); ++i) {
+    const seq::NTSequence& target = targets[i];
+
+    std::string key;
+    key.reserve(target.size());
+    for (unsigned j = 0; j < target.size(); ++j)
+      if (target[j] != seq::Nucleotide::GAP)
+	key += target[j].toChar();
+
+    result[i] = first.insert(std::make_pair(key, i)).first->second;
+  }
+
+  return result;
+}
+
+/*
+ * The result of a target that is identical to a target that was aligned
+ * already.
+ */
+Alignment identicalResult(const Alignment& aligned,
+			  const seq::NTSequence& target)
+{
+  Alignment result = aligned;
+  result.target.setName(target.name());
+  result.target.setDescription(target.description());
+  return result;
+}
+
+const unsigned ALIGN_BATCH = 8 * seq::NeedlemanWunsh::BATCH_LANES;
+
+/*
+ * Aligns together the next (up to ALIGN_BATCH) targets, from target first
+ * on, that need to be aligned: that are not identical to an earlier target
+ * and are not in the cache. The targets that are found in the cache on the
+ * way are returned as well (in cachedIndices and cached), so that every
+ * target is looked up only once.
+ *
+ * Returns the index of the first target that was not considered.
+ */
+unsigned alignBatch(const ReferenceSequence& ref,
+		    const std::vector<seq::NTSequence>& targets,
+		    const std::vector<unsigned>& identical,
+		    const AlignmentCache *cache,
+		    unsigned first,
+		    seq::AlignmentAlgorithm *algorithm,
+		    const seq::CodonReference *codonRef,
+		    int maxFrameShifts,
+		    std::vector<unsigned>& indices,
+		    std::vector<Alignment>& aligned,
+		    std::vector<unsigned>& cachedIndices,
+		    std::vector<Alignment>& cached)
+{
+  indices.clear();
+  aligned.clear();
+  cachedIndices.clear();
+  cached.clear();
+
+  std::vector<seq::NTSequence> batch;
+
+  unsigned i = first;
+  for (; i < targets.size() && batch.size() < ALIGN_BATCH; ++i) {
+    if (identical[i] != i)
+      continue;
+
+    if (cache && cache->find(targets[i], cached))
+      cachedIndices.push_back(i);
+    else {
+      indices.push_back(i);
+      batch.push_back(targets[i]);
+    }
+  }
+
+  Alignment::compute(ref, batch, algorithm, maxFrameShifts, aligned,
+		     codonRef);
+
+  return i;
+}
+
+void prepareOutput(ExportKind exportKind, ExportFormat exportFormat)
+{
+  if (exportFormat == Arrow
+      && exportKind != PositionTable && exportKind != MutationTable) {
+    std::cerr << "--exportFormat Arrow is only supported for PositionTable and MutationTable" << std::endl;
+    exit(0);
+  }
+
+#ifdef _WIN32
+  if (exportKind == Binary || exportFormat == Arrow)
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+}
+
+/*
+ * virulign export alignment.bin [export parameters]
+ *
+ * Exports results that were stored with --exportKind Binary.
+ */
+int exportStoredResults(int argc, char **argv) {
+  if (argc < 3 || (argc - 3) % 2 == 1) {
+    std::cerr << "Usage: virulign export alignment.bin" << std::endl
+	      << "Optional parameters: --exportKind, --exportAlphabet, --exportWithInsertions, --exportFormat and --nthreads, see virulign" << std::endl;
+    exit(0);
+  }
+
+  ExportKind exportKind = Mutations;
+  ExportAlphabet exportAlphabet = AminoAcids;
+  bool exportWithInsertions = true;
+  ExportFormat exportFormat = Csv;
+  unsigned threads = defaultThreads();
+
+  for (int i = 3; i < argc; i += 2) {
+    try {
+      if (!parseExportParameter(argv[i], argv[i+1], exportKind, exportAlphabet,
+				exportWithInsertions, exportFormat)
+	  && !parseThreadsParameter(argv[i], argv[i+1], threads)) {
+	std::cerr << "Unkown parameter name: " << argv[i] << std::endl; 
+	exit(0);
+      }
+    } catch (std::invalid_argument& e) {
+      std::cerr << e.what() << std::endl;
+      exit(0);
+    }
+  }
+
+  std::vector<Alignment> results;
+  ResultsStore *store = 0;
+  try {
+    store = new ResultsStore(argv[2]);
+    store->alignments(results);
+  } catch (std::runtime_error& e) {
+    std::cerr << "Fatal error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  prepareOutput(exportKind, exportFormat);
+  ResultsExporter exporter(results, exportKind, exportAlphabet, exportWithInsertions, exportFormat);
+  exporter.setThreads(threads);
+
+  exporter.streamData(std::cout);
+
+  results.clear();
+  delete store;
+
+  return 0;
+}
+
+/*
+ * virulign reconstruct reference.xml alignment.deltas [export parameters]
+ *
+ * Exports results that were stored with --exportKind Deltas, by
+ * reconstructing the alignments against the reference.
+ */
+int reconstructDeltas(int argc, char **argv) {
+  if (argc < 4 || (argc - 4) % 2 == 1) {
+    std::cerr << "Usage: virulign reconstruct [reference.fasta orf-description.xml] alignment.deltas" << std::endl
+	      << "Optional parameters: --exportKind (PairwiseAlignments), --exportAlphabet (Nucleotides), --exportWithInsertions, --exportFormat and --nthreads, see virulign" << std::endl;
+    exit(0);
+  }
+
+  ExportKind exportKind = PairwiseAlignments;
+  ExportAlphabet exportAlphabet = Nucleotides;
+  bool exportWithInsertions = true;
+  ExportFormat exportFormat = Csv;
+  unsigned threads = defaultThreads();
+
+  for (int i = 4; i < argc; i += 2) {
+    try {
+      if (!parseExportParameter(argv[i], argv[i+1], exportKind, exportAlphabet,
+				exportWithInsertions, exportFormat)
+	  && !parseThreadsParameter(argv[i], argv[i+1], threads)) {
+	std::cerr << "Unkown parameter name: " << argv[i] << std::endl; 
+	exit(0);
+      }
+    } catch (std::invalid_argument& e) {
+      std::cerr << e.what() << std::endl;
+      exit(0);
+    }
+  }
+
+  std::vector<Alignment> results;
+  try {
+    ReferenceSequence refSeq = loadRefSeq(argv[2]);
+
+    std::ifstream f(argv[3]);
+    if (!f)
+      throw std::runtime_error(std::string("Could not open ") + argv[3]);
+    AlignmentDeltas::read(refSeq, f, results);
+
+    prepareOutput(exportKind, exportFormat);
+    ResultsExporter exporter(results, exportKind, exportAlphabet, exportWithInsertions, exportFormat);
+    exporter.setThreads(threads);
+
+    exporter.streamData(std::cout);
+  } catch (std::runtime_error& e) {
+    std::cerr << "Fatal error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  return 0;
+}
+
+/*
+ * Aligns all ORFs of a genome in one pass: each ORF is located within the
+ * target genomes and aligned against that window only. The results of
+ * each ORF are exported to a file in outputDir, named after the ORF file.
+ */
+void alignOrfs(const ReferencePanel& orfs,
+	       const std::vector<std::string>& orfFileNames,
+	       const std::vector<seq::NTSequence>& targets,
+	       seq::AlignmentAlgorithm *algorithm, int maxFrameShifts,
+	       const std::string& outputDir,
+	       ExportKind exportKind, ExportAlphabet exportAlphabet,
+	       bool exportWithInsertions, ExportFormat exportFormat,
+	       unsigned threads)
+{
+  prepareOutput(exportKind, exportFormat);
+
+  std::vector<std::vector<Alignment> > results(orfs.references().size());
+  std::vector<Alignment> targetResults;
+  std::vector<unsigned> identical = identicalTargets(targets);
+
+  for (unsigned i = 0; i < targets.size(); ++i) {
+    if (identical[i] != i) {
+      std::cerr << "Target " << i << " (" << targets[i].name()
+		<< ") is identical to target " << identical[i] << std::endl;
+      for (unsigned r = 0; r < results.size(); ++r)
+	results[r].push_back(identicalResult(results[r][identical[i]],
+					     targets[i]));
+      continue;
+    }
+
+    std::cerr << "Align target " << i 
+	      << " (" << targets[i].name() << ")" << std::endl;
+    orfs.alignAll(targets[i], algorithm, maxFrameShifts, targetResults);
+    for (unsigned r = 0; r < targetResults.size(); ++r)
+      results[r].push_back(targetResults[r]);
+  }
+
+  std::string extension;
+  if (exportKind == Binary)
+    extension = ".bin";
+  else if (exportFormat == Arrow)
+    extension = ".arrow";
+  else if (exportKind == PairwiseAlignments || exportKind == GlobalAlignment)
+    extension = ".fasta";
+  else
+    extension = ".csv";
+
+  for (unsigned r = 0; r < results.size(); ++r) {
+    std::string name = orfFileNames[r];
+    std::string::size_type slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+      name = name.substr(slash + 1);
+    name = name.substr(0, name.rfind('.'));
+
+    std::string fileName = outputDir + "/" + name + extension;
+    std::ofstream f(fileName.c_str(), std::ios::out | std::ios::binary);
+    if (!f) {
+      std::cerr << "Fatal error: could not write " << fileName << std::endl;
+      exit(1);
+    }
+
+    ResultsExporter exporter(results[r], exportKind, exportAlphabet,
+			     exportWithInsertions, exportFormat);
+    exporter.setThreads(threads);
+    exporter.streamData(f);
+  }
+}
+
+/*
+ * virulign serve --ref reference.xml --socket path [alignment parameters]
+ *
+ * Keeps the reference loaded, and serves alignment requests on a local
+ * socket, see AlignmentServer.
+ */
+int serveAlignments(int argc, char **argv) {
+  if ((argc - 2) % 2 == 1) {
+    std::cerr << "Please provide parameters as: --parameterName parameterValue" << std::endl;	
+    exit(0);
+  }
+
+  std::string refSeqFileName, socketPath;
+
+  double gapExtensionPenalty = 3.3;
+  double gapOpenPenalty = 10.0;
+  int maxFrameShifts = 3;
+  double xDrop = 0;
+  std::string ntMatrixFile, aaMatrixFile;
+  unsigned threads = defaultThreads();
+
+  for (int i = 2; i < argc; i += 2) {
+    try {
+      if (parseAlignmentParameter(argv[i], argv[i+1], gapOpenPenalty,
+				  gapExtensionPenalty, maxFrameShifts, xDrop,
+				  ntMatrixFile, aaMatrixFile)
+	  || parseThreadsParameter(argv[i], argv[i+1], threads))
+	continue;
+    } catch (std::invalid_argument& e) {
+      std::cerr << e.what() << std::endl;
+      exit(0);
+    }
+
+    if (equalsString(argv[i], "--ref")) {
+      refSeqFileName = argv[i+1];
+    } else if (equalsString(argv[i], "--socket")) {
+      socketPath = argv[i+1];
+    } else {
+      std::cerr << "Unkown parameter name: " << argv[i] << std::endl; 
+      exit(0);
+    }
+  }
+
+  if (refSeqFileName.empty() || socketPath.empty()) {
+    std::cerr << "Usage: virulign serve --ref [reference.fasta orf-description.xml] --socket path" << std::endl
+	      << "Optional parameters: --gapExtensionPenalty, --gapOpenPenalty, --maxFrameShifts, --xDrop, --ntMatrix, --aaMatrix and --nthreads (the number of requests served concurrently), see virulign" << std::endl
+	      << "A request is a FASTA file, optionally preceded by a line with export parameters, e.g.:" << std::endl
+	      << "   # --exportKind PositionTable" << std::endl
+	      << "   virulign serve --ref ref.xml --socket /tmp/virulign.sock &" << std::endl
+	      << "   (echo '# --exportKind Mutations'; cat sequences.fasta) | nc -N -U /tmp/virulign.sock" << std::endl;
+    exit(0);
+  }
+
+  try {
+    ReferenceSequence refSeq = loadRefSeq(refSeqFileName);
+
+    AlignmentServer server(refSeq, gapOpenPenalty, gapExtensionPenalty,
+			   maxFrameShifts, xDrop,
+			   loadScoringMatrix(seq::ScoringMatrix::Nucleotides,
+					     ntMatrixFile),
+			   loadScoringMatrix(seq::ScoringMatrix::AminoAcids,
+					     aaMatrixFile));
+    server.serve(socketPath, threads);
+  } catch (std::runtime_error& e) {
+    std::cerr << "Fatal error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
   unsigned int i;
+
+  if (argc > 1 && equalsString(argv[1], "export"))
+    return exportStoredResults(argc, argv);
+  if (argc > 1 && equalsString(argv[1], "reconstruct"))
+    return reconstructDeltas(argc, argv);
+  if (argc > 1 && equalsString(argv[1], "serve"))
+    return serveAlignments(argc, argv);
 	
   int obligatoryParams = 2;
   if(argc < obligatoryParams+1) {
     std::cerr << "Usage: virulign [reference.fasta orf-description.xml] sequences.fasta" << std::endl 
+	      << "   or: virulign reference1.xml,reference2.xml,... sequences.fasta" << std::endl
+	      << "       to align each sequence against the best matching reference of a panel" << std::endl
+	      << "   or: virulign orf1.xml,orf2.xml,... genomes.fasta --orfOutputDirectory directory" << std::endl
+	      << "       to align each genome against all ORFs of a genome in one pass" << std::endl
 	      << "Optional parameters (first option will be the default):" << std::endl
-	      << "  --exportKind [Mutations PairwiseAlignments GlobalAlignment PositionTable MutationTable]" << std::endl  
+	      << "  --exportKind [Mutations PairwiseAlignments GlobalAlignment PositionTable MutationTable Binary MutationFrequencies Deltas Consensus]" << std::endl  
 	      << "  --exportAlphabet [AminoAcids Nucleotides]" << std::endl
 	      << "  --exportWithInsertions [yes no]" << std::endl
 	      << "  --exportReferenceSequence [no yes]" << std::endl
+	      << "  --exportFormat [Csv Arrow] (Arrow: Apache Arrow IPC file, for PositionTable and MutationTable)" << std::endl
 	      << "  --gapExtensionPenalty doubleValue=>3.3" << std::endl
 	      << "  --gapOpenPenalty doubleValue=>10.0" << std::endl
 	      << "  --maxFrameShifts intValue=>3" << std::endl
+	      << "  --xDrop doubleValue=>0 (abandon a nucleotide alignment when its score drops this far below the best score so far; 0: never)" << std::endl
+	      << "  --ntMatrix file=>IUB (nucleotide scoring matrix in the NCBI format, e.g. NUC.4.4)" << std::endl
+	      << "  --aaMatrix file=>BLOSUM30 (amino acid scoring matrix in the NCBI format, e.g. BLOSUM62)" << std::endl
+	      << "  --aligner [NeedlemanWunsh Wavefront] (Wavefront: faster for nearly identical targets, with the alignments of NeedlemanWunsh, which it falls back to whenever they could differ)" << std::endl
+	      << "  --nthreads intValue=>number of cores (threads that align a target, and format or count the results)" << std::endl
+	      << "  --candidateReferences intValue=>1 (with a reference panel: the number of best k-mer matching references to align against)" << std::endl
               << "  --progress [no yes]" << std::endl
               << "  --nt-debug directory" << std::endl
+	      << "  --orfOutputDirectory directory (export the alignments of each ORF to directory/<ORF file name>.csv)" << std::endl
+	      << "  --cache directory (reuse the alignments of targets that were aligned before with the same reference and parameters)" << std::endl
+	      << "Targets that are too different from the reference to align are rejected early, by their edit distance: with the default scores, this applies to targets of up to 117 nucleotides" << std::endl
 	      << "Output: The alignment will be printed to standard out and any progress or error messages will be printed to the standard error. This output can be redirected to files, e.g.:" << std::endl
-              << "   virulign ref.xml sequence.fasta > alignment.mutations 2> alignment.err" << std::endl;
+              << "   virulign ref.xml sequence.fasta > alignment.mutations 2> alignment.err" << std::endl
+	      << "Alignments stored with --exportKind Binary can be exported again without realigning:" << std::endl
+	      << "   virulign export alignment.bin --exportKind PositionTable > alignment.csv" << std::endl
+	      << "Alignments stored with --exportKind Deltas (differences with the reference) can be reconstructed:" << std::endl
+	      << "   virulign reconstruct ref.xml alignment.deltas --exportKind GlobalAlignment > alignment.fasta" << std::endl
+	      << "To keep a reference loaded and serve alignment requests on a local socket:" << std::endl
+	      << "   virulign serve --ref ref.xml --socket /tmp/virulign.sock" << std::endl;
     exit(0);
   }
 	
@@ -49,14 +442,20 @@ int main(int argc, char **argv) {
     exit(0);
   } 
 
-  std::string refSeqFileName = argv[1];
-  if (!ends_with(refSeqFileName, ".fasta") && !ends_with(refSeqFileName, ".xml")) {
-    std::cerr << 
-      "Unknown reference sequence: "
-      "expected a FASTA file or an XML file that describes the ORF" << std::endl;
-    exit(1);
+  std::vector<std::string> refSeqFileNames = split(argv[1], ',');
+  std::vector<ReferenceSequence> refSeqs;
+  for (i = 0; i < refSeqFileNames.size(); ++i) {
+    const std::string& refSeqFileName = refSeqFileNames[i];
+    if (!ends_with(refSeqFileName, ".fasta") && !ends_with(refSeqFileName, ".xml")) {
+      std::cerr << 
+	"Unknown reference sequence: "
+	"expected a FASTA file or an XML file that describes the ORF" << std::endl;
+      exit(1);
+    }
+    refSeqs.push_back(loadRefSeq(refSeqFileName));
   }
-  ReferenceSequence refSeq = loadRefSeq(refSeqFileName);
+  const ReferenceSequence& refSeq = refSeqs[0];
+  bool referencePanel = refSeqs.size() > 1;
 
   std::ifstream f_seqs(argv[2]);
   std::vector<seq::NTSequence> targets; 
@@ -79,99 +478,148 @@ int main(int argc, char **argv) {
   ExportKind exportKind = Mutations;
   ExportAlphabet exportAlphabet = AminoAcids;
   bool exportWithInsertions = true;
+  ExportFormat exportFormat = Csv;
 
   double gapExtensionPenalty = 3.3;
   double gapOpenPenalty = 10.0;
   int maxFrameShifts = 3;
+  double xDrop = 0;
+  std::string ntMatrixFile, aaMatrixFile;
+  int candidateReferences = 1;
+  unsigned threads = defaultThreads();
 
   bool progress = false;
+  bool wavefront = false;
 
   std::string ntDebugDir;
+  std::string orfOutputDir;
+  std::string cacheDir;
 	
   char* parameterName;
   char* parameterValue;
   for(i = obligatoryParams+1; i < amountOfParameters+obligatoryParams; i=i+2) {
     parameterName = argv[i];
     parameterValue = argv[i+1];
-    if(equalsString(parameterName,"--exportKind")) {
-      if(equalsString(parameterValue, "Mutations")) {
-	exportKind = Mutations;
-      } else if(equalsString(parameterValue, "PairwiseAlignments")) {
-	exportKind = PairwiseAlignments;
-      } else if(equalsString(parameterValue, "GlobalAlignment")) {
-	exportKind = GlobalAlignment;
-      } else if(equalsString(parameterValue, "PositionTable")) {
-	exportKind = PositionTable;
-      } else if(equalsString(parameterValue, "MutationTable")) {
-	exportKind = MutationTable;
-      } else {
-	std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl; 
-	exit(0);
-      }	
-    } else if(equalsString(parameterName,"--exportAlphabet")) {
-      if(equalsString(parameterValue, "AminoAcids")) {
-	exportAlphabet = AminoAcids;
-      } else if(equalsString(parameterValue, "Nucleotides")) {
-	exportAlphabet = Nucleotides;
-      } else {
-	std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl; 
-	exit(0);
-      }
-    } else if(equalsString(parameterName,"--exportReferenceSequence")) {
+    try {
+      if(parseExportParameter(parameterName, parameterValue,
+			      exportKind, exportAlphabet, exportWithInsertions,
+			      exportFormat)
+	 || parseAlignmentParameter(parameterName, parameterValue,
+				    gapOpenPenalty, gapExtensionPenalty,
+				    maxFrameShifts, xDrop,
+				    ntMatrixFile, aaMatrixFile)
+	 || parseThreadsParameter(parameterName, parameterValue, threads))
+	continue;
+    } catch (std::invalid_argument& e) {
+      std::cerr << e.what() << std::endl;
+      exit(0);
+    }
+
+    if(equalsString(parameterName,"--exportReferenceSequence")) {
       if (equalsString(parameterValue,"yes")) {
+	if (referencePanel) {
+	  std::cerr << "--exportReferenceSequence is not supported with a reference panel" << std::endl;
+	  exit(0);
+	}
 	seq::NTSequence refNtSeq = refSeq;
 	targets.insert(targets.begin(), refNtSeq);
       }
-    } else if(equalsString(parameterName,"--exportWithInsertions")) {
+    } else if(equalsString(parameterName,"--progress")) {
       if(equalsString(parameterValue,"yes")) {
-	exportWithInsertions = true;
+	progress = true;
       } else if(equalsString(parameterValue,"no")) {
-	exportWithInsertions = false;
+	progress = false;
       } else {
 	std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl; 
 	exit(0);
       } 
-    } else if(equalsString(parameterName,"--gapExtensionPenalty")) {
-      try {
-	gapExtensionPenalty = lexical_cast<double>(parameterValue);
-      } catch (std::bad_cast& e) {
-	std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl; 
+    } else if(equalsString(parameterName,"--aligner")) {
+      if(equalsString(parameterValue,"NeedlemanWunsh")) {
+	wavefront = false;
+      } else if(equalsString(parameterValue,"Wavefront")) {
+	wavefront = true;
+      } else {
+	std::cerr << unknownValue(parameterName, parameterValue) << std::endl;
 	exit(0);
       }
-    } else if(equalsString(parameterName,"--gapOpenPenalty")) {
-      try {
-	gapOpenPenalty = lexical_cast<double>(parameterValue);
-      } catch (std::bad_cast& e) {
-        std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl;
-        exit(0);
-      }
-    } else if(equalsString(parameterName,"--maxFrameShifts")) {
+    } else if(equalsString(parameterName,"--candidateReferences")) {
       try {
-        maxFrameShifts = lexical_cast<int>(parameterValue);
-      } catch (std::bad_cast& e) {
-        std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl;
-        exit(0);
+	candidateReferences = lexical_cast<int>(parameterValue);
+      } catch (const std::bad_cast&) {
+	candidateReferences = 0;
       }
-    } else if(equalsString(parameterName,"--progress")) {
-      if(equalsString(parameterValue,"yes")) {
-	progress = true;
-      } else if(equalsString(parameterValue,"no")) {
-	progress = false;
-      } else {
-	std::cerr << "Unkown value " << parameterValue << " for parameter : " << parameterName << std::endl; 
+      if (candidateReferences < 1) {
+	std::cerr << unknownValue(parameterName, parameterValue) << std::endl;
 	exit(0);
-      } 
+      }
     } else if(equalsString(parameterName,"--nt-debug")) {
       ntDebugDir = parameterValue;  
+    } else if(equalsString(parameterName,"--orfOutputDirectory")) {
+      orfOutputDir = parameterValue;
+    } else if(equalsString(parameterName,"--cache")) {
+      cacheDir = parameterValue;
     } else {
       std::cerr << "Unkown parameter name: " << parameterName << std::endl; 
       exit(0);
     }
   }
 	
+  if (!cacheDir.empty() && (referencePanel || !orfOutputDir.empty())) {
+    std::cerr << "--cache is only supported with a single reference" << std::endl;
+    exit(0);
+  }
+
+  if (referencePanel && orfOutputDir.empty()) {
+    if (exportKind != Mutations && exportKind != PairwiseAlignments) {
+      std::cerr << "Only the Mutations and PairwiseAlignments exports are supported with a reference panel" << std::endl;
+      exit(0);
+    }
+
+    for (i = 1; i < refSeqs.size(); ++i) {
+      const std::vector<ReferenceSequence::Region>& regions = refSeqs[i].regions();
+      bool same = regions.size() == refSeq.regions().size();
+      for (unsigned j = 0; same && j < regions.size(); ++j)
+	same = regions[j].prefix() == refSeq.regions()[j].prefix();
+
+      if (!same && exportKind == Mutations) {
+	std::cerr << "The references of a panel should have the same regions: "
+		  << refSeqs[i].name() << " differs from " << refSeq.name() << std::endl;
+	exit(0);
+      }
+    }
+  }
+
   std::vector<Alignment> results;
- 
-  seq::NeedlemanWunsh algorithm(-gapOpenPenalty, -gapExtensionPenalty);
+
+  seq::ScoringMatrix ntMatrix(seq::ScoringMatrix::Nucleotides,
+			      seq::AlignmentAlgorithm::IUB());
+  seq::ScoringMatrix aaMatrix(seq::ScoringMatrix::AminoAcids,
+			      seq::AlignmentAlgorithm::BLOSUM30());
+  try {
+    ntMatrix = loadScoringMatrix(seq::ScoringMatrix::Nucleotides,
+				 ntMatrixFile);
+    aaMatrix = loadScoringMatrix(seq::ScoringMatrix::AminoAcids,
+				 aaMatrixFile);
+  } catch (std::runtime_error& e) {
+    std::cerr << "Fatal error: " << e.what() << std::endl;
+    exit(1);
+  }
+
+  seq::NeedlemanWunsh needlemanWunsh(-gapOpenPenalty, -gapExtensionPenalty,
+				     ntMatrix.weights(), aaMatrix.weights());
+  needlemanWunsh.setThreads(threads);
+  needlemanWunsh.setXDrop(xDrop);
+
+  seq::WavefrontAligner wavefrontAligner(-gapOpenPenalty,
+					 -gapExtensionPenalty,
+					 ntMatrix.weights(),
+					 aaMatrix.weights());
+  wavefrontAligner.setThreads(threads);
+  wavefrontAligner.setXDrop(xDrop);
+
+  seq::AlignmentAlgorithm& algorithm = wavefront
+    ? static_cast<seq::AlignmentAlgorithm&>(wavefrontAligner)
+    : needlemanWunsh;
 
   if (!ntDebugDir.empty()) {
 	seq::NTSequence r = refSeq;
@@ -187,12 +635,102 @@ int main(int argc, char **argv) {
     }
   }
 
+  ReferencePanel panel(referencePanel || !orfOutputDir.empty()
+		       ? refSeqs : std::vector<ReferenceSequence>());
+
+  if (!orfOutputDir.empty()) {
+    alignOrfs(panel, refSeqFileNames, targets, &algorithm, maxFrameShifts,
+	      orfOutputDir, exportKind, exportAlphabet, exportWithInsertions,
+	      exportFormat, threads);
+    return 0;
+  }
+
+  AlignmentCache *cache = 0;
+  if (!cacheDir.empty()) {
+    try {
+      cache = new AlignmentCache(cacheDir, refSeq, gapOpenPenalty,
+				 gapExtensionPenalty, maxFrameShifts,
+				 wavefront ? "Wavefront" : "NeedlemanWunsh",
+				 xDrop, ntMatrix, aaMatrix);
+    } catch (std::runtime_error& e) {
+      std::cerr << "Fatal error: " << e.what() << std::endl;
+      exit(1);
+    }
+  }
+
   long int start = current_time_ms();
+
+  std::vector<unsigned> identical = identicalTargets(targets);
+
+  /*
+   * The MutationFrequencies and Consensus exports need only the counts:
+   * count every result right away, and keep only the results that later
+   * (identical) targets will copy.
+   */
+  bool counting = exportKind == MutationFrequencies || exportKind == Consensus;
+  MutationCounts mutationCounts(refSeq, exportAlphabet);
+  ConsensusCounts consensusCounts(refSeq);
+  std::vector<bool> copied(targets.size(), false);
+  for (i = 0; i < targets.size(); ++i)
+    if (identical[i] != i)
+      copied[identical[i]] = true;
+  std::unordered_map<unsigned, Alignment> kept;
+
+  seq::CodonReference codonRef(refSeq);
+  std::vector<unsigned> batchIndices, cachedIndices;
+  std::vector<Alignment> batch, cached;
+  unsigned batchNext = 0, cachedNext = 0, scanned = 0;
   
   for (i = 0; i < targets.size(); ++i) {
-    std::cerr << "Align target " << i 
-            << " (" << targets[i].name() << ")" << std::endl;
-    results.push_back(Alignment::compute(refSeq, targets[i], &algorithm, maxFrameShifts));
+    if (identical[i] != i) {
+      std::cerr << "Target " << i << " (" << targets[i].name()
+		<< ") is identical to target " << identical[i] << std::endl;
+      const Alignment& aligned = counting
+	? kept.find(identical[i])->second : results[identical[i]];
+      results.push_back(identicalResult(aligned, targets[i]));
+    } else if (referencePanel) {
+      std::cerr << "Align target " << i
+		<< " (" << targets[i].name() << ")" << std::endl;
+      results.push_back(panel.align(targets[i], &algorithm, maxFrameShifts,
+				    candidateReferences));
+    } else {
+      /*
+       * Every target up to scanned is either in the batch or was found in
+       * the cache, in order.
+       */
+      if (i >= scanned) {
+	scanned = alignBatch(refSeq, targets, identical, cache, i, &algorithm,
+			     &codonRef, maxFrameShifts, batchIndices, batch,
+			     cachedIndices, cached);
+	batchNext = cachedNext = 0;
+      }
+
+      if (cachedNext < cachedIndices.size()
+	  && cachedIndices[cachedNext] == i) {
+	std::cerr << "Target " << i << " (" << targets[i].name()
+		  << ") was found in the cache" << std::endl;
+	results.push_back(cached[cachedNext++]);
+      } else {
+	std::cerr << "Align target " << i
+		  << " (" << targets[i].name() << ")" << std::endl;
+	results.push_back(batch[batchNext++]);
+
+	if (cache)
+	  cache->store(targets[i], results.back());
+      }
+    }
+
+    if (counting) {
+      if (exportKind == MutationFrequencies)
+	mutationCounts.add(results.back());
+      else
+	consensusCounts.add(results.back());
+
+      if (copied[i])
+	kept.insert(std::make_pair(i, results.back()));
+      results.pop_back();
+    }
+
     if (progress) {
       long int end = current_time_ms();
       long int elapsed = end - start;
@@ -203,7 +741,21 @@ int main(int argc, char **argv) {
     }
   }
 
-  ResultsExporter exporter(results, exportKind, exportAlphabet, exportWithInsertions);
+  prepareOutput(exportKind, exportFormat);
+  if (counting) {
+    if (!targets.empty()) {
+      if (exportKind == MutationFrequencies)
+	mutationCounts.streamCsv(std::cout);
+      else
+	consensusCounts.streamCsv(std::cout, exportWithInsertions);
+    }
+  } else {
+    ResultsExporter exporter(results, exportKind, exportAlphabet, exportWithInsertions, exportFormat,
+			     referencePanel);
+    exporter.setThreads(threads);
 
-  exporter.streamData(std::cout);
+    exporter.streamData(std::cout);
+  }
+
+  delete cache;
 }
@@ -1,7 +1,39 @@
 #include "AlignmentAlgorithm.h"
 
+#include <limits>
+
 namespace seq {
 
+double AlignmentAlgorithm::maxAlignScore(int, int)
+{
+  return std::numeric_limits<double>::infinity();
+}
+
+void AlignmentAlgorithm::alignBatch(const NTSequence& seq1,
+				    std::vector<NTSequence>& seq2s,
+				    std::vector<NTSequence>& alignedSeq1s,
+				    std::vector<double>& scores)
+{
+  alignedSeq1s.assign(seq2s.size(), seq1);
+  scores.resize(seq2s.size());
+
+  for (unsigned i = 0; i < seq2s.size(); ++i)
+    scores[i] = align(alignedSeq1s[i], seq2s[i]);
+}
+
+void AlignmentAlgorithm::alignScores(const AASequence& seq1,
+				     const std::vector<AASequence>& seq2s,
+				     std::vector<double>& scores)
+{
+  scores.resize(seq2s.size());
+
+  for (unsigned i = 0; i < seq2s.size(); ++i) {
+    AASequence alignedSeq1 = seq1;
+    AASequence alignedSeq2 = seq2s[i];
+    scores[i] = align(alignedSeq1, alignedSeq2);
+  }
+}
+
 double** AlignmentAlgorithm::IUB()
 {
   static double rowA[] = { 5,-4,-4,-4,1,1,1,-4,-4,-4,-1,-1,-1,-4,-2 };
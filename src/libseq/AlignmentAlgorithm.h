@@ -31,6 +31,41 @@ class AlignmentAlgorithm {
     virtual double computeAlignScore(const NTSequence& seq1, 
 				     const NTSequence& seq2) = 0;
 
+    /**
+     * An upper bound for the score of align(seq1, seq2), for a nucleotide
+     * sequence seq2 of length seq2Size that needs at least edits
+     * substitutions, insertions and deletions to match any part of seq1
+     * (see EditDistance).
+     *
+     * The default implementation has no bound, and returns infinity.
+     */
+    virtual double maxAlignScore(int seq2Size, int edits);
+
+    /**
+     * Pair-wise align one nucleotide sequence against a batch of nucleotide
+     * sequences.
+     *
+     * Every sequence in seq2s is aligned in-place, as by
+     * align(seq1, seq2s[i]), with alignedSeq1s[i] the correspondingly
+     * aligned copy of seq1, and scores[i] the alignment score.
+     *
+     * The default implementation aligns them one by one.
+     */
+    virtual void alignBatch(const NTSequence& seq1,
+			    std::vector<NTSequence>& seq2s,
+			    std::vector<NTSequence>& alignedSeq1s,
+			    std::vector<double>& scores);
+
+    /**
+     * The scores of align(seq1, seq2s[i]) of amino acid sequences, in
+     * scores[i], without the alignments.
+     *
+     * The default implementation aligns copies one by one.
+     */
+    virtual void alignScores(const AASequence& seq1,
+			     const std::vector<AASequence>& seq2s,
+			     std::vector<double>& scores);
+
     /**
      * Similarity weights matrix for nucleotides.
      *
@@ -1,12 +1,32 @@
 #include "CodonAlign.h"
+#include "CodonReference.h"
+#include "EditDistance.h"
 
 #include <algorithm>
+#include <limits>
+#include <memory>
 
 namespace seq {
 
-CodonAlign::CodonAlign(AlignmentAlgorithm* algorithm)
+namespace {
+  // the least nucleotide alignment score of an alignment
+  const double MIN_NT_SCORE = 200;
+
+  /*
+   * A reading frame is not aligned when it shares less than a
+   * FRAME_KMER_RATIO part of the amino acid k-mers that the best frame
+   * shares with the reference, and the best frame shares at least
+   * MIN_FRAME_KMERS of them.
+   */
+  const int FRAME_KMER_RATIO = 4;
+  const int MIN_FRAME_KMERS = 8;
+}
+
+CodonAlign::CodonAlign(AlignmentAlgorithm* algorithm,
+		       const CodonReference* reference)
 { 
   algorithm_ = algorithm;
+  reference_ = reference;
 }
 
 double CodonAlign::alignLikeAA(NTSequence& seq1, 
@@ -74,11 +94,47 @@ bool CodonAlign::haveGaps(const NTSequence& seq, int from, int to)
   return false;
 }
 
+bool CodonAlign::tooDifferent(const NTSequence& ref, const NTSequence& target,
+			      double& maxScore) const
+{
+  /*
+   * The edit distance is at most the target length: only short targets
+   * can be rejected.
+   */
+  maxScore = algorithm_->maxAlignScore(target.size(), target.size());
+  if (maxScore >= MIN_NT_SCORE)
+    return false;
+
+  EditDistance edits(ref, target);
+  maxScore = algorithm_->maxAlignScore(target.size(), edits.distance());
+
+  return maxScore < MIN_NT_SCORE;
+}
+
 std::pair<double, int>
 CodonAlign::align(NTSequence& ref, NTSequence& target, int maxFrameShifts)
+{
+  double maxScore;
+  if (tooDifferent(ref, target, maxScore))
+    throw AlignmentError(maxScore, 0, ref, target,
+			 "Alignment error: too different from the reference.");
+
+  NTSequence refNTAligned = ref;
+  NTSequence targetNTAligned = target;
+  double ntScore = algorithm_->align(refNTAligned, targetNTAligned);
+
+  return align(ref, target, maxFrameShifts,
+	       refNTAligned, targetNTAligned, ntScore);
+}
+
+std::pair<double, int>
+CodonAlign::align(NTSequence& ref, NTSequence& target, int maxFrameShifts,
+		  const NTSequence& refNTAligned,
+		  const NTSequence& targetNTAligned,
+		  double ntScore)
 {
   /*
-   * 1. translate the reference sequence
+   * 1. translate the reference sequence, unless it has been prepared
    * 2. for every open reading frame:
    *   - translate the target sequence
    *   - perform the alignment
@@ -88,35 +144,62 @@ CodonAlign::align(NTSequence& ref, NTSequence& target, int maxFrameShifts)
    * 5. make nucleotide sequence alignment, compare score, if difference
    *    too big then correct the frame shift and repeat.
    */
-  AASequence refAA = AASequence::translate(ref);
+  if (ntScore == -std::numeric_limits<double>::infinity())
+    throw AlignmentError(ntScore, 0, refNTAligned, targetNTAligned,
+			 "Alignment error: abandoned by X-drop.");
 
-  NTSequence refNTAligned = ref;
-  NTSequence targetNTAligned = target;
-  double ntScore = algorithm_->align(refNTAligned, targetNTAligned);
-
-  if(ntScore < 200)
+  if(ntScore < MIN_NT_SCORE)
     throw AlignmentError(ntScore,0,refNTAligned,targetNTAligned);
 
-  int bestFrameShift = -1;
-  double bestScore = -1E10;
-  AASequence bestRefAA;
-  AASequence bestTargetAA;
+  std::unique_ptr<CodonReference> unprepared;
+  const CodonReference *reference = reference_;
+  if (!reference) {
+    unprepared.reset(new CodonReference(ref));
+    reference = unprepared.get();
+  }
+
+  const AASequence& refAA = reference->protein();
+
+  std::vector<AASequence> targetAAs(3);
+  int sharedKmers[3];
+  int mostSharedKmers = 0;
 
   for (unsigned i = 0; i < 3; ++i) {
     int last = i + ((target.size() - i) / 3) * 3;
-    AASequence targetAA
+    targetAAs[i]
       = AASequence::translate(target.begin() + i, target.begin() + last);
 
-    AASequence refCopyAA = refAA;
-    double score = algorithm_->align(refCopyAA, targetAA);
+    sharedKmers[i] = reference->sharedKmers(targetAAs[i]);
+    mostSharedKmers = std::max(mostSharedKmers, sharedKmers[i]);
+  }
 
-    if (score > bestScore) {
-      bestFrameShift = i;
-      bestScore = score;
-      bestRefAA = refCopyAA;
-      bestTargetAA = targetAA;
+  /*
+   * The frames that remain are only scored (unless one remains), and only
+   * the best one is aligned.
+   */
+  std::vector<AASequence> frameAAs;
+  std::vector<int> frames;
+  for (unsigned i = 0; i < 3; ++i)
+    if (mostSharedKmers < MIN_FRAME_KMERS
+	|| sharedKmers[i] * FRAME_KMER_RATIO >= mostSharedKmers) {
+      frames.push_back(i);
+      frameAAs.push_back(AASequence());
+      frameAAs.back().swap(targetAAs[i]);
     }
-  }
+
+  std::vector<double> scores;
+  if (frames.size() > 1)
+    algorithm_->alignScores(refAA, frameAAs, scores);
+
+  unsigned best = 0;
+  for (unsigned k = 1; k < frames.size(); ++k)
+    if (scores[k] > scores[best])
+      best = k;
+
+  int bestFrameShift = frames[best];
+  AASequence bestRefAA = refAA;
+  AASequence& bestTargetAA = frameAAs[best];
+  algorithm_->align(bestRefAA, bestTargetAA);
 
   NTSequence refCodonAligned = ref;
   NTSequence targetCodonAligned = target;
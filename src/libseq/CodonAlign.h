@@ -8,6 +8,9 @@
  * libseq namespace
  */
 namespace seq {
+
+class CodonReference;
+
 /**
   * Thrown when alignment failed.
   */
@@ -65,8 +68,13 @@ class CodonAlign {
 public:
   /**
    * Constructor
+   *
+   * If reference is not 0, then all alignments are of (copies of)
+   * reference->sequence(), which is not translated again for every
+   * alignment.
    */
-  CodonAlign(AlignmentAlgorithm* algorithm);
+  CodonAlign(AlignmentAlgorithm* algorithm,
+	     const CodonReference* reference = 0);
 
  /**
  * Perform codon-based alignment of nucleotide sequences.
@@ -80,7 +88,10 @@ public:
  * The procedure translates the target sequence in the 3 ORFs,
  * and for each ORF performs an amino-acid alignment against the translated
  * reference sequence. The best alignment is used to create the nucleotide
- * alignment.
+ * alignment. ORFs that share clearly fewer amino acid 3-mers with the
+ * translated reference than the best ORF are not aligned, and the others
+ * are only scored (see AlignmentAlgorithm::alignScores()) before the best
+ * one is aligned.
  *
  * Then, the score of the codon aligned nucleotide alignment is computed, and
  * compared with a direct nucleotide alignment of both nucleotide sequences.
@@ -92,12 +103,43 @@ public:
  * The result is the nucleotide alignment score of the codon alignment, and
  * the number of frameshifts that have been corrected.
  *
+ * Targets that are too different from the reference (see tooDifferent())
+ * are rejected before they are aligned.
+ *
  * @throws FrameShiftError when frameshifts could not be corrected, or
  *         the number of detected frameshifts exceeds maxFrameShifts.
+ * @throws AlignmentError when the nucleotide alignment score is too low.
  */
  std::pair<double, int>
  align(NTSequence& ref, NTSequence& target, int maxFrameShifts = 1);
 
+ /**
+  * Perform codon-based alignment of nucleotide sequences, for which the
+  * direct nucleotide alignment (ntAlignedRef, ntAlignedTarget, with score
+  * ntScore) has already been computed, e.g. with
+  * AlignmentAlgorithm::alignBatch().
+  *
+  * The result is the same as for align(ref, target, maxFrameShifts).
+  */
+ std::pair<double, int>
+ align(NTSequence& ref, NTSequence& target, int maxFrameShifts,
+       const NTSequence& ntAlignedRef, const NTSequence& ntAlignedTarget,
+       double ntScore);
+
+ /**
+  * Returns whether the (ungapped) target is certainly too different from
+  * ref to be aligned: when, given their edit distance (see EditDistance),
+  * no nucleotide alignment can reach the minimum score, as bounded by
+  * AlignmentAlgorithm::maxAlignScore() (in maxScore).
+  *
+  * Since a deletion may cost as little as a gap extension, the bound only
+  * rejects short targets: with the default scores, targets of at most
+  * 117 nucleotides (for which even a target with as many edits as
+  * nucleotides cannot score 200).
+  */
+ bool tooDifferent(const NTSequence& ref, const NTSequence& target,
+		   double& maxScore) const;
+
 private:
   bool haveGaps(const NTSequence& seq, int from, int to);
   double alignLikeAA(NTSequence& seq1, NTSequence& seq2, 
@@ -106,6 +148,7 @@ private:
   bool noGapAt(const NTSequence& seq, unsigned int i) const;
 
   AlignmentAlgorithm* algorithm_;
+  const CodonReference* reference_;
 };
 }
 
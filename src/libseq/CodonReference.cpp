@@ -0,0 +1,41 @@
+#include "CodonReference.h"
+
+namespace seq {
+
+namespace {
+  const int SYMBOLS = AminoAcid::AA_J + 1;
+}
+
+CodonReference::CodonReference(const NTSequence& sequence)
+  : sequence_(sequence),
+    protein_(AASequence::translate(sequence))
+{
+  int kmers = 1;
+  for (int k = 0; k < K; ++k)
+    kmers *= SYMBOLS;
+
+  kmers_.resize(kmers, false);
+  for (unsigned i = 0; i + K <= protein_.size(); ++i)
+    kmers_[kmer(protein_, i)] = true;
+}
+
+int CodonReference::sharedKmers(const AASequence& seq) const
+{
+  int result = 0;
+  for (unsigned i = 0; i + K <= seq.size(); ++i)
+    if (kmers_[kmer(seq, i)])
+      ++result;
+
+  return result;
+}
+
+int CodonReference::kmer(const AASequence& seq, unsigned i)
+{
+  int result = 0;
+  for (int k = 0; k < K; ++k)
+    result = result * SYMBOLS + seq[i + k].intRep();
+
+  return result;
+}
+
+}
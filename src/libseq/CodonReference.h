@@ -0,0 +1,61 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef CODON_REFERENCE_H_
+#define CODON_REFERENCE_H_
+
+#include <vector>
+
+#include <AASequence.h>
+
+/**
+ * libseq namespace
+ */
+namespace seq {
+
+/**
+ * A reference ORF, prepared for codon alignments (see CodonAlign): with
+ * its translation, and an index of the amino acid k-mers of that
+ * translation.
+ *
+ * When many targets are aligned against the same reference, the reference
+ * is prepared only once.
+ */
+class CodonReference
+{
+public:
+  /**
+   * The length of the amino acid k-mers.
+   */
+  static const int K = 3;
+
+  /**
+   * Prepares the (ungapped) reference ORF.
+   */
+  CodonReference(const NTSequence& sequence);
+
+  /**
+   * The reference ORF.
+   */
+  const NTSequence& sequence() const { return sequence_; }
+
+  /**
+   * The translation of the reference ORF.
+   */
+  const AASequence& protein() const { return protein_; }
+
+  /**
+   * The number of amino acid k-mers of seq that are also k-mers of
+   * protein(), counting repeated k-mers of seq repeatedly.
+   */
+  int sharedKmers(const AASequence& seq) const;
+
+private:
+  NTSequence        sequence_;
+  AASequence        protein_;
+  std::vector<bool> kmers_; // by kmer()
+
+  static int kmer(const AASequence& seq, unsigned i);
+};
+
+}
+
+#endif // CODON_REFERENCE_H_
@@ -0,0 +1,126 @@
+#include "EditDistance.h"
+
+#include <algorithm>
+
+namespace seq {
+
+namespace {
+  typedef unsigned long long Word;
+
+  const int WORD_BITS = 64;
+  const int SYMBOLS = Nucleotide::NT_GAP + 1;
+
+  std::vector<int> symbols(const NTSequence& seq)
+  {
+    std::vector<int> result;
+    result.reserve(seq.size());
+    for (unsigned i = 0; i < seq.size(); ++i)
+      result.push_back(seq[i].intRep());
+
+    return result;
+  }
+
+  /*
+   * Advances a block of vertical differences (Pv: +1, Mv: -1) by one
+   * text symbol, with Eq the pattern positions that match it, given the
+   * horizontal difference hin at the top of the block, and returns the
+   * horizontal difference at row high of the block.
+   */
+  int advanceBlock(Word& Pv, Word& Mv, Word Eq, int hin, Word high)
+  {
+    Word Xv = Eq | Mv;
+    if (hin < 0)
+      Eq |= 1;
+    Word Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+
+    Word Ph = Mv | ~(Xh | Pv);
+    Word Mh = Pv & Xh;
+
+    int hout = 0;
+    if (Ph & high)
+      hout = 1;
+    else if (Mh & high)
+      hout = -1;
+
+    Ph <<= 1;
+    Mh <<= 1;
+    if (hin < 0)
+      Mh |= 1;
+    else if (hin > 0)
+      Ph |= 1;
+
+    Pv = Mh | ~(Xv | Ph);
+    Mv = Ph & Xv;
+
+    return hout;
+  }
+}
+
+EditDistance::EditDistance(const NTSequence& reference,
+			   const NTSequence& target)
+{
+  end_ = bestEnd(symbols(reference), symbols(target), distance_);
+}
+
+void EditDistance::endDistances(const NTSequence& reference,
+				const NTSequence& target,
+				std::vector<int>& distances)
+{
+  int distance;
+  bestEnd(symbols(reference), symbols(target), distance, &distances);
+}
+
+/*
+ * Returns the first end in text of the pattern with the least edit
+ * distance, as distance, and the distance for every end in distances
+ * (if not 0).
+ */
+int EditDistance::bestEnd(const std::vector<int>& text,
+			  const std::vector<int>& pattern, int& distance,
+			  std::vector<int> *distances)
+{
+  const int m = pattern.size();
+  const int blocks = (m + WORD_BITS - 1) / WORD_BITS;
+
+  distance = m;
+  int best = 0;
+
+  if (distances)
+    distances->assign(text.size() + 1, m);
+
+  if (m == 0)
+    return 0;
+
+  // by symbol and block: the pattern positions with that symbol
+  std::vector<Word> peq(SYMBOLS * blocks, 0);
+  for (int j = 0; j < m; ++j)
+    peq[pattern[j] * blocks + j / WORD_BITS] |= Word(1) << (j % WORD_BITS);
+
+  std::vector<Word> Pv(blocks, ~Word(0)), Mv(blocks, 0);
+  const Word lastHigh = Word(1) << ((m - 1) % WORD_BITS);
+  const Word high = Word(1) << (WORD_BITS - 1);
+
+  int score = m;
+  for (unsigned i = 0; i < text.size(); ++i) {
+    const Word *eq = &peq[text[i] * blocks];
+
+    // the top row is free: any start in the text
+    int h = 0;
+    for (int b = 0; b < blocks; ++b)
+      h = advanceBlock(Pv[b], Mv[b], eq[b], h,
+		       b == blocks - 1 ? lastHigh : high);
+
+    score += h;
+    if (distances)
+      (*distances)[i + 1] = score;
+
+    if (score < distance) {
+      distance = score;
+      best = i + 1;
+    }
+  }
+
+  return best;
+}
+
+}
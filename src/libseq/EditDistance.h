@@ -0,0 +1,64 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef EDIT_DISTANCE_H_
+#define EDIT_DISTANCE_H_
+
+#include <vector>
+
+#include <NTSequence.h>
+
+/**
+ * libseq namespace
+ */
+namespace seq {
+
+/**
+ * Semi-global edit distance of a target within a reference: the least
+ * number of substitutions, insertions and deletions that turn the target
+ * into some part of the reference. Nucleotides match only if they are
+ * identical.
+ *
+ * It is computed with the bit-vector algorithm of Myers (1999), in blocks
+ * of 64 target positions (Hyyrö, 2003): every reference nucleotide updates
+ * a column of 64 cells with a handful of word operations. This is much
+ * cheaper than an alignment, and serves to estimate how different a
+ * target is, and where it lies on the reference, before aligning it.
+ */
+class EditDistance
+{
+public:
+  /**
+   * Computes the edit distance of (ungapped) target within reference.
+   */
+  EditDistance(const NTSequence& reference, const NTSequence& target);
+
+  /**
+   * The edit distance.
+   */
+  int distance() const { return distance_; }
+
+  /**
+   * The end (exclusive) of the part of the reference that is closest to
+   * the target.
+   */
+  int end() const { return end_; }
+
+  /**
+   * Computes, for every end e (0 to the length of the reference), the edit
+   * distance of target within the part of reference that ends at e, in
+   * distances[e].
+   */
+  static void endDistances(const NTSequence& reference,
+			   const NTSequence& target,
+			   std::vector<int>& distances);
+
+private:
+  int distance_, end_;
+
+  static int bestEnd(const std::vector<int>& text,
+		     const std::vector<int>& pattern, int& distance,
+		     std::vector<int> *distances = 0);
+};
+
+}
+
+#endif // EDIT_DISTANCE_H_
@@ -3,6 +3,7 @@
 
 #include "NTSequence.h"
 #include "ParseException.h"
+#include "Random.h"
 
 namespace seq {
 
@@ -16,7 +17,7 @@ NTSequence::NTSequence(unsigned size)
 
 NTSequence::NTSequence(const std::string name, const std::string description,
 		       const std::string aSeqString,
-		       bool sampleAmbiguities)
+		       Random *sampleAmbiguities)
   : std::vector<Nucleotide>(aSeqString.length()),
     name_(name),
     description_(description)
@@ -25,7 +26,7 @@ NTSequence::NTSequence(const std::string name, const std::string description,
     try {
       Nucleotide nt(aSeqString[i]);
       if (sampleAmbiguities)
-	nt.sampleAmbiguity();
+	nt.sampleAmbiguity(*sampleAmbiguities);
 
       (*this)[i] = nt;
     } catch (ParseException& e) {
@@ -39,10 +40,10 @@ NTSequence::NTSequence(const const_iterator first,
   : std::vector<Nucleotide>(first, last)
 { }
 
-void NTSequence::sampleAmbiguities()
+void NTSequence::sampleAmbiguities(Random& random)
 {
   for (unsigned i = 0; i < size(); ++i) {
-    (*this)[i].sampleAmbiguity();
+    (*this)[i].sampleAmbiguity(random);
   }
 }
 
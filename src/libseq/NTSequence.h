@@ -43,15 +43,15 @@ public:
    * string will be interpreted as a Nucleotide using the
    * Nucleotide::Nucleotide(char) constructor.
    *
-   * If sampleAmbiguities = true, then sampleAmbiguities() is
-   * performed during construction.
+   * If a random generator is given, then sampleAmbiguities() is
+   * performed with it during construction.
    *
    * \sa sampleAmbiguities()
    */
   NTSequence(const std::string name,
 	     const std::string description,
 	     const std::string aSeqString,
-	     bool sampleAmbiguities = false);
+	     Random *sampleAmbiguities = 0);
 
   /**
    * Create a nucleotide sequence with empty name and emtpy
@@ -63,11 +63,11 @@ public:
   /**
    * Remove ambiguity nucleotide symbols by replacing them by sampling
    * a random non-ambiguous nucleotide that is represented by the
-   * ambiguity symbol.
+   * ambiguity symbol, with the given random generator.
    *
-   * \sa Nucleotide::sampleAmbiguity()
+   * \sa Nucleotide::sampleAmbiguity(Random&)
    */
-  void sampleAmbiguities();
+  void sampleAmbiguities(Random& random);
 
   NTSequence reverseComplement() const;
 
@@ -1,18 +1,529 @@
 #include "NeedlemanWunsh.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
 
 namespace seq {
 
+namespace {
+  // traceback directions
+  const unsigned char DIAGONAL = 0;
+  const unsigned char HORIZONTAL = 1;
+  const unsigned char VERTICAL = 2;
+
+  /*
+   * Groups with larger tables, or with fewer sequences (for which most
+   * of the lanes would be wasted), are aligned one by one.
+   */
+  const double MAX_LANES_TABLE_SIZE = 512. * 1024 * 1024;
+  const unsigned MIN_LANES_USED = NeedlemanWunsh::BATCH_LANES / 2;
+
+  // tiles of a single alignment with more threads
+  const int TILE_SIZE = 512;
+  const double MIN_TILED_CELLS = 4. * 1024 * 1024;
+
+  // the least number of cells for scoring sequences concurrently
+  const double MIN_CONCURRENT_CELLS = 1E5;
+
+  template <typename Symbol>
+  bool containsGaps(const std::vector<Symbol>& seq)
+  {
+    for (unsigned i = 0; i < seq.size(); ++i)
+      if (seq[i] == Symbol::GAP)
+	return true;
+
+    return false;
+  }
+
+#ifdef __GNUC__
+  /*
+   * A GCC (or clang) vector of the widest SIMD registers of the target:
+   * the cells of all lanes are computed with BATCH_LANES / VECTOR_DOUBLES
+   * vectors. (Comparisons of wider vectors are not vectorized.)
+   */
+#if defined(__AVX512F__)
+  const int VECTOR_DOUBLES = 8;
+#elif defined(__AVX__)
+  const int VECTOR_DOUBLES = 4;
+#else
+  const int VECTOR_DOUBLES = 2;
+#endif
+
+  typedef double Vector
+    __attribute__((vector_size(VECTOR_DOUBLES * sizeof(double))));
+  typedef decltype(Vector() > Vector()) VectorMask;
+
+  void load(Vector& v, const double *p)
+  {
+    std::memcpy(&v, p, sizeof(Vector));
+  }
+
+  void store(double *p, const Vector& v)
+  {
+    std::memcpy(p, &v, sizeof(Vector));
+  }
+
+  void broadcast(Vector& v, double d)
+  {
+    for (int k = 0; k < VECTOR_DOUBLES; ++k)
+      v[k] = d;
+  }
+
+  /*
+   * v = mask ? a : b, with bitwise operations, which (unlike ?:) do not
+   * need blend instructions.
+   */
+  void select(Vector& v, const VectorMask& mask,
+	      const Vector& a, const Vector& b)
+  {
+    v = (Vector)(((VectorMask)a & mask) | ((VectorMask)b & ~mask));
+  }
+#endif
+
+  /*
+   * Reconstructs the best solution alignment of every lane, from the
+   * directions of cells (i, j) of all lanes, which are adjacent.
+   */
+  void tracebackLanes(const unsigned char *directions,
+		      int seq1Size, const int *seq2Size, int columns,
+		      NTSequence **seq2s, NTSequence **alignedSeq1s)
+  {
+    const int L = NeedlemanWunsh::BATCH_LANES;
+
+    for (int l = 0; l < L && seq2s[l]; ++l) {
+      NTSequence& s1 = *alignedSeq1s[l];
+      NTSequence& s2 = *seq2s[l];
+
+      int i = seq1Size+1, j = seq2Size[l]+1;
+      do {
+	unsigned char d = directions[((i-1) * columns + (j-1)) * L + l];
+	if (d == DIAGONAL) {
+	  --i; --j;
+	} else if (d == HORIZONTAL) {
+	  --i;
+	  s2.insert(s2.begin() + (j-1), Nucleotide::GAP);
+	} else {
+	  --j;
+	  s1.insert(s1.begin() + (i-1), Nucleotide::GAP);
+	}
+      } while (i > 1 || j > 1);
+    }
+  }
+
+  /*
+   * Chooses the best of the scores of a diagonal, horizontal and vertical
+   * move into a cell, as needlemanWunshAlign() does, and returns its
+   * direction.
+   */
+  unsigned char choose(long sextend, long sgaphoriz, long sgapvert,
+		       long& score)
+  {
+    if ((sextend >= sgaphoriz) && (sextend >= sgapvert)) {
+      score = sextend;
+      return DIAGONAL;
+    } else if (sgaphoriz > sgapvert) {
+      score = sgaphoriz;
+      return HORIZONTAL;
+    } else {
+      score = sgapvert;
+      return VERTICAL;
+    }
+  }
+
+  bool isInteger(double d)
+  {
+    return std::fabs(d - std::floor(d + 0.5)) < 1E-9
+      && std::fabs(d) < (1 << 20);
+  }
+
+  int toInteger(double d)
+  {
+    return (int)std::floor(d + 0.5);
+  }
+
+  // d multiplied by scale, as an integer, or d itself without a scale
+  double scaled(double d, int scale)
+  {
+    return scale ? toInteger(d * scale) : d;
+  }
+
+  struct BySize {
+    const std::vector<NTSequence> *seqs;
+
+    bool operator()(unsigned a, unsigned b) const {
+      return (*seqs)[a].size() < (*seqs)[b].size();
+    }
+  };
+}
+
 NeedlemanWunsh::NeedlemanWunsh(double gapOpenScore,
 			       double gapExtensionScore,
 			       double **ntWeightMatrix,
 			       double **aaWeightMatrix)
+  : scaledNtWeights_(ScoringMatrix::Nucleotides, ntWeightMatrix),
+    scaledAaWeights_(ScoringMatrix::AminoAcids, aaWeightMatrix)
 {
   gapOpenScore_ = gapOpenScore;
   gapExtensionScore_ = gapExtensionScore;
   ntWeightMatrix_ = ntWeightMatrix;
   aaWeightMatrix_ = aaWeightMatrix;
+  threads_ = 1;
+  xDrop_ = 0;
+  scale_ = integerScale();
+
+  /*
+   * With scale_, the recurrences add integers, which are exact in
+   * doubles: the same ties are broken in the same way by every variant,
+   * including alignLaneDifferences().
+   */
+  unit_ = scale_ ? scale_ : 1;
+  scaledGapOpenScore_ = scaled(gapOpenScore_, scale_);
+  scaledGapExtensionScore_ = scaled(gapExtensionScore_, scale_);
+
+  ScoringMatrix *matrices[] = { &scaledNtWeights_, &scaledAaWeights_ };
+  for (int m = 0; m < 2; ++m) {
+    double **weights = matrices[m]->weights();
+    for (int s = 0; s < matrices[m]->size(); ++s)
+      for (int t = 0; t < matrices[m]->size(); ++t)
+	weights[s][t] = scaled(weights[s][t], scale_);
+  }
+}
+
+/*
+ * A tiling of the table, with for every row of tiles the scores of its
+ * last row, and for every column of tiles the scores of its last column.
+ */
+template <typename Symbol>
+struct NeedlemanWunsh::Tiling
+{
+  const NeedlemanWunsh      *algorithm;
+  const std::vector<Symbol> *seq1;
+  const std::vector<Symbol> *seq2;
+  double                   **weightMatrix;
+  unsigned char             *directions;
+
+  int tileSize, tileRows, tileColumns;
+
+  std::vector<std::vector<double> > bottoms; // per tile row, by column
+  std::vector<std::vector<double> > rights;  // per tile column, by row
+  std::vector<double>               zeros;   // row 0, column 0
+
+  void fill(int tileRow, int tileColumn);
+};
+
+template <typename Symbol>
+void NeedlemanWunsh::Tiling<Symbol>::fill(int tileRow, int tileColumn)
+{
+  const int rows = seq1->size() + 1;
+  const int columns = seq2->size() + 1;
+
+  const int firstRow = 1 + tileRow * tileSize;
+  const int firstColumn = 1 + tileColumn * tileSize;
+
+  algorithm->fillTile(*seq1, *seq2, weightMatrix,
+		      firstRow, std::min(firstRow + tileSize, rows),
+		      firstColumn, std::min(firstColumn + tileSize, columns),
+		      tileRow ? &bottoms[tileRow - 1][0] : &zeros[0],
+		      tileColumn ? &rights[tileColumn - 1][0] : &zeros[0],
+		      &bottoms[tileRow][0], &rights[tileColumn][0],
+		      directions);
+}
+
+/*
+ * Computes the tiles first, first + step, ... of an anti-diagonal wave.
+ */
+template <typename Symbol>
+void NeedlemanWunsh::fillWave(Tiling<Symbol> *tiling, int wave,
+			      int first, int step)
+{
+  int firstTileRow = std::max(0, wave - tiling->tileColumns + 1);
+  int endTileRow = std::min(wave + 1, tiling->tileRows);
+
+  for (int tileRow = firstTileRow + first; tileRow < endTileRow;
+       tileRow += step)
+    tiling->fill(tileRow, wave - tileRow);
+}
+
+/*
+ * Computes the scores and directions of the cells with row in
+ * [firstRow, endRow[ and column in [firstColumn, endColumn[, given the
+ * scores of the row above (top, by column) and of the column to the left
+ * (left, by row), and the directions of the cells above and to the left.
+ *
+ * The scores of the last row and the last column are stored in bottom
+ * (by column) and right (by row).
+ */
+template <typename Symbol>
+void NeedlemanWunsh::fillTile(const std::vector<Symbol>& seq1,
+			      const std::vector<Symbol>& seq2,
+			      double** weightMatrix,
+			      int firstRow, int endRow,
+			      int firstColumn, int endColumn,
+			      const double *top, const double *left,
+			      double *bottom, double *right,
+			      unsigned char *directions) const
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+  const int columns = seq2Size + 1;
+
+  double edgeGapExtensionScore = 0;
+
+  // scores of the previous and current row, from column firstColumn - 1
+  std::vector<double> prevRow(top + firstColumn - 1, top + endColumn);
+  std::vector<double> row(prevRow.size());
+
+  for (int i = firstRow; i < endRow; ++i) {
+    const unsigned char *prevDirections = &directions[(i-1) * columns];
+    unsigned char *rowDirections = &directions[i * columns];
+
+    row[0] = left[i];
+
+    for (int j = firstColumn; j < endColumn; ++j) {
+      const int k = j - firstColumn + 1;
+
+      double sextend
+	= prevRow[k-1]
+	+ weightMatrix[seq1[i-1].intRep()][seq2[j-1].intRep()];
+
+      double ges = (j == seq2Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double horizGapScore = ((prevDirections[j] == HORIZONTAL)
+			      || (j == seq2Size)
+			      ? ges : scaledGapOpenScore_ + ges);
+      double sgaphoriz
+	= prevRow[k] + horizGapScore;
+
+      ges = (i == seq1Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double vertGapScore = (rowDirections[j-1] == VERTICAL || (i == seq1Size)
+			     ? ges : scaledGapOpenScore_ + ges);
+      double sgapvert
+	= row[k-1] + vertGapScore;
+
+      if ((sextend >= sgaphoriz) && (sextend >= sgapvert)) {
+	row[k] = sextend;
+	rowDirections[j] = DIAGONAL;
+      } else {
+	if (sgaphoriz > sgapvert) {
+	  row[k] = sgaphoriz;
+	  rowDirections[j] = HORIZONTAL;
+	} else {
+	  row[k] = sgapvert;
+	  rowDirections[j] = VERTICAL;
+	}
+      }
+    }
+
+    right[i] = row.back();
+    prevRow.swap(row);
+  }
+
+  std::copy(prevRow.begin() + 1, prevRow.end(), bottom + firstColumn);
+}
+
+/*
+ * Computes the scores and directions of the cells of the table, as
+ * fillTile() for a single tile, but with X-drop: a cell that scores more
+ * than xDrop below the best score of the path into it (since the start
+ * of that path, in row 0 or column 0, where the alignment may start for
+ * free) is dropped (scores -infinity). The drop is thus measured from
+ * every start separately: a good alignment that starts deep in seq1 is
+ * not dropped because of a better partial alignment elsewhere.
+ *
+ * In every row, only the cells that can be reached from cells that were
+ * not dropped are computed. The cells of the last column and of the last
+ * row, in which the alignment has ended (gaps are then free), are kept
+ * as they are, with the best score of the path into them.
+ *
+ * Returns the score of the last cell, or -infinity if it scores more than
+ * xDrop below the best score of any cell: the alignment that ended there
+ * was dropped (e.g. a chimera, of which only a part matches).
+ */
+template <typename Symbol>
+double NeedlemanWunsh::fillXDrop(const std::vector<Symbol>& seq1,
+				 const std::vector<Symbol>& seq2,
+				 double** weightMatrix, double xDrop,
+				 unsigned char *directions) const
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+  const int columns = seq2Size + 1;
+  const double dropped = -std::numeric_limits<double>::infinity();
+
+  double edgeGapExtensionScore = 0;
+  double best = 0;
+
+  // the scores, and the best scores of the paths into the cells
+  std::vector<double> prevRow(columns, 0), row(columns, dropped);
+  std::vector<double> prevBest(columns, 0), rowBest(columns, 0);
+
+  // the columns of prevRow and row that were not dropped, in order
+  std::vector<int> prevKept(columns), rowKept;
+  for (int j = 0; j < columns; ++j)
+    prevKept[j] = j;
+
+  for (int i = 1; i <= seq1Size; ++i) {
+    const unsigned char *prevDirections = &directions[(i-1) * columns];
+    unsigned char *rowDirections = &directions[i * columns];
+
+    for (unsigned k = 0; k < rowKept.size(); ++k)
+      row[rowKept[k]] = dropped;
+    rowKept.clear();
+
+    // the alignment may start in any row
+    row[0] = 0;
+    rowBest[0] = 0;
+    rowKept.push_back(0);
+
+    unsigned p = 0; // the first of prevKept that may be needed
+    for (int j = 1; j < columns;) {
+      double sextend
+	= prevRow[j-1]
+	+ weightMatrix[seq1[i-1].intRep()][seq2[j-1].intRep()];
+
+      double ges = (j == seq2Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double horizGapScore = ((prevDirections[j] == HORIZONTAL)
+			      || (j == seq2Size)
+			      ? ges : scaledGapOpenScore_ + ges);
+      double sgaphoriz
+	= prevRow[j] + horizGapScore;
+
+      ges = (i == seq1Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double vertGapScore = (rowDirections[j-1] == VERTICAL || (i == seq1Size)
+			     ? ges : scaledGapOpenScore_ + ges);
+      double sgapvert
+	= row[j-1] + vertGapScore;
+
+      double pathBest;
+      if ((sextend >= sgaphoriz) && (sextend >= sgapvert)) {
+	row[j] = sextend;
+	pathBest = prevBest[j-1];
+	rowDirections[j] = DIAGONAL;
+      } else {
+	if (sgaphoriz > sgapvert) {
+	  row[j] = sgaphoriz;
+	  pathBest = prevBest[j];
+	  rowDirections[j] = HORIZONTAL;
+	} else {
+	  row[j] = sgapvert;
+	  pathBest = rowBest[j-1];
+	  rowDirections[j] = VERTICAL;
+	}
+      }
+
+      best = std::max(best, row[j]);
+      rowBest[j] = std::max(pathBest, row[j]);
+      if (row[j] < rowBest[j] - xDrop && j < seq2Size && i < seq1Size)
+	row[j] = dropped;
+
+      if (row[j] != dropped) {
+	rowKept.push_back(j);
+	++j;
+      } else {
+	/*
+	 * the next cell that is reached from the previous row: diagonally
+	 * or vertically from a cell that was kept
+	 */
+	while (p < prevKept.size() && prevKept[p] < j)
+	  ++p;
+	if (p == prevKept.size())
+	  break;
+	j = (prevKept[p] == j) ? j + 1 : prevKept[p];
+      }
+    }
+
+    prevRow.swap(row);
+    prevBest.swap(rowBest);
+    prevKept.swap(rowKept);
+  }
+
+  double score = prevRow[seq2Size];
+  if (score < best - xDrop)
+    return dropped;
+
+  return score;
+}
+
+/*
+ * Computes the score of the last cell of the table, as fillTile() for a
+ * single tile, but keeping only the scores and directions of the
+ * previous and the current row. The sequences have no gaps.
+ */
+template <typename Symbol>
+double NeedlemanWunsh::fillScore(const std::vector<Symbol>& seq1,
+				 const std::vector<Symbol>& seq2,
+				 double** weightMatrix) const
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+  const int columns = seq2Size + 1;
+
+  double edgeGapExtensionScore = 0;
+
+  std::vector<double> prevRow(columns, 0);
+  std::vector<double> row(columns, 0);
+
+  // row 0: leading gaps without penalty
+  std::vector<unsigned char> prevDirections(columns, VERTICAL);
+  std::vector<unsigned char> rowDirections(columns);
+  prevDirections[0] = DIAGONAL;
+
+  for (int i = 1; i <= seq1Size; ++i) {
+    row[0] = 0;
+    rowDirections[0] = HORIZONTAL;
+
+    for (int j = 1; j < columns; ++j) {
+      double sextend
+	= prevRow[j-1]
+	+ weightMatrix[seq1[i-1].intRep()][seq2[j-1].intRep()];
+
+      double ges = (j == seq2Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double horizGapScore = ((prevDirections[j] == HORIZONTAL)
+			      || (j == seq2Size)
+			      ? ges : scaledGapOpenScore_ + ges);
+      double sgaphoriz
+	= prevRow[j] + horizGapScore;
+
+      ges = (i == seq1Size)
+	? edgeGapExtensionScore : scaledGapExtensionScore_;
+
+      double vertGapScore = (rowDirections[j-1] == VERTICAL || (i == seq1Size)
+			     ? ges : scaledGapOpenScore_ + ges);
+      double sgapvert
+	= row[j-1] + vertGapScore;
+
+      if ((sextend >= sgaphoriz) && (sextend >= sgapvert)) {
+	row[j] = sextend;
+	rowDirections[j] = DIAGONAL;
+      } else {
+	if (sgaphoriz > sgapvert) {
+	  row[j] = sgaphoriz;
+	  rowDirections[j] = HORIZONTAL;
+	} else {
+	  row[j] = sgapvert;
+	  rowDirections[j] = VERTICAL;
+	}
+      }
+    }
+
+    prevRow.swap(row);
+    prevDirections.swap(rowDirections);
+  }
+
+  return (seq1Size && seq2Size) ? prevRow[seq2Size] : 0;
 }
 
 /*
@@ -24,7 +535,7 @@ NeedlemanWunsh::NeedlemanWunsh(double gapOpenScore,
 template <typename Symbol>
 double NeedlemanWunsh::needlemanWunshAlign(std::vector<Symbol>& seq1,
 					   std::vector<Symbol>& seq2,
-					   double** weightMatrix)
+					   double** weightMatrix, double xDrop)
 {
   /*
    * Remove gaps, and warn that we did.
@@ -56,64 +567,71 @@ double NeedlemanWunsh::needlemanWunshAlign(std::vector<Symbol>& seq1,
 
   const int seq1Size = seq1.size();
   const int seq2Size = seq2.size();
+  const int rows = seq1Size + 1;
+  const int columns = seq2Size + 1;
 
-  double **dnTable = new double* [seq1Size+1];
-  for (unsigned i = 0; i < seq1Size+1; ++i)
-    dnTable[i] = new double[seq2Size+1];
-  int    **gapsLengthTable = new int *[seq1Size+1];
-  for (unsigned i = 0; i < seq1Size+1; ++i)
-    gapsLengthTable[i] = new int[seq2Size+1]; // >0: horiz, <0: vert
-
-  double edgeGapExtensionScore = 0;
+  /*
+   * Of the scores, only the last row and column of every tile are kept.
+   * The direction of every cell, in one block, decides both whether a gap
+   * is opened or extended, and the traceback.
+   */
+  std::vector<unsigned char> directions(rows * columns);
 
   /*
-   * compute table
+   * column 0 and row 0: leading gaps without penalty
    */
-  dnTable[0][0] = 0;
-  gapsLengthTable[0][0] = 0;
-  for (unsigned i = 1; i < seq1Size+1; ++i) {
-    dnTable[i][0] = dnTable[i-1][0] + edgeGapExtensionScore;
-    gapsLengthTable[i][0] = gapsLengthTable[i-1][0] + 1;
-  }
-  for (unsigned j = 1; j < seq2Size+1; ++j) {
-    dnTable[0][j] = dnTable[0][j-1] + edgeGapExtensionScore;
-    gapsLengthTable[0][j] = gapsLengthTable[0][j-1] - 1;
-  }
+  directions[0] = DIAGONAL;
+  for (int j = 1; j < columns; ++j)
+    directions[j] = VERTICAL;
+  for (int i = 1; i < rows; ++i)
+    directions[i * columns] = HORIZONTAL;
 
-  for (unsigned i = 1; i < seq1Size+1; ++i) {
-    for (unsigned j = 1; j < seq2Size+1; ++j) {
+  double score;
 
-      double sextend
-	= dnTable[i-1][j-1]
-	+ weightMatrix[seq1[i-1].intRep()][seq2[j-1].intRep()];
+  if (xDrop > 0 && seq1Size && seq2Size) {
+    score = fillXDrop(seq1, seq2, weightMatrix, xDrop, &directions[0]);
 
-      double ges = (j == seq2Size) ? edgeGapExtensionScore : gapExtensionScore_;
+    if (score == -std::numeric_limits<double>::infinity()) {
+      seq1.insert(seq1.end(), seq2Size, Symbol::GAP);
+      seq2.insert(seq2.begin(), seq1Size, Symbol::GAP);
+      return score;
+    }
+  } else {
+    Tiling<Symbol> tiling;
+    tiling.algorithm = this;
+    tiling.seq1 = &seq1;
+    tiling.seq2 = &seq2;
+    tiling.weightMatrix = weightMatrix;
+    tiling.directions = &directions[0];
+    tiling.zeros.resize(std::max(rows, columns), 0);
 
-      double horizGapScore = ((gapsLengthTable[i-1][j] > 0) || (j == seq2Size)
-			      ? ges : gapOpenScore_ + ges);
-      double sgaphoriz
-	= dnTable[i-1][j] + horizGapScore;
+    unsigned threads = threads_;
+    if ((double)seq1Size * seq2Size < MIN_TILED_CELLS)
+      threads = 1;
 
-      ges = (i == seq1Size) ? edgeGapExtensionScore : gapExtensionScore_;
+    tiling.tileSize = threads > 1 ? TILE_SIZE : std::max(rows, columns);
+    tiling.tileRows = (seq1Size + tiling.tileSize - 1) / tiling.tileSize;
+    tiling.tileColumns = (seq2Size + tiling.tileSize - 1) / tiling.tileSize;
 
-      double vertGapScore = (gapsLengthTable[i][j-1] < 0 || (i == seq1Size)
-			     ? ges : gapOpenScore_ + ges);
-      double sgapvert
-	= dnTable[i][j-1] + vertGapScore;
+    tiling.bottoms.resize(tiling.tileRows, std::vector<double>(columns, 0));
+    tiling.rights.resize(tiling.tileColumns, std::vector<double>(rows, 0));
 
-      if ((sextend >= sgaphoriz) && (sextend >= sgapvert)) {
-	dnTable[i][j] = sextend;
-	gapsLengthTable[i][j] = 0;
-      } else {
-	if (sgaphoriz > sgapvert) {
-	  dnTable[i][j] = sgaphoriz;
-	  gapsLengthTable[i][j] = std::max(0, gapsLengthTable[i-1][j]) + 1;
-	} else {
-	  dnTable[i][j] = sgapvert;
-	  gapsLengthTable[i][j] = std::min(0, gapsLengthTable[i][j-1]) - 1;
-	}
-      }
+    for (int wave = 0; wave < tiling.tileRows + tiling.tileColumns - 1; ++wave) {
+      int tiles = std::min(wave + 1, tiling.tileRows)
+	- std::max(0, wave - tiling.tileColumns + 1);
+      int step = std::min((int)threads, tiles);
+
+      std::vector<std::thread> workers;
+      for (int t = 1; t < step; ++t)
+	workers.push_back(std::thread(&fillWave<Symbol>, &tiling, wave,
+				      t, step));
+      fillWave(&tiling, wave, 0, step);
+
+      for (unsigned t = 0; t < workers.size(); ++t)
+	workers[t].join();
     }
+
+    score = (seq1Size && seq2Size) ? tiling.bottoms.back()[seq2Size] : 0;
   }
 
   /*
@@ -121,9 +639,10 @@ double NeedlemanWunsh::needlemanWunshAlign(std::vector<Symbol>& seq1,
    */
   int i = seq1Size+1, j = seq2Size+1;
   do {
-    if (gapsLengthTable[i-1][j-1] == 0) {
+    unsigned char direction = directions[(i-1) * columns + (j-1)];
+    if (direction == DIAGONAL) {
       --i; --j;
-    } else if (gapsLengthTable[i-1][j-1] > 0) {
+    } else if (direction == HORIZONTAL) {
       --i;
       seq2.insert(seq2.begin() + (j-1), Symbol::GAP);
     } else {
@@ -132,26 +651,342 @@ double NeedlemanWunsh::needlemanWunshAlign(std::vector<Symbol>& seq1,
     }
   } while (i > 1 || j > 1);
 
-  double score = dnTable[seq1Size][seq2Size];
-
-  for (unsigned i = 0; i < seq1Size+1; ++i) {
-    delete[] dnTable[i];
-    delete[] gapsLengthTable[i];
-  }
-  delete[] dnTable;
-  delete[] gapsLengthTable;
-
   return score;
 }
   
 double NeedlemanWunsh::align(NTSequence& seq1, NTSequence& seq2)
 {
-  return needlemanWunshAlign(seq1, seq2, ntWeightMatrix_);
+  return needlemanWunshAlign(seq1, seq2, scaledNtWeights_.weights(),
+			     xDrop_ * unit_) / unit_;
 }
 
 double NeedlemanWunsh::align(AASequence& seq1, AASequence& seq2)
 {
-  return needlemanWunshAlign(seq1, seq2, aaWeightMatrix_);
+  return needlemanWunshAlign(seq1, seq2, scaledAaWeights_.weights(), 0)
+    / unit_;
+}
+
+/*
+ * Scores the sequences first, first + step, ... of seq2s.
+ */
+void NeedlemanWunsh::scoreEach(const NeedlemanWunsh *algorithm,
+			       double **weightMatrix, const AASequence *seq1,
+			       const std::vector<AASequence> *seq2s,
+			       std::vector<double> *scores, int first, int step)
+{
+  for (unsigned i = first; i < seq2s->size(); i += step)
+    (*scores)[i] = algorithm->fillScore(*seq1, (*seq2s)[i], weightMatrix)
+      / algorithm->unit_;
+}
+
+void NeedlemanWunsh::alignScores(const AASequence& seq1,
+				 const std::vector<AASequence>& seq2s,
+				 std::vector<double>& scores)
+{
+  /*
+   * Gaps are removed (with a warning) by align().
+   */
+  bool gaps = containsGaps(seq1);
+  for (unsigned i = 0; !gaps && i < seq2s.size(); ++i)
+    gaps = containsGaps(seq2s[i]);
+
+  if (gaps) {
+    AlignmentAlgorithm::alignScores(seq1, seq2s, scores);
+    return;
+  }
+
+  scores.resize(seq2s.size());
+
+  double cells = 0;
+  for (unsigned i = 0; i < seq2s.size(); ++i)
+    cells += (double)seq1.size() * seq2s[i].size();
+
+  int step = std::min((unsigned)seq2s.size(), threads_);
+  if (cells < MIN_CONCURRENT_CELLS)
+    step = 1;
+
+  double **weightMatrix = scaledAaWeights_.weights();
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < step; ++t)
+    workers.push_back(std::thread(&scoreEach, this, weightMatrix,
+				  &seq1, &seq2s, &scores, t, step));
+  scoreEach(this, weightMatrix, &seq1, &seq2s, &scores, 0, step);
+
+  for (unsigned t = 0; t < workers.size(); ++t)
+    workers[t].join();
+}
+
+void NeedlemanWunsh::alignBatch(const NTSequence& seq1,
+				std::vector<NTSequence>& seq2s,
+				std::vector<NTSequence>& alignedSeq1s,
+				std::vector<double>& scores)
+{
+  /*
+   * Gaps are removed (with a warning) by the one by one alignment, which
+   * also implements X-drop.
+   */
+  bool gaps = containsGaps(seq1);
+  for (unsigned i = 0; !gaps && i < seq2s.size(); ++i)
+    gaps = containsGaps(seq2s[i]);
+
+#ifndef __GNUC__
+  gaps = true; // no vector kernel
+#endif
+
+  if (gaps || xDrop_ > 0) {
+    AlignmentAlgorithm::alignBatch(seq1, seq2s, alignedSeq1s, scores);
+    return;
+  }
+
+  alignedSeq1s.assign(seq2s.size(), seq1);
+  scores.resize(seq2s.size());
+
+  std::vector<unsigned> order(seq2s.size());
+  for (unsigned i = 0; i < order.size(); ++i)
+    order[i] = i;
+
+  BySize bySize;
+  bySize.seqs = &seq2s;
+  std::stable_sort(order.begin(), order.end(), bySize);
+
+  for (unsigned g = 0; g < order.size(); g += BATCH_LANES) {
+    NTSequence *lanes2[BATCH_LANES];
+    NTSequence *lanes1[BATCH_LANES];
+    double *laneScores[BATCH_LANES];
+
+    for (int l = 0; l < BATCH_LANES; ++l) {
+      unsigned k = g + l;
+      if (k < order.size()) {
+	lanes2[l] = &seq2s[order[k]];
+	lanes1[l] = &alignedSeq1s[order[k]];
+	laneScores[l] = &scores[order[k]];
+      } else
+	lanes2[l] = lanes1[l] = 0;
+    }
+
+    unsigned used = std::min(g + BATCH_LANES, (unsigned)order.size()) - g;
+    double tableSize = (seq1.size() + 1.)
+      * (seq2s[order[g + used - 1]].size() + 1.) * BATCH_LANES;
+
+    if (used < MIN_LANES_USED || tableSize > MAX_LANES_TABLE_SIZE) {
+      for (int l = 0; l < BATCH_LANES && lanes2[l]; ++l)
+	*laneScores[l] = align(*lanes1[l], *lanes2[l]);
+    } else if (!scale_
+	       || !alignLaneDifferences<short>(seq1, lanes2, lanes1,
+					       laneScores, scale_))
+      alignLanes(seq1, lanes2, lanes1, laneScores);
+  }
+}
+
+/*
+ * The least power of 10 (up to 1000) by which the gap scores and the
+ * nucleotide and amino acid weights are all (small) integers, or 0 if
+ * there is none: the scores are then fixed-point decimals, as the
+ * defaults are (scale 10).
+ */
+int NeedlemanWunsh::integerScale() const
+{
+  const int NT_SYMBOLS = Nucleotide::NT_GAP;
+  const int AA_SYMBOLS = AminoAcid::AA_X + 1;
+
+  for (int scale = 1; scale <= 1000; scale *= 10) {
+    bool integer = isInteger(gapOpenScore_ * scale)
+      && isInteger(gapExtensionScore_ * scale);
+
+    for (int s = 0; integer && s < NT_SYMBOLS; ++s)
+      for (int t = 0; integer && t < NT_SYMBOLS; ++t)
+	integer = isInteger(ntWeightMatrix_[s][t] * scale);
+
+    for (int s = 0; integer && s < AA_SYMBOLS; ++s)
+      for (int t = 0; integer && t < AA_SYMBOLS; ++t)
+	integer = isInteger(aaWeightMatrix_[s][t] * scale);
+
+    if (integer)
+      return scale;
+  }
+
+  return 0;
+}
+
+/*
+ * The recurrence of needlemanWunshAlign(), computed for BATCH_LANES
+ * sequences at once: cells (i, j) of all lanes are adjacent, and are
+ * computed with SIMD vector operations, without branches. Lanes that are
+ * shorter than the longest sequence (or unused) compute meaningless cells
+ * beyond their end, which are never used.
+ *
+ * The weights are looked up per column in a profile of seq2, and the gap
+ * scores of the previous row and column are kept as scores rather than
+ * as directions.
+ */
+void NeedlemanWunsh::alignLanes(const NTSequence& seq1, NTSequence **seq2s,
+				NTSequence **alignedSeq1s, double **scores)
+{
+#ifdef __GNUC__
+  const int L = BATCH_LANES;
+  const int seq1Size = seq1.size();
+
+  int seq2Size[L];
+  int maxSeq2Size = 0;
+  for (int l = 0; l < L; ++l) {
+    seq2Size[l] = seq2s[l] ? seq2s[l]->size() : 0;
+    maxSeq2Size = std::max(maxSeq2Size, seq2Size[l]);
+  }
+
+  const int columns = maxSeq2Size + 1;
+  const int cells = columns * L;
+
+  const double edgeGapExtensionScore = 0;
+  const double gapScore = scaledGapOpenScore_ + scaledGapExtensionScore_;
+
+  /*
+   * profile[s * cells + c]: weight of seq1 symbol s against the seq2
+   * symbol of cell c (column 0 is unused)
+   */
+  const int SYMBOLS = Nucleotide::NT_GAP;
+  std::vector<double> profile(SYMBOLS * cells, 0);
+  for (int l = 0; l < L; ++l)
+    for (int j = 1; j < columns; ++j) {
+      int symbol = j <= seq2Size[l] ? (*seq2s[l])[j-1].intRep()
+	: Nucleotide::N.intRep();
+      for (int s = 0; s < SYMBOLS; ++s)
+	profile[s * cells + j * L + l] = scaledNtWeights_.weights()[s][symbol];
+    }
+
+  /*
+   * scores of extending or opening a horizontal gap in each cell: no
+   * penalty in the last column of a lane
+   */
+  std::vector<double> horizExtensionScores(cells), horizOpenScores(cells);
+  for (int l = 0; l < L; ++l)
+    for (int j = 0; j < columns; ++j) {
+      bool edge = (j == seq2Size[l]);
+      horizExtensionScores[j * L + l]
+	= edge ? edgeGapExtensionScore : scaledGapExtensionScore_;
+      horizOpenScores[j * L + l] = edge ? edgeGapExtensionScore : gapScore;
+    }
+
+  std::vector<double> prevRow(cells, 0), row(cells);
+
+  // score of a horizontal gap from each cell of the previous row
+  std::vector<double> horizGapScores(horizOpenScores), nextHorizGapScores(cells);
+
+  std::vector<unsigned char> directions((seq1Size + 1) * cells);
+  directions[0] = DIAGONAL;
+  for (int c = L; c < cells; ++c)
+    directions[c] = VERTICAL;
+
+  const int V = VECTOR_DOUBLES;
+  const int VECTORS = L / V; // per cell
+
+  for (int i = 1; i < seq1Size + 1; ++i) {
+    const double *weights = &profile[seq1[i-1].intRep() * cells];
+    unsigned char *rowDirections = &directions[i * cells];
+
+    Vector vertExtensionScore, vertOpenScore;
+    broadcast(vertExtensionScore,
+	      (i == seq1Size) ? edgeGapExtensionScore : scaledGapExtensionScore_);
+    broadcast(vertOpenScore,
+	      (i == seq1Size) ? edgeGapExtensionScore : gapScore);
+
+    /*
+     * the score of the previous (left) cell, and of a vertical gap from it
+     */
+    Vector left[VECTORS], vertGapScore[VECTORS];
+
+    for (int l = 0; l < L; ++l) {
+      row[l] = prevRow[l] + edgeGapExtensionScore;
+      rowDirections[l] = HORIZONTAL;
+      nextHorizGapScores[l] = horizExtensionScores[l];
+    }
+
+    for (int v = 0; v < VECTORS; ++v) {
+      load(left[v], &row[v * V]);
+      vertGapScore[v] = vertOpenScore;
+    }
+
+    for (int j = 1; j < columns; ++j) {
+      for (int v = 0; v < VECTORS; ++v) {
+	const int c = j * L + v * V;
+
+	Vector diag, up, weight, horizGapScore;
+	load(diag, &prevRow[c - L]);
+	load(up, &prevRow[c]);
+	load(weight, &weights[c]);
+	load(horizGapScore, &horizGapScores[c]);
+
+	Vector sextend = diag + weight;
+	Vector sgaphoriz = up + horizGapScore;
+	Vector sgapvert = left[v] + vertGapScore[v];
+
+	VectorMask horizontal = sgaphoriz > sgapvert;
+	Vector sgap;
+	select(sgap, horizontal, sgaphoriz, sgapvert);
+
+	VectorMask diagonal = sextend >= sgap;
+	select(left[v], diagonal, sextend, sgap);
+	store(&row[c], left[v]);
+
+	horizontal &= ~diagonal;
+	VectorMask vertical = ~(horizontal | diagonal);
+
+	Vector horizExtensionScore, horizOpenScore, nextHorizGapScore;
+	load(horizExtensionScore, &horizExtensionScores[c]);
+	load(horizOpenScore, &horizOpenScores[c]);
+	select(nextHorizGapScore, horizontal,
+	       horizExtensionScore, horizOpenScore);
+	store(&nextHorizGapScores[c], nextHorizGapScore);
+
+	select(vertGapScore[v], vertical, vertExtensionScore, vertOpenScore);
+
+	VectorMask direction
+	  = (horizontal & HORIZONTAL) | (vertical & VERTICAL);
+	for (int k = 0; k < V; ++k)
+	  rowDirections[c + k] = direction[k];
+      }
+    }
+
+    prevRow.swap(row);
+    horizGapScores.swap(nextHorizGapScores);
+  }
+
+  for (int l = 0; l < L && seq2s[l]; ++l)
+    *scores[l] = prevRow[seq2Size[l] * L + l] / unit_;
+
+  tracebackLanes(&directions[0], seq1Size, seq2Size, columns,
+		 seq2s, alignedSeq1s);
+#endif // __GNUC__
+}
+
+/*
+ * Every nucleotide of seq2 scores at most the best weight, and every edit
+ * loses at least: the difference between the best weight and that of a
+ * substitution, the best weight for an insertion (which is not paired),
+ * or the gap penalty for a deletion.
+ */
+double NeedlemanWunsh::maxAlignScore(int seq2Size, int edits)
+{
+  const int symbols = Nucleotide::NT_GAP;
+
+  double best = ntWeightMatrix_[0][0];
+  double substitution = -std::numeric_limits<double>::infinity();
+  for (int a = 0; a < symbols; ++a)
+    for (int b = 0; b < symbols; ++b) {
+      best = std::max(best, ntWeightMatrix_[a][b]);
+      if (a != b)
+	substitution = std::max(substitution, ntWeightMatrix_[a][b]);
+    }
+
+  double gap = std::min(-gapExtensionScore_,
+			-gapOpenScore_ - gapExtensionScore_);
+  double loss = std::min(std::min(best - substitution, best),
+			 std::min(gap, best + gap));
+
+  if (loss <= 0)
+    return AlignmentAlgorithm::maxAlignScore(seq2Size, edits);
+
+  return best * seq2Size - loss * edits;
 }
 
 double NeedlemanWunsh::computeAlignScore(const NTSequence& seq1, 
@@ -200,4 +1035,254 @@ double NeedlemanWunsh::computeAlignScore(const NTSequence& seq1,
   return score;
 }
 
+/*
+ * The recurrence of alignLanes(), with scores that are multiplied by
+ * scale (see integerScale()) and stored as differences between adjacent
+ * cells (Suzuki and Kasahara, 2018), in Cells: since cell (i, j) only
+ * depends on cells (i-1, j-1), (i-1, j) and (i, j-1), all of its
+ * candidate scores can be taken relative to cell (i-1, j-1):
+ *
+ *  - diagonal:   weight
+ *  - horizontal: dh(i-1, j) + horizontal gap score
+ *  - vertical:   dv(i, j-1) + vertical gap score
+ *
+ * with dh(i, j) = H(i, j) - H(i, j-1) and dv(i, j) = H(i, j) - H(i-1, j).
+ * These differences are small, so that many lanes fit in a SIMD vector,
+ * and the choices are the same as for the (exact) absolute scores.
+ *
+ * Only the gaps without penalty at the end let differences grow without
+ * bound: the last column of every lane, and the last row, are therefore
+ * computed one lane at a time, with absolute scores.
+ *
+ * Returns false, before changing any sequence, if a difference could
+ * overflow a Cell. The lanes must then be aligned otherwise.
+ */
+template <typename Cell>
+bool NeedlemanWunsh::alignLaneDifferences(const NTSequence& seq1,
+					  NTSequence **seq2s,
+					  NTSequence **alignedSeq1s,
+					  double **scores, int scale)
+{
+#ifdef __GNUC__
+  const int L = BATCH_LANES;
+  typedef Cell Cells __attribute__((vector_size(L * sizeof(Cell))));
+
+  const int SYMBOLS = Nucleotide::NT_GAP;
+
+  const int extensionScore = toInteger(gapExtensionScore_ * scale);
+  const int gapScore = toInteger((gapOpenScore_ + gapExtensionScore_) * scale);
+
+  int maxWeight = 0;
+  for (int s = 0; s < SYMBOLS; ++s)
+    for (int t = 0; t < SYMBOLS; ++t)
+      maxWeight = std::max(maxWeight,
+			   std::abs(toInteger(ntWeightMatrix_[s][t] * scale)));
+
+  /*
+   * The differences are at least gapScore. Differences up to bound are
+   * computed without overflow, also of the sums in between.
+   */
+  const int bound
+    = (std::numeric_limits<Cell>::max() + gapScore - maxWeight) / 2;
+
+  if (extensionScore > 0 || gapScore > extensionScore || bound < -gapScore)
+    return false;
+
+  const int seq1Size = seq1.size();
+
+  int seq2Size[L];
+  int maxSeq2Size = 0;
+  for (int l = 0; l < L; ++l) {
+    seq2Size[l] = seq2s[l] ? seq2s[l]->size() : 0;
+    maxSeq2Size = std::max(maxSeq2Size, seq2Size[l]);
+  }
+
+  const int columns = maxSeq2Size + 1;
+  const int cells = columns * L;
+
+  std::vector<Cell> profile(SYMBOLS * cells, 0);
+  for (int l = 0; l < L; ++l)
+    for (int j = 1; j < columns; ++j) {
+      int symbol = j <= seq2Size[l] ? (*seq2s[l])[j-1].intRep()
+	: Nucleotide::N.intRep();
+      for (int s = 0; s < SYMBOLS; ++s)
+	profile[s * cells + j * L + l]
+	  = toInteger(ntWeightMatrix_[s][symbol] * scale);
+    }
+
+  std::vector<Cell> horizExtensionScores(cells), horizOpenScores(cells);
+  for (int l = 0; l < L; ++l)
+    for (int j = 0; j < columns; ++j) {
+      bool edge = (j == seq2Size[l]);
+      horizExtensionScores[j * L + l] = edge ? 0 : extensionScore;
+      horizOpenScores[j * L + l] = edge ? 0 : gapScore;
+    }
+
+  /*
+   * dh of the previous row, and the score of a horizontal gap from each
+   * of its cells, updated in place
+   */
+  std::vector<Cell> dh(cells, 0);
+  std::vector<Cell> horizGapScores(horizOpenScores);
+
+  std::vector<unsigned char> directions((seq1Size + 1) * cells);
+  directions[0] = DIAGONAL;
+  for (int c = L; c < cells; ++c)
+    directions[c] = VERTICAL;
+
+  /*
+   * per lane, with m its length: H(i-1, m-1), H(i-1, m) and dv(i, m-1)
+   */
+  long beforeEnd[L], end[L];
+  Cell beforeEndDifference[L];
+
+  // the columns m-1 of the lanes
+  std::vector<bool> beforeEndColumn(columns, false);
+
+  for (int l = 0; l < L; ++l) {
+    beforeEnd[l] = end[l] = 0;
+    beforeEndDifference[l] = 0;
+    if (seq2Size[l] > 1)
+      beforeEndColumn[seq2Size[l] - 1] = true;
+  }
+
+  Cells zero, maxDifference;
+  for (int l = 0; l < L; ++l) {
+    zero[l] = 0;
+    maxDifference[l] = bound;
+  }
+
+  for (int i = 1; i < seq1Size; ++i) {
+    const Cell *weights = &profile[seq1[i-1].intRep() * cells];
+    unsigned char *rowDirections = &directions[i * cells];
+
+    Cells vertExtensionScore, vertOpenScore;
+    for (int l = 0; l < L; ++l) {
+      vertExtensionScore[l] = extensionScore;
+      vertOpenScore[l] = gapScore;
+      rowDirections[l] = HORIZONTAL;
+    }
+
+    // dv of the previous (left) cell, and the score of a vertical gap from it
+    Cells left = zero, vertGapScore = vertOpenScore;
+    Cells overflow = zero;
+
+    for (int j = 1; j < columns; ++j) {
+      const int c = j * L;
+
+      Cells up, weight, horizGapScore;
+      std::memcpy(&up, &dh[c], sizeof(Cells));
+      std::memcpy(&weight, &weights[c], sizeof(Cells));
+      std::memcpy(&horizGapScore, &horizGapScores[c], sizeof(Cells));
+
+      Cells sgaphoriz = up + horizGapScore;
+      Cells sgapvert = left + vertGapScore;
+
+      Cells horizontal = sgaphoriz > sgapvert;
+      Cells sgap = (sgaphoriz & horizontal) | (sgapvert & ~horizontal);
+
+      Cells diagonal = weight >= sgap;
+      Cells score = (weight & diagonal) | (sgap & ~diagonal);
+
+      Cells right = score - left;
+      left = score - up;
+      overflow |= (left > maxDifference) | (right > maxDifference);
+      std::memcpy(&dh[c], &right, sizeof(Cells));
+
+      if (beforeEndColumn[j])
+	for (int l = 0; l < L; ++l)
+	  if (j == seq2Size[l] - 1)
+	    beforeEndDifference[l] = left[l];
+
+      horizontal &= ~diagonal;
+      Cells vertical = ~(horizontal | diagonal);
+
+      Cells horizExtensionScore, horizOpenScore;
+      std::memcpy(&horizExtensionScore, &horizExtensionScores[c],
+		  sizeof(Cells));
+      std::memcpy(&horizOpenScore, &horizOpenScores[c], sizeof(Cells));
+      horizGapScore = (horizExtensionScore & horizontal)
+	| (horizOpenScore & ~horizontal);
+      std::memcpy(&horizGapScores[c], &horizGapScore, sizeof(Cells));
+
+      vertGapScore = (vertExtensionScore & vertical)
+	| (vertOpenScore & ~vertical);
+
+      Cells direction = (horizontal & HORIZONTAL) | (vertical & VERTICAL);
+      for (int k = 0; k < L; ++k)
+	rowDirections[c + k] = direction[k];
+    }
+
+    for (int l = 0; l < L; ++l)
+      if (overflow[l])
+	return false;
+
+    /*
+     * the last column of every lane (with a horizontal gap without
+     * penalty), after which dh is reset to keep the meaningless cells
+     * beyond it small
+     */
+    for (int l = 0; l < L; ++l) {
+      const int m = seq2Size[l];
+      if (!m)
+	continue;
+
+      const int c = m * L + l;
+      long current = (m > 1) ? beforeEnd[l] + beforeEndDifference[l] : 0;
+      int vertGapScore = (rowDirections[c - L] == VERTICAL)
+	? extensionScore : gapScore;
+
+      long score;
+      rowDirections[c] = choose(beforeEnd[l] + weights[c], end[l],
+				current + vertGapScore, score);
+
+      beforeEnd[l] = current;
+      end[l] = score;
+      dh[c] = 0;
+    }
+  }
+
+  /*
+   * the last row (with vertical gaps without penalty)
+   */
+  for (int l = 0; l < L && seq2s[l]; ++l) {
+    const int m = seq2Size[l];
+    long score = 0;
+
+    if (seq1Size) {
+      const int i = seq1Size;
+      const Cell *weights = &profile[seq1[i-1].intRep() * cells];
+      const unsigned char *prevDirections = &directions[(i-1) * cells];
+      unsigned char *rowDirections = &directions[i * cells];
+
+      rowDirections[l] = HORIZONTAL;
+
+      long diag = 0;
+      for (int j = 1; j <= m; ++j) {
+	const int c = j * L + l;
+	long up = (j < m) ? diag + dh[c] : end[l];
+
+	int horizGapScore = 0;
+	if (j < m)
+	  horizGapScore = (prevDirections[c] == HORIZONTAL)
+	    ? extensionScore : gapScore;
+
+	rowDirections[c] = choose(diag + weights[c], up + horizGapScore,
+				  score, score);
+	diag = up;
+      }
+    }
+
+    *scores[l] = (double)score / scale;
+  }
+
+  tracebackLanes(&directions[0], seq1Size, seq2Size, columns,
+		 seq2s, alignedSeq1s);
+
+  return true;
+#else
+  return false;
+#endif // __GNUC__
+}
+
 }
@@ -3,6 +3,7 @@
 #define NEEDLEMAN_WUNSH_H_
 
 #include <AlignmentAlgorithm.h>
+#include <ScoringMatrix.h>
 
 /**
  * libseq namespace
@@ -28,6 +29,20 @@ class NeedlemanWunsh : public AlignmentAlgorithm
    * The algorithm is NeedleMan-Wunsh, with two popular modifications:
    *  - there is a different cost for opening a gap or for extending a gap.
    *  - there is no gap open cost for a gap at the beginning or the end.
+   *
+   * Whether a gap opens or extends is decided by the direction of the
+   * best path into the neighbouring cell: a single table of scores, with
+   * one direction byte per cell, rather than the three states (match, gap
+   * in either sequence) of Gotoh's algorithm. A gap thus extends only
+   * another gap that was the best choice for its own cell, so the result
+   * is not always the optimal affine gap alignment, but the score is
+   * exactly that of the returned alignment. This is how virulign has
+   * always aligned, and all variants (tiled, batched, X-drop) reproduce it
+   * cell by cell.
+   *
+   * When the scores are fixed-point decimals (as the defaults are, with
+   * one decimal), they are computed as integers (see alignBatch()), so
+   * that ties are exact.
    */
   virtual double align(NTSequence& seq1, NTSequence& seq2);
 
@@ -41,22 +56,140 @@ class NeedlemanWunsh : public AlignmentAlgorithm
    * The algorithm is NeedleMan-Wunsh, with two popular modifications:
    *  - there is a different cost for opening a gap or for extending a gap.
    *  - there is no gap open cost for a gap at the beginning or the end.
+   *
+   * Gaps open or extend as in align(NTSequence&, NTSequence&).
    */
   virtual double align(AASequence& seq1, AASequence& seq2);
 
   virtual double computeAlignScore(const NTSequence& seq1, 
 				   const NTSequence& seq2);
 
+  virtual double maxAlignScore(int seq2Size, int edits);
+
+  /**
+   * Pair-wise align one nucleotide sequence against a batch of nucleotide
+   * sequences, with the same results as align(NTSequence&, NTSequence&).
+   *
+   * Sequences of similar length are aligned together in groups of
+   * BATCH_LANES: the dynamic programming tables of a group are interleaved
+   * so that every cell is computed for all sequences of the group in one
+   * (vectorized) inner loop. Only the traceback direction is kept for
+   * every cell, and the alignments are reconstructed one by one.
+   *
+   * When the gap scores and the weights are integers after scaling by a
+   * power of 10 (as the defaults are, by 10), only the differences between
+   * adjacent cells are kept, in 16-bit integers, which fit many more cells
+   * in a vector. (With the defaults, the differences range from -133 to
+   * beyond 183, which does not fit 8 bits.) Other scores are computed in
+   * doubles.
+   */
+  virtual void alignBatch(const NTSequence& seq1,
+			  std::vector<NTSequence>& seq2s,
+			  std::vector<NTSequence>& alignedSeq1s,
+			  std::vector<double>& scores);
+
+  static const int BATCH_LANES = 8;
+
+  /**
+   * The scores of align(seq1, seq2s[i]) of amino acid sequences, in
+   * scores[i], computed with only two rows of the dynamic programming
+   * table. With more threads (see setThreads()), the sequences are scored
+   * concurrently, on up to that many threads.
+   */
+  virtual void alignScores(const AASequence& seq1,
+			   const std::vector<AASequence>& seq2s,
+			   std::vector<double>& scores);
+
+  /**
+   * Use up to threads threads to align a single pair of long sequences
+   * (e.g. genomes). The table is then computed in square tiles, in
+   * anti-diagonal waves: the tiles of a wave only depend on tiles of
+   * earlier waves, and are computed concurrently.
+   *
+   * The default is 1.
+   */
+  void setThreads(unsigned threads) { threads_ = threads; }
+
+  /**
+   * Stop extending a path through the dynamic programming table of two
+   * nucleotide sequences when it scores more than xDrop below its best
+   * score so far (the X-drop heuristic, as in BLAST), measured from where
+   * it starts (for free) in either sequence. Only a band around well
+   * scoring alignments is then computed, and short stretches from the
+   * other starts, however deep in seq1 the alignment starts.
+   *
+   * An alignment that is abandoned, or in which the end scores more than
+   * xDrop below the best score, scores -infinity: seq1 is then simply
+   * followed by seq2.
+   *
+   * The table is then computed by a single thread, and batches are
+   * aligned one by one. Amino acid alignments are not affected.
+   *
+   * The default is 0: no X-drop.
+   */
+  void setXDrop(double xDrop) { xDrop_ = xDrop; }
+
 private:
   double gapOpenScore_;
   double gapExtensionScore_;
   double **ntWeightMatrix_;
   double **aaWeightMatrix_;
+  unsigned threads_;
+  double xDrop_;
+  int scale_; // see integerScale()
+
+  // the scores multiplied by unit_ (scale_, or 1), in the recurrences
+  double unit_;
+  double scaledGapOpenScore_;
+  double scaledGapExtensionScore_;
+  ScoringMatrix scaledNtWeights_;
+  ScoringMatrix scaledAaWeights_;
+
+  template <typename Symbol> struct Tiling;
 
   template <typename Symbol>
   double needlemanWunshAlign(std::vector<Symbol>& seq1,
 			     std::vector<Symbol>& seq2,
-			     double** weigthMatrix);
+			     double** weigthMatrix, double xDrop);
+
+  template <typename Symbol>
+  void fillTile(const std::vector<Symbol>& seq1,
+		const std::vector<Symbol>& seq2,
+		double** weightMatrix,
+		int firstRow, int endRow, int firstColumn, int endColumn,
+		const double *top, const double *left,
+		double *bottom, double *right,
+		unsigned char *directions) const;
+
+  template <typename Symbol>
+  double fillXDrop(const std::vector<Symbol>& seq1,
+		   const std::vector<Symbol>& seq2,
+		   double** weightMatrix, double xDrop,
+		   unsigned char *directions) const;
+
+  template <typename Symbol>
+  double fillScore(const std::vector<Symbol>& seq1,
+		   const std::vector<Symbol>& seq2,
+		   double** weightMatrix) const;
+
+  static void scoreEach(const NeedlemanWunsh *algorithm,
+			double **weightMatrix, const AASequence *seq1,
+			const std::vector<AASequence> *seq2s,
+			std::vector<double> *scores, int first, int step);
+
+  template <typename Symbol>
+  static void fillWave(Tiling<Symbol> *tiling, int wave,
+		       int first, int step);
+
+  void alignLanes(const NTSequence& seq1, NTSequence **seq2s,
+		  NTSequence **alignedSeq1s, double **scores);
+
+  int integerScale() const;
+
+  template <typename Cell>
+  bool alignLaneDifferences(const NTSequence& seq1, NTSequence **seq2s,
+			    NTSequence **alignedSeq1s, double **scores,
+			    int scale);
 };
 
 }
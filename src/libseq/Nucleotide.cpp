@@ -5,37 +5,27 @@
 
 #include "ParseException.h"
 #include "Nucleotide.h"
+#include "Random.h"
 
 namespace {
 
-#ifdef _WIN32
-
-double drand48()
-{
-	return (double(rand()) / RAND_MAX);
-}
-
-#endif
-
-int sampleUniform(int one, int two)
+int sampleUniform(seq::Random& random, int one, int two)
 {
-  double d = drand48();
-  
-  return (d < 0.5 ? one : two);
+  return (random.uniform(2) == 0 ? one : two);
 }
 
-int sampleUniform(int one, int two, int three)
+int sampleUniform(seq::Random& random, int one, int two, int three)
 {
-  double d = drand48() * 3.;
+  unsigned d = random.uniform(3);
 
-  return (d < 1. ? one : (d < 2. ? two : three));
+  return (d == 0 ? one : (d == 1 ? two : three));
 }
 
-int sampleUniform(int one, int two, int three, int four)
+int sampleUniform(seq::Random& random, int one, int two, int three, int four)
 {
-  double d = drand48() * 4.;
+  unsigned d = random.uniform(4);
 
-  return (d < 1. ? one : (d < 2. ? two : (d < 3. ? three : four)));
+  return (d == 0 ? one : (d == 1 ? two : (d == 2 ? three : four)));
 }
 };
 
@@ -67,7 +57,7 @@ Nucleotide::Nucleotide()
   : rep_(NT_N)
 { }
 
-void Nucleotide::sampleAmbiguity()
+void Nucleotide::sampleAmbiguity(Random& random)
 {
   switch (rep_) {
   case NT_A:
@@ -77,27 +67,27 @@ void Nucleotide::sampleAmbiguity()
   case NT_GAP:
     break;
   case NT_M:
-    rep_ = sampleUniform(NT_A, NT_C); break;
+    rep_ = sampleUniform(random, NT_A, NT_C); break;
   case NT_R:
-    rep_ = sampleUniform(NT_A, NT_G); break;  
+    rep_ = sampleUniform(random, NT_A, NT_G); break;  
   case NT_W:
-    rep_ = sampleUniform(NT_A, NT_T); break;
+    rep_ = sampleUniform(random, NT_A, NT_T); break;
   case NT_S:
-    rep_ = sampleUniform(NT_C, NT_G); break;
+    rep_ = sampleUniform(random, NT_C, NT_G); break;
   case NT_Y:
-    rep_ = sampleUniform(NT_C, NT_T); break;
+    rep_ = sampleUniform(random, NT_C, NT_T); break;
   case NT_K:
-    rep_ = sampleUniform(NT_G, NT_T); break;
+    rep_ = sampleUniform(random, NT_G, NT_T); break;
   case NT_V:
-    rep_ = sampleUniform(NT_A, NT_C, NT_G); break;
+    rep_ = sampleUniform(random, NT_A, NT_C, NT_G); break;
   case NT_H:
-    rep_ = sampleUniform(NT_A, NT_C, NT_T); break;
+    rep_ = sampleUniform(random, NT_A, NT_C, NT_T); break;
   case NT_D:
-    rep_ = sampleUniform(NT_A, NT_G, NT_T); break;
+    rep_ = sampleUniform(random, NT_A, NT_G, NT_T); break;
   case NT_B:
-    rep_ = sampleUniform(NT_C, NT_G, NT_T); break;
+    rep_ = sampleUniform(random, NT_C, NT_G, NT_T); break;
   case NT_N:
-    rep_ = sampleUniform(NT_A, NT_C, NT_G, NT_T); break;
+    rep_ = sampleUniform(random, NT_A, NT_C, NT_G, NT_T); break;
   default:
     std::cerr << rep_ << std::endl;
     assert(false);
@@ -11,6 +11,8 @@
 #include "ParseException.h"
 
 namespace seq {
+
+class Random;
   
 /**
  * A nucleotide, including support for ambiguity codes.
@@ -135,11 +137,12 @@ public:
 
   /**
    * Replace the (ambiguos) nucleotide with a random non-ambigiuos nucleotide
-   * that is represented by the ambiguity symbol.
+   * that is represented by the ambiguity symbol, sampled with the given
+   * random generator.
    *
    * \sa isAmbiguity()
    */
-  void sampleAmbiguity();
+  void sampleAmbiguity(Random& random);
 
   Nucleotide reverseComplement() const;
 
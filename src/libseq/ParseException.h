@@ -9,13 +9,15 @@ namespace seq {
 /**
  * Exception thrown when an error was encountered while parsing the
  * string representation of an nucleotide, nucleotide sequence, amino
- * acid, amino acid sequence, or a FASTA file.
+ * acid, amino acid sequence, a FASTA file, or a scoring matrix.
  *
  * \sa Nucleotide::Nucleotide(char), AminoAcid::AminoAcid(char),
  * NTSequence::NTSequence(const std::string, const std::string, const
  * std::string, bool), AASequence::AASequence(const std::string, const
  * std::string, const std::string), operator>> (std::istream&,
- * NTSequence&), operator>> (std::istream&, AASequence&)
+ * NTSequence&), operator>> (std::istream&, AASequence&),
+ * ScoringMatrix::ScoringMatrix(ScoringMatrix::Alphabet, std::istream&,
+ * const std::string&)
  */
 class ParseException
 {
@@ -25,7 +27,7 @@ public:
     : name_(name), message_(message), recovered_(recovered) { }
 
   /**
-   * The sequence name.
+   * The sequence (or matrix) name.
    */
   std::string name() const { return name_; }
 
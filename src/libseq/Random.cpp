@@ -0,0 +1,35 @@
+#include "Random.h"
+
+namespace {
+  const unsigned long long GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+}
+
+namespace seq {
+
+Random::Random(unsigned long long seed)
+  : state_(seed)
+{ }
+
+Random::Random(unsigned long long seed, unsigned long long stream)
+  : state_(mix(seed) ^ mix(stream + GOLDEN_GAMMA))
+{ }
+
+unsigned long long Random::mix(unsigned long long z)
+{
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+unsigned long long Random::next()
+{
+  state_ += GOLDEN_GAMMA;
+  return mix(state_);
+}
+
+unsigned Random::uniform(unsigned n)
+{
+  return next() % n;
+}
+
+};
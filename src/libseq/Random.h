@@ -0,0 +1,52 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+namespace seq {
+
+/**
+ * A seedable pseudo-random number generator (SplitMix64).
+ *
+ * A generator is not shared between threads: every thread (or every item
+ * of work, such as a target sequence) uses its own generator. To make
+ * results independent of how work is divided over threads, a generator
+ * can be created for a numbered stream (e.g. the index of a target) of a
+ * seed: each stream gives a different, reproducible sequence.
+ *
+ * The generated numbers are the same on every platform.
+ *
+ * \sa Nucleotide::sampleAmbiguity(Random&)
+ */
+class Random {
+public:
+  static const unsigned long long DEFAULT_SEED = 0x5EED;
+
+  /**
+   * Create a generator with the given seed.
+   */
+  Random(unsigned long long seed = DEFAULT_SEED);
+
+  /**
+   * Create a generator for a numbered stream of a seed.
+   */
+  Random(unsigned long long seed, unsigned long long stream);
+
+  /**
+   * Get the next 64-bit random number.
+   */
+  unsigned long long next();
+
+  /**
+   * Get a uniformly distributed random number in [0, n[.
+   */
+  unsigned uniform(unsigned n);
+
+private:
+  unsigned long long state_;
+
+  static unsigned long long mix(unsigned long long z);
+};
+
+};
+
+#endif // RANDOM_H_
@@ -0,0 +1,172 @@
+#include "ScoringMatrix.h"
+
+#include <sstream>
+
+#include "AminoAcid.h"
+#include "Nucleotide.h"
+#include "ParseException.h"
+
+namespace seq {
+
+namespace {
+  int alphabetSize(ScoringMatrix::Alphabet alphabet)
+  {
+    return alphabet == ScoringMatrix::Nucleotides
+      ? Nucleotide::NT_GAP : AminoAcid::AA_X + 1;
+  }
+
+  // the unambiguous symbols are the first ones
+  int unambiguousSymbols(ScoringMatrix::Alphabet alphabet)
+  {
+    return alphabet == ScoringMatrix::Nucleotides
+      ? Nucleotide::NT_M : AminoAcid::AA_STP;
+  }
+
+  std::string lineError(int lineNumber, const std::string& message)
+  {
+    std::ostringstream s;
+    s << "line " << lineNumber << ": " << message;
+    return s.str();
+  }
+}
+
+ScoringMatrix::ScoringMatrix(Alphabet alphabet, double **weights)
+  : alphabet_(alphabet),
+    size_(alphabetSize(alphabet)),
+    weights_(size_ * size_)
+{
+  for (int i = 0; i < size_; ++i)
+    for (int j = 0; j < size_; ++j)
+      weights_[i * size_ + j] = weights[i][j];
+
+  setRows();
+}
+
+ScoringMatrix::ScoringMatrix(Alphabet alphabet, std::istream& s,
+			     const std::string& name)
+  : alphabet_(alphabet),
+    size_(alphabetSize(alphabet)),
+    weights_(size_ * size_, 0)
+{
+  std::vector<int> columns;
+  std::vector<bool> given(size_ * size_, false);
+  std::vector<bool> rowGiven(size_, false);
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(s, line)) {
+    ++lineNumber;
+
+    std::istringstream fields(line);
+    std::string field;
+    if (!(fields >> field) || field[0] == '#')
+      continue;
+
+    if (columns.empty()) {
+      std::vector<bool> columnGiven(size_, false);
+      do {
+	int c = symbol(field, name, lineNumber);
+	if (columnGiven[c])
+	  throw ParseException(name, lineError(lineNumber, "duplicate column "
+					       + field), false);
+	columnGiven[c] = true;
+	columns.push_back(c);
+      } while (fields >> field);
+    } else {
+      int r = symbol(field, name, lineNumber);
+      if (rowGiven[r])
+	throw ParseException(name, lineError(lineNumber, "duplicate row "
+					     + field), false);
+      rowGiven[r] = true;
+
+      for (unsigned j = 0; j < columns.size(); ++j) {
+	double w;
+	if (!(fields >> w))
+	  throw ParseException(name, lineError(lineNumber,
+					       "expected a weight for every "
+					       "column"), false);
+	weights_[r * size_ + columns[j]] = w;
+	given[r * size_ + columns[j]] = true;
+      }
+
+      if (fields >> field)
+	throw ParseException(name, lineError(lineNumber,
+					     "more weights than columns"),
+			     false);
+    }
+  }
+
+  const int required = unambiguousSymbols(alphabet);
+  for (int i = 0; i < required; ++i)
+    for (int j = 0; j < required; ++j)
+      if (!given[i * size_ + j]) {
+	char c1, c2;
+	if (alphabet == Nucleotides) {
+	  c1 = Nucleotide::fromRep(i).toChar();
+	  c2 = Nucleotide::fromRep(j).toChar();
+	} else {
+	  c1 = AminoAcid::fromRep(i).toChar();
+	  c2 = AminoAcid::fromRep(j).toChar();
+	}
+
+	throw ParseException(name, std::string("no weight for ") + c1
+			     + " and " + c2, false);
+      }
+
+  setRows();
+}
+
+ScoringMatrix::ScoringMatrix(const ScoringMatrix& other)
+  : alphabet_(other.alphabet_),
+    size_(other.size_),
+    weights_(other.weights_)
+{
+  setRows();
+}
+
+ScoringMatrix& ScoringMatrix::operator= (const ScoringMatrix& other)
+{
+  alphabet_ = other.alphabet_;
+  size_ = other.size_;
+  weights_ = other.weights_;
+  setRows();
+
+  return *this;
+}
+
+bool ScoringMatrix::operator== (const ScoringMatrix& other) const
+{
+  return alphabet_ == other.alphabet_ && weights_ == other.weights_;
+}
+
+void ScoringMatrix::setRows()
+{
+  rows_.resize(size_);
+  for (int i = 0; i < size_; ++i)
+    rows_[i] = &weights_[i * size_];
+}
+
+/*
+ * Returns the intRep() of the single-character symbol s.
+ */
+int ScoringMatrix::symbol(const std::string& s, const std::string& name,
+			  int lineNumber) const
+{
+  int result = size_;
+
+  if (s.size() == 1) {
+    try {
+      result = alphabet_ == Nucleotides
+	? Nucleotide(s[0]).intRep() : AminoAcid(s[0]).intRep();
+    } catch (ParseException&) {
+    }
+  }
+
+  if (result >= size_)
+    throw ParseException(name, lineError(lineNumber, "unsupported symbol "
+					 + s), false);
+
+  return result;
+}
+
+}
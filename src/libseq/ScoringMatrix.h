@@ -0,0 +1,88 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef SCORING_MATRIX_H_
+#define SCORING_MATRIX_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * libseq namespace
+ */
+namespace seq {
+
+/**
+ * A similarity weights matrix for nucleotides or amino acids, in the form
+ * that is expected by the alignment algorithms: the weights of a symbol
+ * pair are weights()[seq1 symbol][seq2 symbol], by Nucleotide::intRep()
+ * or AminoAcid::intRep().
+ *
+ * A matrix is read from a file in the NCBI format, as the matrices that
+ * come with BLAST (e.g. NUC.4.4 or BLOSUM62): lines that start with '#'
+ * are comments, the first other line lists the symbols of the columns, and
+ * every following line starts with the symbol of a row, followed by a
+ * weight for every column. Weights for the unambiguous symbols (A, C, G
+ * and T, or the 20 amino acids) are required, other weights default to 0.
+ */
+class ScoringMatrix
+{
+public:
+  enum Alphabet { Nucleotides, AminoAcids };
+
+  /**
+   * A copy of a matrix of the given alphabet, e.g. AlignmentAlgorithm::IUB()
+   * or AlignmentAlgorithm::BLOSUM30().
+   */
+  ScoringMatrix(Alphabet alphabet, double **weights);
+
+  /**
+   * Reads a matrix of the given alphabet in the NCBI format. The name is
+   * used in error messages.
+   *
+   * @throws ParseException if the matrix is malformed, has symbols of
+   *   another alphabet, or lacks weights of unambiguous symbols.
+   */
+  ScoringMatrix(Alphabet alphabet, std::istream& s,
+		const std::string& name = std::string());
+
+  ScoringMatrix(const ScoringMatrix& other);
+  ScoringMatrix& operator= (const ScoringMatrix& other);
+
+  /**
+   * The alphabet.
+   */
+  Alphabet alphabet() const { return alphabet_; }
+
+  /**
+   * The number of symbols: the size of both dimensions of weights().
+   */
+  int size() const { return size_; }
+
+  /**
+   * The weights, which are valid for the lifetime of the matrix.
+   */
+  double **weights() { return &rows_[0]; }
+
+  double weight(int symbol1, int symbol2) const {
+    return weights_[symbol1 * size_ + symbol2];
+  }
+
+  bool operator== (const ScoringMatrix& other) const;
+  bool operator!= (const ScoringMatrix& other) const {
+    return !(*this == other);
+  }
+
+private:
+  Alphabet             alphabet_;
+  int                  size_;
+  std::vector<double>  weights_;
+  std::vector<double*> rows_;
+
+  void setRows();
+  int symbol(const std::string& s, const std::string& name,
+	     int lineNumber) const;
+};
+
+}
+
+#endif // SCORING_MATRIX_H_
@@ -0,0 +1,834 @@
+#include "WavefrontAligner.h"
+#include "EditDistance.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <string>
+
+namespace seq {
+
+namespace {
+  const int NONE = -1; // no offset on a diagonal
+
+  // sources of a match offset (besides a mismatch cost)
+  const int DELETION = -1;
+  const int INSERTION = -2;
+  const int START = -3;
+
+  /*
+   * Diagonals that lag this many target nucleotides behind the furthest
+   * diagonal are dropped, from wavefronts wider than MIN_PRUNED_WIDTH.
+   */
+  const int MAX_LAG = 100;
+  const int MIN_PRUNED_WIDTH = 10;
+
+  /*
+   * The wavefronts are abandoned (for NeedlemanWunsh) once they took this
+   * fraction of the cells of the dynamic programming table.
+   */
+  const double MAX_WORK = 0.1;
+
+  /*
+   * An alignment is not checked against NeedlemanWunsh (but recomputed with
+   * it) when the check would take this fraction of the cells of the
+   * dynamic programming table.
+   */
+  const double MAX_CHECKED = 0.25;
+
+  const int INFINITE_COST = INT_MAX / 2;
+
+  // the last move into a cell
+  enum Move { PairMove, DeletionMove, InsertionMove };
+
+  const int SYMBOLS = Nucleotide::NT_GAP;
+
+  bool containsGaps(const NTSequence& seq)
+  {
+    for (unsigned i = 0; i < seq.size(); ++i)
+      if (seq[i] == Nucleotide::GAP)
+	return true;
+
+    return false;
+  }
+
+  /*
+   * Returns whether v * scale is an integer, as result.
+   */
+  bool integerCost(double v, double scale, int& result)
+  {
+    double scaled = v * scale;
+    double rounded = std::floor(scaled + 0.5);
+
+    if (std::fabs(scaled - rounded) > 1E-6 || std::fabs(rounded) > 1E6)
+      return false;
+
+    result = (int)rounded;
+    return true;
+  }
+
+  // k-mers of the start of the target that locate it in the reference
+  const int SEED_LENGTH = 12;
+  const int SEED_WINDOW = 256;
+
+  /*
+   * Sequences of which fewer k-mers are found on one diagonal are too
+   * different, and aligned with NeedlemanWunsh right away.
+   */
+  const double MIN_SEED_FRACTION = 0.1;
+
+  void seeds(const NTSequence& seq, int begin, int end,
+	     std::vector<std::pair<unsigned, int> >& result)
+  {
+    const unsigned mask = (1u << (2 * SEED_LENGTH)) - 1;
+
+    unsigned code = 0;
+    int length = 0;
+    for (int i = begin; i < end; ++i) {
+      int rep = seq[i].intRep();
+      if (rep < 4) {
+	code = ((code << 2) | rep) & mask;
+	if (++length >= SEED_LENGTH)
+	  result.push_back(std::make_pair(code, i + 1 - SEED_LENGTH));
+      } else
+	length = 0;
+    }
+  }
+
+  /*
+   * The diagonal (target position - reference position) on which most
+   * SEED_LENGTH-mers of the first SEED_WINDOW target nucleotides occur in
+   * the reference, and the fraction of those k-mers that do, or INT_MIN
+   * if the target has no such k-mers.
+   */
+  int seedDiagonal(const NTSequence& seq1, const NTSequence& seq2,
+		   double& fraction)
+  {
+    std::vector<std::pair<unsigned, int> > reference, target;
+    seeds(seq1, 0, seq1.size(), reference);
+    seeds(seq2, 0, std::min((int)seq2.size(), SEED_WINDOW), target);
+
+    std::sort(reference.begin(), reference.end());
+
+    std::vector<int> votes(seq1.size() + seq2.size() + 1, 0);
+    for (unsigned t = 0; t < target.size(); ++t) {
+      std::vector<std::pair<unsigned, int> >::const_iterator r
+	= std::lower_bound(reference.begin(), reference.end(),
+			   std::make_pair(target[t].first, INT_MIN));
+      for (; r != reference.end() && r->first == target[t].first; ++r)
+	++votes[target[t].second - r->second + seq1.size()];
+    }
+
+    int best = 0;
+    for (unsigned d = 1; d < votes.size(); ++d)
+      if (votes[d] > votes[best])
+	best = d;
+
+    if (target.empty())
+      return INT_MIN;
+
+    fraction = (double)votes[best] / target.size();
+    return best - (int)seq1.size();
+  }
+
+  int gcd(int a, int b)
+  {
+    while (b) {
+      int t = a % b;
+      a = b;
+      b = t;
+    }
+
+    return a;
+  }
+}
+
+/*
+ * The furthest reaching offsets (target positions) of the diagonals
+ * lo..hi (target position - reference position) for one cost: ending with
+ * a pair (m), with an insertion (i) or with a deletion (d).
+ */
+struct WavefrontAligner::Wavefront
+{
+  int first, lo, hi;
+  std::vector<int> m, i, d; // by diagonal - first
+
+  Wavefront()
+    : first(0), lo(1), hi(0)
+  { }
+
+  bool empty() const { return lo > hi; }
+
+  int M(int k) const { return k < lo || k > hi ? NONE : m[k - first]; }
+  int I(int k) const { return k < lo || k > hi ? NONE : i[k - first]; }
+  int D(int k) const { return k < lo || k > hi ? NONE : d[k - first]; }
+};
+
+WavefrontAligner::WavefrontAligner(double gapOpenScore,
+				   double gapExtensionScore,
+				   double **ntWeightMatrix,
+				   double **aaWeightMatrix)
+  : dynamicProgramming_(gapOpenScore, gapExtensionScore,
+			ntWeightMatrix, aaWeightMatrix),
+    gapOpenScore_(gapOpenScore),
+    gapExtensionScore_(gapExtensionScore),
+    ntWeightMatrix_(ntWeightMatrix),
+    xDrop_(0),
+    wavefront_(false),
+    scale_(1),
+    pairCosts_(SYMBOLS * SYMBOLS)
+{
+  /*
+   * With M the best pair weight, and the target of length m, the score of
+   * an alignment is M * m - cost, with as cost:
+   *  - for every pair: M - weight,
+   *  - for every gap in the target: the gap penalties,
+   *  - for every gap in the reference: the gap penalties + M,
+   *  - for every target nucleotide before or after the reference: M,
+   * and nothing for reference nucleotides before or after the target.
+   *
+   * Identical nucleotides thus cost nothing, and the costs are made
+   * integer by a power of ten.
+   */
+  double best = ntWeightMatrix[0][0];
+  for (int a = 0; a < SYMBOLS; ++a)
+    for (int b = 0; b < SYMBOLS; ++b)
+      best = std::max(best, ntWeightMatrix[a][b]);
+
+  for (double scale = 1; scale <= 1000; scale *= 10) {
+    int open, extension, bonus;
+    if (!integerCost(-gapOpenScore, scale, open)
+	|| !integerCost(-gapExtensionScore, scale, extension)
+	|| !integerCost(best, scale, bonus))
+      continue;
+
+    bool integer = true;
+    for (int a = 0; a < SYMBOLS && integer; ++a)
+      for (int b = 0; b < SYMBOLS && integer; ++b)
+	integer = integerCost(best - ntWeightMatrix[a][b], scale,
+			      pairCosts_[a * SYMBOLS + b]);
+
+    if (!integer)
+      continue;
+
+    if (open < 0 || extension <= 0 || bonus <= 0)
+      break;
+
+    deletionOpenCost_ = open + extension;
+    deletionExtensionCost_ = extension;
+    insertionOpenCost_ = open + extension + bonus;
+    insertionExtensionCost_ = extension + bonus;
+    overhangCost_ = bonus;
+
+    int unit = gcd(gcd(deletionOpenCost_, deletionExtensionCost_),
+		   gcd(insertionOpenCost_, overhangCost_));
+    for (unsigned p = 0; p < pairCosts_.size(); ++p)
+      unit = gcd(unit, pairCosts_[p]);
+
+    deletionOpenCost_ /= unit;
+    deletionExtensionCost_ /= unit;
+    insertionOpenCost_ /= unit;
+    insertionExtensionCost_ /= unit;
+    overhangCost_ /= unit;
+    for (unsigned p = 0; p < pairCosts_.size(); ++p) {
+      pairCosts_[p] /= unit;
+      if (pairCosts_[p])
+	mismatchCosts_.push_back(pairCosts_[p]);
+    }
+
+    std::sort(mismatchCosts_.begin(), mismatchCosts_.end());
+    mismatchCosts_.erase(std::unique(mismatchCosts_.begin(),
+				     mismatchCosts_.end()),
+			 mismatchCosts_.end());
+
+    minEditCost_ = std::min(deletionExtensionCost_,
+			    std::min(insertionExtensionCost_, overhangCost_));
+    for (int a = 0; a < SYMBOLS; ++a)
+      for (int b = 0; b < SYMBOLS; ++b)
+	if (a != b)
+	  minEditCost_ = std::min(minEditCost_, pairCosts_[a * SYMBOLS + b]);
+
+    scale_ = scale;
+    wavefront_ = true;
+    break;
+  }
+}
+
+const WavefrontAligner::Wavefront *
+WavefrontAligner::level(const std::vector<Wavefront>& wavefronts, int s)
+{
+  if (s < 0 || wavefronts[s].empty())
+    return 0;
+  else
+    return &wavefronts[s];
+}
+
+/*
+ * Returns the furthest offset, before following identical nucleotides,
+ * of diagonal k for cost s ending with a pair, and its source as cost:
+ * a mismatch cost, DELETION, INSERTION or START.
+ */
+int WavefrontAligner::matchCandidate(const NTSequence& seq1,
+				     const NTSequence& seq2,
+				     const std::vector<Wavefront>& wavefronts,
+				     int s, int k, int& cost) const
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+
+  int best = NONE;
+  cost = START;
+
+  for (unsigned x = 0; x < mismatchCosts_.size(); ++x) {
+    const Wavefront *w = level(wavefronts, s - mismatchCosts_[x]);
+    int j = w ? w->M(k) : NONE;
+    if (j == NONE)
+      continue;
+
+    int i = j - k;
+    if (i < seq1Size && j < seq2Size
+	&& pairCosts_[seq1[i].intRep() * SYMBOLS + seq2[j].intRep()]
+	   == mismatchCosts_[x]
+	&& j + 1 > best) {
+      best = j + 1;
+      cost = mismatchCosts_[x];
+    }
+  }
+
+  const Wavefront& w = wavefronts[s];
+  if (w.D(k) > best) {
+    best = w.D(k);
+    cost = DELETION;
+  }
+
+  if (w.I(k) > best) {
+    best = w.I(k);
+    cost = INSERTION;
+  }
+
+  /*
+   * Alignments start anywhere in the reference for free, or anywhere in
+   * the target at the cost of the target nucleotides before it.
+   */
+  if (s == 0 && k <= 0 && best == NONE) {
+    best = 0;
+    cost = START;
+  }
+
+  if (k > 0 && s == k * overhangCost_ && k > best) {
+    best = k;
+    cost = START;
+  }
+
+  return best;
+}
+
+bool WavefrontAligner::wavefrontAlign(NTSequence& seq1, NTSequence& seq2,
+				      double& score)
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+
+  const double maxWork = MAX_WORK * seq1Size * seq2Size;
+  double work = 0;
+
+  std::vector<Wavefront> wavefronts;
+
+  /*
+   * The best end: its cost, the cost and diagonal of its last pair, and
+   * whether target nucleotides follow after the reference.
+   */
+  int endCost = INT_MAX, endLevel = 0, endDiagonal = 0;
+  bool endOverhang = false;
+
+  int reached = 0; // the furthest offset of all wavefronts
+
+  double fraction = 1;
+  int seed = seedDiagonal(seq1, seq2, fraction);
+  if (fraction < MIN_SEED_FRACTION)
+    return false;
+
+  for (int s = 0; s < endCost; ++s) {
+    ++work;
+    if (work > maxWork)
+      return false;
+
+    wavefronts.push_back(Wavefront());
+
+    int lo = INT_MAX, hi = INT_MIN;
+    for (unsigned x = 0; x < mismatchCosts_.size(); ++x) {
+      const Wavefront *mismatch = level(wavefronts, s - mismatchCosts_[x]);
+      if (mismatch) {
+	lo = std::min(lo, mismatch->lo);
+	hi = std::max(hi, mismatch->hi);
+      }
+    }
+
+    const Wavefront *deletionOpen = level(wavefronts, s - deletionOpenCost_);
+    const Wavefront *deletionExtension
+      = level(wavefronts, s - deletionExtensionCost_);
+    const Wavefront *insertionOpen = level(wavefronts, s - insertionOpenCost_);
+    const Wavefront *insertionExtension
+      = level(wavefronts, s - insertionExtensionCost_);
+
+    if (deletionOpen) {
+      lo = std::min(lo, deletionOpen->lo - 1);
+      hi = std::max(hi, deletionOpen->hi - 1);
+    }
+    if (deletionExtension) {
+      lo = std::min(lo, deletionExtension->lo - 1);
+      hi = std::max(hi, deletionExtension->hi - 1);
+    }
+    if (insertionOpen) {
+      lo = std::min(lo, insertionOpen->lo + 1);
+      hi = std::max(hi, insertionOpen->hi + 1);
+    }
+    if (insertionExtension) {
+      lo = std::min(lo, insertionExtension->lo + 1);
+      hi = std::max(hi, insertionExtension->hi + 1);
+    }
+    if (s == 0) {
+      if (seed != INT_MIN) {
+	lo = std::min(seed - MAX_LAG, 0);
+	hi = std::min(seed + MAX_LAG, 0);
+      } else {
+	lo = -seq1Size;
+	hi = 0;
+      }
+    }
+    if (s % overhangCost_ == 0 && s / overhangCost_ >= 1
+	&& s / overhangCost_ <= seq2Size
+	&& s / overhangCost_ >= reached - MAX_LAG) {
+      lo = std::min(lo, s / overhangCost_);
+      hi = std::max(hi, s / overhangCost_);
+    }
+
+    lo = std::max(lo, -seq1Size);
+    hi = std::min(hi, seq2Size);
+    if (lo > hi)
+      continue;
+
+    Wavefront& w = wavefronts.back();
+    w.first = w.lo = lo;
+    w.hi = hi;
+    w.m.resize(hi - lo + 1, NONE);
+    w.i.resize(hi - lo + 1, NONE);
+    w.d.resize(hi - lo + 1, NONE);
+
+    work += hi - lo + 1;
+
+    for (int k = lo; k <= hi; ++k) {
+      int j = std::max(deletionOpen ? deletionOpen->M(k + 1) : NONE,
+		       deletionExtension ? deletionExtension->D(k + 1) : NONE);
+      if (j != NONE && j - k <= seq1Size)
+	w.d[k - lo] = j;
+
+      j = std::max(insertionOpen ? insertionOpen->M(k - 1) : NONE,
+		   insertionExtension ? insertionExtension->I(k - 1) : NONE);
+      if (j != NONE && j + 1 <= seq2Size)
+	w.i[k - lo] = j + 1;
+    }
+
+    int furthest = NONE;
+    for (int k = lo; k <= hi; ++k) {
+      int cost;
+      int j = matchCandidate(seq1, seq2, wavefronts, s, k, cost);
+
+      if (j != NONE) {
+	int i = j - k;
+	while (i < seq1Size && j < seq2Size
+	       && !pairCosts_[seq1[i].intRep() * SYMBOLS + seq2[j].intRep()]) {
+	  ++i;
+	  ++j;
+	}
+      }
+
+      w.m[k - lo] = j;
+      furthest = std::max(furthest, std::max(j, std::max(w.i[k - lo],
+							 w.d[k - lo])));
+    }
+
+    reached = std::max(reached, furthest);
+
+    /*
+     * Drop the diagonals at both ends that fell behind.
+     */
+    if (hi - lo + 1 > MIN_PRUNED_WIDTH) {
+      while (w.lo < w.hi
+	     && std::max(w.M(w.lo), std::max(w.I(w.lo), w.D(w.lo)))
+		< furthest - MAX_LAG)
+	++w.lo;
+      while (w.hi > w.lo
+	     && std::max(w.M(w.hi), std::max(w.I(w.hi), w.D(w.hi)))
+		< furthest - MAX_LAG)
+	--w.hi;
+    }
+
+    for (int k = w.lo; k <= w.hi; ++k) {
+      int j = w.M(k);
+      if (j == seq2Size) {
+	endCost = endLevel = s;
+	endDiagonal = k;
+	endOverhang = false;
+	break;
+      } else if (j != NONE && j - k == seq1Size) {
+	int cost = s + (seq2Size - j) * overhangCost_;
+	if (cost < endCost) {
+	  endCost = cost;
+	  endLevel = s;
+	  endDiagonal = k;
+	  endOverhang = true;
+	}
+      }
+    }
+  }
+
+  /*
+   * Trace back the operations, from the end: P(air), D(eletion) or
+   * I(nsertion).
+   */
+  std::string operations;
+
+  int s = endLevel;
+  int k = endDiagonal;
+  int j = wavefronts[s].M(k);
+  if (endOverhang)
+    operations.append(seq2Size - j, 'I');
+  else
+    operations.append(seq1Size - (j - k), 'D');
+
+  enum { Pair, Deletion, Insertion } state = Pair;
+  for (;;) {
+    if (state == Pair) {
+      int cost;
+      int start = matchCandidate(seq1, seq2, wavefronts, s, k, cost);
+
+      operations.append(j - start, 'P');
+      j = start;
+
+      if (cost > 0) {
+	operations += 'P';
+	--j;
+	s -= cost;
+      } else if (cost == DELETION)
+	state = Deletion;
+      else if (cost == INSERTION)
+	state = Insertion;
+      else {
+	if (k > 0)
+	  operations.append(k, 'I');
+	else
+	  operations.append(-k, 'D');
+	break;
+      }
+    } else if (state == Deletion) {
+      const Wavefront *open = level(wavefronts, s - deletionOpenCost_);
+      if (open && open->M(k + 1) == j) {
+	s -= deletionOpenCost_;
+	state = Pair;
+      } else
+	s -= deletionExtensionCost_;
+
+      operations += 'D';
+      ++k;
+    } else {
+      const Wavefront *open = level(wavefronts, s - insertionOpenCost_);
+      if (open && open->M(k - 1) == j - 1) {
+	s -= insertionOpenCost_;
+	state = Pair;
+      } else
+	s -= insertionExtensionCost_;
+
+      operations += 'I';
+      --k;
+      --j;
+    }
+  }
+
+  std::reverse(operations.begin(), operations.end());
+
+  if (!sameAsDynamicProgramming(seq1, seq2, operations))
+    return false;
+
+  /*
+   * Score the alignment as NeedlemanWunsh does, along the path in
+   * fixed-point, and insert the gaps.
+   */
+  NTSequence aligned1, aligned2;
+  aligned1.reserve(operations.size());
+  aligned2.reserve(operations.size());
+
+  long total = 0;
+  int i = 0;
+  j = 0;
+  char previous = 0;
+  for (unsigned o = 0; o < operations.size(); ++o) {
+    char operation = operations[o];
+
+    if (operation == 'P') {
+      total += scaled(ntWeightMatrix_[seq1[i].intRep()][seq2[j].intRep()]);
+      aligned1.push_back(seq1[i++]);
+      aligned2.push_back(seq2[j++]);
+    } else if (operation == 'D') {
+      if (j != 0 && j != seq2Size)
+	total += scaled(previous == 'D'
+			? gapExtensionScore_
+			: gapOpenScore_ + gapExtensionScore_);
+      aligned1.push_back(seq1[i++]);
+      aligned2.push_back(Nucleotide::GAP);
+    } else {
+      if (i != 0 && i != seq1Size)
+	total += scaled(previous == 'I'
+			? gapExtensionScore_
+			: gapOpenScore_ + gapExtensionScore_);
+      aligned1.push_back(Nucleotide::GAP);
+      aligned2.push_back(seq2[j++]);
+    }
+
+    previous = operation;
+  }
+
+  score = total / scale_;
+
+  seq1.swap(aligned1);
+  seq2.swap(aligned2);
+
+  return true;
+}
+
+// score in units of 1 / scale_
+long WavefrontAligner::scaled(double score) const
+{
+  return (long)std::floor(score * scale_ + 0.5);
+}
+
+/*
+ * Returns whether NeedlemanWunsh certainly finds the alignment given by
+ * operations as well.
+ *
+ * NeedlemanWunsh follows, in every cell, the best of the three moves into
+ * it (preferring a pair, then a deletion), given the path that it chose
+ * for the preceding cell. Along the path of the alignment, it thus takes
+ * the same moves if every other move into a cell of the path is worse
+ * than the path up to that cell, for any path that ends with that move.
+ * This is checked with an exact (three-state) dynamic programming of the
+ * least costs of the paths that end with each move, in integer costs, in
+ * a band of diagonals around the alignment: paths outside the band make
+ * so many gaps that they cost more than the whole alignment. Paths that
+ * end in the last column may also come from elsewhere in the reference
+ * (at no cost within that column): the edit distances of the target up
+ * to every end in the reference rule these out when they are far from
+ * the alignment.
+ */
+bool WavefrontAligner::sameAsDynamicProgramming(const NTSequence& seq1,
+						const NTSequence& seq2,
+						const std::string& operations)
+  const
+{
+  const int seq1Size = seq1.size();
+  const int seq2Size = seq2.size();
+
+  if (minEditCost_ <= 0)
+    return false;
+
+  /*
+   * The cells of the path (leaving out row 0 and column 0), the move into
+   * them and the cost of the path up to them.
+   */
+  struct Step {
+    int i, j;
+    Move move;
+    int cost;
+  };
+
+  std::vector<Step> path;
+  path.reserve(operations.size());
+
+  Step step = { 0, 0, PairMove, 0 };
+  for (unsigned o = 0; o < operations.size(); ++o) {
+    if (operations[o] == 'P') {
+      step.cost += pairCosts_[seq1[step.i].intRep() * SYMBOLS
+			      + seq2[step.j].intRep()];
+      step.move = PairMove;
+      ++step.i;
+      ++step.j;
+    } else if (operations[o] == 'D') {
+      if (step.j != 0 && step.j != seq2Size)
+	step.cost += step.move == DeletionMove
+	  ? deletionExtensionCost_ : deletionOpenCost_;
+      step.move = DeletionMove;
+      ++step.i;
+    } else {
+      if (step.i == 0 || step.i == seq1Size)
+	step.cost += overhangCost_;
+      else
+	step.cost += step.move == InsertionMove
+	  ? insertionExtensionCost_ : insertionOpenCost_;
+      step.move = InsertionMove;
+      ++step.j;
+    }
+
+    if (step.i > 0 && step.j > 0)
+      path.push_back(step);
+  }
+
+  /*
+   * The path ends with the reference nucleotides after the target, which
+   * are not in the band (see below).
+   */
+  unsigned end = path.size();
+  while (end > 0 && path[end - 1].j == seq2Size
+	 && path[end - 1].move == DeletionMove)
+    --end;
+
+  if (end == 0)
+    return false;
+
+  /*
+   * Paths that cost no more than the alignment have at most edits edits.
+   */
+  const int cost = step.cost;
+  const int edits = cost / minEditCost_;
+
+  int pathLo = INT_MAX, pathHi = INT_MIN;
+  for (unsigned p = 0; p < end; ++p) {
+    pathLo = std::min(pathLo, path[p].i - path[p].j);
+    pathHi = std::max(pathHi, path[p].i - path[p].j);
+  }
+
+  const int lo = pathLo - 2 * edits - 1;
+  const int hi = pathHi + 2 * edits + 1;
+  const int width = hi - lo + 1;
+
+  if ((double)width * seq1Size > MAX_CHECKED * seq1Size * seq2Size)
+    return false;
+
+  std::vector<int> distances;
+  EditDistance::endDistances(seq1, seq2, distances);
+  for (int e = 0; e <= seq1Size; ++e)
+    if (distances[e] <= edits
+	&& (e - seq2Size < pathLo - edits || e - seq2Size > pathHi + edits))
+      return false;
+
+  /*
+   * The least costs of the cells of a row (by diagonal - lo + 1) that are
+   * reached with a pair, a deletion or an insertion.
+   */
+  std::vector<int> prev[3], row[3];
+  for (int x = 0; x < 3; ++x) {
+    prev[x].assign(width + 2, INFINITE_COST);
+    row[x].assign(width + 2, INFINITE_COST);
+  }
+
+  // row 0: the target nucleotides before the reference
+  for (int j = std::max(0, -hi); j <= std::min(seq2Size, -lo); ++j) {
+    int d = -j - lo + 1;
+    if (j == 0)
+      prev[PairMove][d] = 0;
+    else
+      prev[InsertionMove][d] = j * overhangCost_;
+  }
+
+  unsigned p = 0;
+  for (int i = 1; i <= seq1Size; ++i) {
+    for (int x = 0; x < 3; ++x)
+      std::fill(row[x].begin(), row[x].end(), INFINITE_COST);
+
+    for (int j = std::max(0, i - hi); j <= std::min(seq2Size, i - lo); ++j) {
+      int d = i - j - lo + 1;
+
+      if (j == 0) {
+	// column 0: the reference nucleotides before the target
+	row[DeletionMove][d] = 0;
+	continue;
+      }
+
+      int diagonal = std::min(prev[PairMove][d],
+			      std::min(prev[DeletionMove][d],
+				       prev[InsertionMove][d]));
+      row[PairMove][d] = diagonal
+	+ pairCosts_[seq1[i - 1].intRep() * SYMBOLS + seq2[j - 1].intRep()];
+
+      if (j == seq2Size)
+	row[DeletionMove][d]
+	  = std::min(prev[PairMove][d - 1],
+		     std::min(prev[DeletionMove][d - 1],
+			      prev[InsertionMove][d - 1]));
+      else
+	row[DeletionMove][d]
+	  = std::min(prev[DeletionMove][d - 1] + deletionExtensionCost_,
+		     std::min(prev[PairMove][d - 1],
+			      prev[InsertionMove][d - 1])
+		     + deletionOpenCost_);
+
+      if (i == seq1Size)
+	row[InsertionMove][d]
+	  = std::min(row[PairMove][d + 1],
+		     std::min(row[DeletionMove][d + 1],
+			      row[InsertionMove][d + 1]))
+	  + overhangCost_;
+      else
+	row[InsertionMove][d]
+	  = std::min(row[InsertionMove][d + 1] + insertionExtensionCost_,
+		     std::min(row[PairMove][d + 1],
+			      row[DeletionMove][d + 1])
+		     + insertionOpenCost_);
+    }
+
+    /*
+     * The other ends (in the last column) beyond the band are too
+     * distant from the target.
+     */
+    for (; p < path.size() && path[p].i == i; ++p) {
+      int d = i - path[p].j - lo + 1;
+      if (d > width)
+	continue;
+
+      for (int x = 0; x < 3; ++x)
+	if (x != path[p].move && row[x][d] <= path[p].cost)
+	  return false;
+    }
+
+    for (int x = 0; x < 3; ++x)
+      prev[x].swap(row[x]);
+  }
+
+  return true;
+}
+
+double WavefrontAligner::align(NTSequence& seq1, NTSequence& seq2)
+{
+  double score;
+
+  if (wavefront_ && xDrop_ == 0 && !seq1.empty() && !seq2.empty()
+      && !containsGaps(seq1) && !containsGaps(seq2)
+      && wavefrontAlign(seq1, seq2, score))
+    return score;
+
+  return dynamicProgramming_.align(seq1, seq2);
+}
+
+double WavefrontAligner::align(AASequence& seq1, AASequence& seq2)
+{
+  return dynamicProgramming_.align(seq1, seq2);
+}
+
+double WavefrontAligner::computeAlignScore(const NTSequence& seq1,
+					   const NTSequence& seq2)
+{
+  return dynamicProgramming_.computeAlignScore(seq1, seq2);
+}
+
+double WavefrontAligner::maxAlignScore(int seq2Size, int edits)
+{
+  return dynamicProgramming_.maxAlignScore(seq2Size, edits);
+}
+
+void WavefrontAligner::alignScores(const AASequence& seq1,
+				   const std::vector<AASequence>& seq2s,
+				   std::vector<double>& scores)
+{
+  dynamicProgramming_.alignScores(seq1, seq2s, scores);
+}
+
+}
@@ -0,0 +1,128 @@
+// This may look like C code, but it's really -*- C++ -*-
+#ifndef WAVEFRONT_ALIGNER_H_
+#define WAVEFRONT_ALIGNER_H_
+
+#include <string>
+#include <vector>
+
+#include <NeedlemanWunsh.h>
+
+/**
+ * libseq namespace
+ */
+namespace seq {
+
+/**
+ * Pair-wise alignment of nucleotide sequences with the wavefront algorithm
+ * (WFA), for sequences that are nearly identical.
+ *
+ * The alignments are scored as by NeedlemanWunsh: with a different cost
+ * for opening and extending a gap, and without cost for gaps at the
+ * beginning or the end. But instead of computing all cells of the dynamic
+ * programming table, only the furthest reaching cells of every diagonal
+ * are computed for increasing alignment costs, following exact matches
+ * for free. The time needed thus depends on the number of differences
+ * rather than on the product of the sequence lengths.
+ *
+ * The target (seq2) is expected to lie within the reference (seq1): the
+ * diagonals on which the target may start are found from k-mers that it
+ * shares with the reference, and diagonals that fall far behind are
+ * dropped (as in the adaptive mode of WFA). When the scores cannot be
+ * expressed as integer costs, or when the sequences turn out to be too
+ * different, the alignment is computed with NeedlemanWunsh instead, as
+ * are all amino acid alignments.
+ *
+ * The alignments and scores are those of NeedlemanWunsh: an alignment
+ * found with the wavefront algorithm is only kept if NeedlemanWunsh
+ * certainly finds it as well. It is otherwise recomputed with
+ * NeedlemanWunsh, e.g. when the reference has a (nearly) repeated copy of
+ * the target, or when NeedlemanWunsh extends a gap where opening another
+ * one would score better.
+ */
+class WavefrontAligner : public AlignmentAlgorithm
+{
+  public:
+    WavefrontAligner(double gapOpenScore = -10,
+		     double gapExtensionScore = -3.3,
+		     double **ntWeightMatrix =
+		     AlignmentAlgorithm::IUB(),
+		     double **aaWeightMatrix =
+		     AlignmentAlgorithm::BLOSUM30());
+
+  /**
+   * Pair-wise align two nucleotide sequences, using the wavefront
+   * algorithm.
+   *
+   * The two sequences seq1 and seq2 are aligned in-place: gaps are inserted
+   * according to a global alignment, and they will have equal length.
+   */
+  virtual double align(NTSequence& seq1, NTSequence& seq2);
+
+  /**
+   * Pair-wise align two amino acid sequences, using NeedlemanWunsh.
+   */
+  virtual double align(AASequence& seq1, AASequence& seq2);
+
+  virtual double computeAlignScore(const NTSequence& seq1,
+				   const NTSequence& seq2);
+
+  virtual double maxAlignScore(int seq2Size, int edits);
+
+  /**
+   * The scores of amino acid alignments, using NeedlemanWunsh.
+   */
+  virtual void alignScores(const AASequence& seq1,
+			   const std::vector<AASequence>& seq2s,
+			   std::vector<double>& scores);
+
+  /**
+   * Use up to threads threads for the alignments that are computed with
+   * NeedlemanWunsh.
+   */
+  void setThreads(unsigned threads) { dynamicProgramming_.setThreads(threads); }
+
+  /**
+   * Use X-drop (see NeedlemanWunsh::setXDrop()): all alignments are then
+   * computed with NeedlemanWunsh.
+   */
+  void setXDrop(double xDrop) {
+    xDrop_ = xDrop;
+    dynamicProgramming_.setXDrop(xDrop);
+  }
+
+private:
+  NeedlemanWunsh dynamicProgramming_;
+  double         gapOpenScore_;
+  double         gapExtensionScore_;
+  double       **ntWeightMatrix_;
+  double         xDrop_;
+
+  // false if the scores cannot be expressed as integer costs
+  bool           wavefront_;
+  double         scale_; // power of ten that makes the scores integer
+
+  // costs, in units of the greatest common divisor of all costs
+  std::vector<int> pairCosts_;  // by seq1 and seq2 Nucleotide::intRep()
+  std::vector<int> mismatchCosts_; // distinct non-zero pair costs
+  int            deletionOpenCost_, deletionExtensionCost_;
+  int            insertionOpenCost_, insertionExtensionCost_;
+  int            overhangCost_;
+  int            minEditCost_; // of a gap or a pair of different nucleotides
+
+  struct Wavefront;
+
+  static const Wavefront *level(const std::vector<Wavefront>& wavefronts,
+				int s);
+  bool wavefrontAlign(NTSequence& seq1, NTSequence& seq2, double& score);
+  long scaled(double score) const;
+  bool sameAsDynamicProgramming(const NTSequence& seq1,
+				const NTSequence& seq2,
+				const std::string& operations) const;
+  int matchCandidate(const NTSequence& seq1, const NTSequence& seq2,
+		     const std::vector<Wavefront>& wavefronts,
+		     int s, int k, int& cost) const;
+};
+
+}
+
+#endif // WAVEFRONT_ALIGNER_H_
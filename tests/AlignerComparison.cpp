@@ -0,0 +1,126 @@
+/*
+ * Compares the alignments of WavefrontAligner and NeedlemanWunsh, which
+ * must be the same, of targets that are taken from a reference with
+ * random mutations: from nearly identical targets (for which the
+ * wavefront alignment is used) to divergent ones.
+ *
+ * Usage: AlignerComparison reference.xml [targets.fasta]
+ */
+#include <fstream>
+#include <iostream>
+
+#include "NeedlemanWunsh.h"
+#include "WavefrontAligner.h"
+#include "ReferenceSequence.h"
+
+using namespace seq;
+
+namespace {
+  const int TARGETS = 100;
+
+  unsigned long state = 12345;
+
+  int random(int n)
+  {
+    state = state * 1103515245 + 12345;
+    return (state >> 16) % n;
+  }
+
+  Nucleotide randomNucleotide(bool ambiguous)
+  {
+    return Nucleotide::fromRep(random(ambiguous ? Nucleotide::NT_N + 1
+				      : Nucleotide::NT_M));
+  }
+
+  /*
+   * A fragment of the reference with the given number of mutations
+   * (substitutions, insertions and deletions of 1 to 6 nucleotides).
+   */
+  NTSequence mutate(const NTSequence& reference, int mutations)
+  {
+    int size = 100 + random(reference.size() - 100);
+    int start = random(reference.size() - size + 1);
+    NTSequence result(reference.begin() + start,
+		      reference.begin() + start + size);
+
+    for (int k = 0; k < mutations && result.size() > 10; ++k) {
+      int position = random(result.size());
+      int length = 1 + random(6);
+      switch (random(4)) {
+      case 0:
+      case 1:
+	result[position] = randomNucleotide(random(10) == 0);
+	break;
+      case 2:
+	for (int l = 0; l < length; ++l)
+	  result.insert(result.begin() + position, randomNucleotide(false));
+	break;
+      case 3:
+	result.erase(result.begin() + position,
+		     result.begin() + std::min(position + length,
+					       (int)result.size()));
+      }
+    }
+
+    return result;
+  }
+
+  bool compare(const NTSequence& reference, const NTSequence& target,
+	       int number)
+  {
+    NeedlemanWunsh dynamicProgramming;
+    WavefrontAligner wavefront;
+
+    NTSequence ref1 = reference, target1 = target;
+    NTSequence ref2 = reference, target2 = target;
+    double score1 = dynamicProgramming.align(ref1, target1);
+    double score2 = wavefront.align(ref2, target2);
+
+    if (score1 != score2 || ref1 != ref2 || target1 != target2) {
+      std::cerr << "target " << number << " " << target.name()
+		<< ": NeedlemanWunsh scores " << score1
+		<< ", WavefrontAligner " << score2 << std::endl
+		<< ref1.asString() << std::endl << target1.asString()
+		<< std::endl << ref2.asString() << std::endl
+		<< target2.asString() << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " reference.xml [targets.fasta]"
+	      << std::endl;
+    return 1;
+  }
+
+  NTSequence reference
+    = ReferenceSequence::parseOrfReferenceFile(argv[1]);
+
+  int failed = 0, number = 0;
+
+  for (int t = 0; t < TARGETS; ++t)
+    if (!compare(reference, mutate(reference, t / 10), number++))
+      ++failed;
+
+  if (argc > 2) {
+    std::ifstream f(argv[2]);
+    for (;;) {
+      NTSequence target;
+      f >> target;
+      if (!f)
+	break;
+      if (!compare(reference, target, number++))
+	++failed;
+    }
+  }
+
+  std::cout << failed << " of " << number << " alignments differ"
+	    << std::endl;
+
+  return failed == 0 ? 0 : 1;
+}
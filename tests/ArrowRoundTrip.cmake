@@ -0,0 +1,54 @@
+# Aligns TARGETS against REFERENCE with VIRULIGN, and checks with PYTHON
+# (and pyarrow) that the Arrow exports of the PositionTable and the
+# MutationTable hold the same tables as their CSV exports.
+#
+# The targets are reconstructed from their Deltas export, the first one
+# repeated to fill a record batch: the values of the other targets are
+# then added to the dictionaries in a later batch.
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+
+INCLUDE(${CMAKE_CURRENT_LIST_DIR}/RunVirulign.cmake)
+
+run_virulign(alignment.deltas ${REFERENCE} ${TARGETS} --exportKind Deltas)
+
+FILE(STRINGS ${WORK_DIR}/alignment.deltas lines)
+LIST(GET lines 0 header)
+LIST(GET lines 1 first)
+LIST(REMOVE_AT lines 0 1)
+
+SET(deltas "${header}\n")
+FOREACH(i RANGE 1024)
+  STRING(REGEX REPLACE "^[^,]+" "copy${i}" copy "${first}")
+  SET(deltas "${deltas}${copy}\n")
+ENDFOREACH()
+FOREACH(line ${lines})
+  SET(deltas "${deltas}${line}\n")
+ENDFOREACH()
+FILE(WRITE ${WORK_DIR}/batches.deltas "${deltas}")
+
+# The MutationTable does not depend on the alphabet.
+FOREACH(table PositionTable.Nucleotides PositionTable.AminoAcids
+              MutationTable.AminoAcids)
+  STRING(REPLACE "." ";" table ${table})
+  LIST(GET table 0 kind)
+  LIST(GET table 1 alphabet)
+  FOREACH(insertions yes no)
+    SET(name ${kind}.${alphabet}.${insertions})
+    SET(export --exportKind ${kind} --exportAlphabet ${alphabet}
+               --exportWithInsertions ${insertions})
+    run_virulign(${name}.csv
+                 reconstruct ${REFERENCE} ${WORK_DIR}/batches.deltas ${export})
+    run_virulign(${name}.arrow
+                 reconstruct ${REFERENCE} ${WORK_DIR}/batches.deltas ${export}
+                 --exportFormat Arrow)
+
+    EXECUTE_PROCESS(COMMAND ${PYTHON}
+                            ${CMAKE_CURRENT_LIST_DIR}/ArrowRoundTrip.py
+                            ${WORK_DIR}/${name}.arrow ${WORK_DIR}/${name}.csv 2
+                    RESULT_VARIABLE result)
+    IF(NOT result EQUAL 0)
+      MESSAGE(FATAL_ERROR "${kind} ${alphabet} ${insertions}: the Arrow export differs")
+    ENDIF()
+  ENDFOREACH()
+ENDFOREACH()
@@ -0,0 +1,59 @@
+"""
+Reads an Arrow export with pyarrow and checks that it holds the same
+table as the CSV export of the same kind.
+
+Usage: python3 ArrowRoundTrip.py table.arrow table.csv min-batches
+"""
+import csv
+import sys
+
+import pyarrow
+import pyarrow.ipc
+
+
+def cell(value):
+    if value is None:
+        return ''
+    if value is True:
+        return 'y'
+    if value is False:
+        return 'n'
+    return value
+
+
+def main(arrow_file, csv_file, min_batches):
+    with open(arrow_file, 'rb') as f:
+        reader = pyarrow.ipc.open_file(f)
+        batches = reader.num_record_batches
+        table = reader.read_all()
+
+    if batches < min_batches:
+        sys.exit('%s: %d record batches, expected at least %d'
+                 % (arrow_file, batches, min_batches))
+
+    with open(csv_file) as f:
+        rows = list(csv.reader(f))
+
+    header = rows[0]
+    if table.column_names != header:
+        sys.exit('%s: the columns differ from the CSV header' % arrow_file)
+
+    if table.num_rows != len(rows) - 1:
+        sys.exit('%s: %d rows, the CSV has %d'
+                 % (arrow_file, table.num_rows, len(rows) - 1))
+
+    width = len(header)
+    rows = [row + [''] * (width - len(row)) for row in rows[1:]]
+    for c, name in enumerate(header):
+        expected = [row[c] for row in rows]
+        column = table.column(c)
+        if pyarrow.types.is_dictionary(column.type):
+            column = column.cast(pyarrow.string())
+        values = [cell(v) for v in column.to_pylist()]
+        if values != expected:
+            sys.exit('%s: column %s differs from the CSV'
+                     % (arrow_file, name))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1], sys.argv[2], int(sys.argv[3]))
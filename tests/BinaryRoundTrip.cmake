@@ -0,0 +1,36 @@
+# Aligns TARGETS against REFERENCE with VIRULIGN, and checks that every
+# export of the results that are stored with --exportKind Binary is
+# identical, byte for byte, to the same export of the alignments
+# themselves.
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+
+INCLUDE(${CMAKE_CURRENT_LIST_DIR}/RunVirulign.cmake)
+
+run_virulign(alignment.bin ${REFERENCE} ${TARGETS} --exportKind Binary)
+
+FOREACH(kind Mutations PairwiseAlignments GlobalAlignment PositionTable
+             MutationTable MutationFrequencies Deltas Consensus)
+  FOREACH(alphabet Nucleotides AminoAcids)
+    SET(formats Csv)
+    IF(kind STREQUAL PositionTable OR kind STREQUAL MutationTable)
+      LIST(APPEND formats Arrow)
+    ENDIF()
+
+    FOREACH(format ${formats})
+      SET(name ${kind}.${alphabet}.${format})
+      SET(export --exportKind ${kind} --exportAlphabet ${alphabet}
+                 --exportWithInsertions yes --exportFormat ${format})
+      run_virulign(${name}.aligned ${REFERENCE} ${TARGETS} ${export})
+      run_virulign(${name}.stored export ${WORK_DIR}/alignment.bin ${export})
+
+      EXECUTE_PROCESS(COMMAND ${CMAKE_COMMAND} -E compare_files
+                              ${WORK_DIR}/${name}.aligned
+                              ${WORK_DIR}/${name}.stored
+                      RESULT_VARIABLE result)
+      IF(NOT result EQUAL 0)
+        MESSAGE(FATAL_ERROR "${kind} ${alphabet} ${format}: the export of the stored results differs")
+      ENDIF()
+    ENDFOREACH()
+  ENDFOREACH()
+ENDFOREACH()
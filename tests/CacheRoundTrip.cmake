@@ -0,0 +1,52 @@
+# Aligns TARGETS against REFERENCE with VIRULIGN, without a cache and
+# twice with a cache (the first time to fill it, the second time to
+# reuse it), and checks that the exports are identical: a cached
+# alignment is the alignment itself. The same cache is then used with
+# other alignment parameters, which must not reuse those alignments.
+#
+# The targets are those of TARGETS and FAILING (which fail to align, a
+# result that is cached as well), and copies of those of TARGETS, which
+# are identical to targets in the same run.
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+FILE(REMOVE_RECURSE ${WORK_DIR}/cache)
+
+INCLUDE(${CMAKE_CURRENT_LIST_DIR}/RunVirulign.cmake)
+
+FILE(READ ${TARGETS} targets)
+FILE(READ ${FAILING} failing)
+STRING(REPLACE ">" ">copy-" copies "${targets}")
+FILE(WRITE ${WORK_DIR}/targets.fasta "${targets}${failing}${copies}")
+SET(TARGETS ${WORK_DIR}/targets.fasta)
+
+FUNCTION(compare_exports first second)
+  FILE(READ ${WORK_DIR}/${first} a)
+  FILE(READ ${WORK_DIR}/${second} b)
+  IF(NOT a STREQUAL b)
+    MESSAGE(FATAL_ERROR "${second} differs from ${first}")
+  ENDIF()
+ENDFUNCTION()
+
+FOREACH(kind Mutations Deltas)
+  SET(export --exportKind ${kind})
+  run_virulign(${kind} ${REFERENCE} ${TARGETS} ${export})
+  run_virulign(${kind}.miss
+               ${REFERENCE} ${TARGETS} ${export} --cache ${WORK_DIR}/cache)
+
+  FILE(GLOB cached ${WORK_DIR}/cache/*)
+  IF(NOT cached)
+    MESSAGE(FATAL_ERROR "no alignments were cached")
+  ENDIF()
+
+  run_virulign(${kind}.hit
+               ${REFERENCE} ${TARGETS} ${export} --cache ${WORK_DIR}/cache)
+
+  compare_exports(${kind} ${kind}.miss)
+  compare_exports(${kind} ${kind}.hit)
+ENDFOREACH()
+
+SET(parameters --exportKind Deltas --gapOpenPenalty 20)
+run_virulign(Deltas.other ${REFERENCE} ${TARGETS} ${parameters})
+run_virulign(Deltas.other.cache
+             ${REFERENCE} ${TARGETS} ${parameters} --cache ${WORK_DIR}/cache)
+compare_exports(Deltas.other Deltas.other.cache)
@@ -0,0 +1,136 @@
+/*
+ * Checks the nucleotide counts and the consensus of ConsensusCounts
+ * against counts that are computed by hand, for the same small reference
+ * and given alignments as MutationCountsFixture, with and without the
+ * insertion slots. The counts must not depend on the number of threads
+ * that count them.
+ *
+ * Usage: ConsensusCountsFixture counts.fasta
+ *
+ * counts.fasta holds the reference, followed by the aligned reference
+ * and the aligned target of each alignment.
+ */
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "Alignment.h"
+#include "ConsensusCounts.h"
+
+using namespace seq;
+
+namespace {
+  /*
+   * The partial target covers positions 4 to 12 only, and spans the
+   * insertion slots after 6, as do all others. The indels target inserts
+   * GGG after 6 and deletes 10 to 12. Position 4 has an M (ambiguous),
+   * position 5 a G (substitution) and position 9 an A (partial).
+   */
+  const char *COUNTS =
+    "position,insertion,reference,depth,"
+    "A,C,G,T,M,R,W,S,Y,K,V,H,D,B,N,gap,consensus\n"
+    "1,0,A,4,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,A\n"
+    "2,0,T,4,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,T\n"
+    "3,0,G,4,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,G\n"
+    "4,0,A,5,4,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,M\n"
+    "5,0,A,5,4,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,R\n"
+    "6,0,A,5,5,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,A\n"
+    "6,1,-,5,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,4,G\n"
+    "6,2,-,5,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,4,G\n"
+    "6,3,-,5,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,4,G\n"
+    "7,0,C,5,0,5,0,0,0,0,0,0,0,0,0,0,0,0,0,0,C\n"
+    "8,0,C,5,0,5,0,0,0,0,0,0,0,0,0,0,0,0,0,0,C\n"
+    "9,0,C,5,1,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,M\n"
+    "10,0,G,5,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,1,G\n"
+    "11,0,G,5,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,1,G\n"
+    "12,0,G,5,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,1,G\n"
+    "13,0,T,4,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,T\n"
+    "14,0,T,4,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,T\n"
+    "15,0,T,4,0,0,0,4,0,0,0,0,0,0,0,0,0,0,0,0,T\n";
+
+  const char *CONSENSUS = ">consensus\nATGMRAGGGCCMGGGTTT\n";
+  const char *CONSENSUS_WITHOUT_INSERTIONS = ">consensus\nATGMRACCMGGGTTT\n";
+
+  /*
+   * The counts table without the rows of the insertion slots.
+   */
+  std::string withoutInsertions(const std::string& table)
+  {
+    std::istringstream in(table);
+    std::string result, line;
+    while (std::getline(in, line))
+      if (line.find(",0,") == line.find(',') || result.empty())
+	result += line + "\n";
+
+    return result;
+  }
+
+  bool check(const std::string& what, const std::string& result,
+	     const std::string& expected)
+  {
+    if (result != expected) {
+      std::cerr << what << ": expected" << std::endl << expected
+		<< "got" << std::endl << result;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool check(const ReferenceSequence& reference,
+	     const std::vector<Alignment>& results, bool withInsertions,
+	     unsigned threads)
+  {
+    ConsensusCounts counts(reference);
+    counts.add(results, threads);
+
+    std::ostringstream table, consensus;
+    counts.streamCsv(table, withInsertions);
+    counts.streamConsensus(consensus, withInsertions);
+
+    std::string what = std::string(withInsertions ? "with" : "without")
+      + " insertions, " + std::to_string(threads) + " threads";
+
+    bool ok = check("counts " + what, table.str(),
+		    withInsertions ? std::string(COUNTS)
+		    : withoutInsertions(COUNTS));
+    return check("consensus " + what, consensus.str(),
+		 withInsertions ? CONSENSUS : CONSENSUS_WITHOUT_INSERTIONS)
+      && ok;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " counts.fasta" << std::endl;
+    return 1;
+  }
+
+  std::ifstream f(argv[1]);
+
+  NTSequence sequence;
+  f >> sequence;
+  ReferenceSequence reference(sequence);
+
+  std::vector<Alignment> results;
+  for (;;) {
+    NTSequence alignedRef, target;
+    f >> alignedRef >> target;
+    if (!f)
+      break;
+    results.push_back(Alignment::given(reference, alignedRef, target));
+  }
+
+  bool ok = true;
+  for (unsigned threads = 1; threads <= 3; threads += 2) {
+    ok = check(reference, results, true, threads) && ok;
+    ok = check(reference, results, false, threads) && ok;
+  }
+
+  std::cout << results.size() << " alignments "
+	    << (ok ? "counted as expected" : "miscounted") << std::endl;
+
+  return ok ? 0 : 1;
+}
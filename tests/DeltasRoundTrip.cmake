@@ -0,0 +1,26 @@
+# Aligns TARGETS against REFERENCE with VIRULIGN, and checks that the
+# PairwiseAlignments and GlobalAlignment exports that are reconstructed
+# from the Deltas export are identical, byte for byte, to those of the
+# alignments themselves.
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+
+INCLUDE(${CMAKE_CURRENT_LIST_DIR}/RunVirulign.cmake)
+
+run_virulign(alignment.deltas ${REFERENCE} ${TARGETS} --exportKind Deltas)
+
+FOREACH(kind PairwiseAlignments GlobalAlignment)
+  FOREACH(alphabet Nucleotides AminoAcids)
+    SET(export --exportKind ${kind} --exportAlphabet ${alphabet})
+    run_virulign(${kind}.${alphabet}.aligned
+                 ${REFERENCE} ${TARGETS} ${export})
+    run_virulign(${kind}.${alphabet}.reconstructed
+                 reconstruct ${REFERENCE} ${WORK_DIR}/alignment.deltas ${export})
+
+    FILE(READ ${WORK_DIR}/${kind}.${alphabet}.aligned aligned)
+    FILE(READ ${WORK_DIR}/${kind}.${alphabet}.reconstructed reconstructed)
+    IF(NOT aligned STREQUAL reconstructed)
+      MESSAGE(FATAL_ERROR "${kind} ${alphabet}: the reconstructed export differs")
+    ENDIF()
+  ENDFOREACH()
+ENDFOREACH()
@@ -0,0 +1,112 @@
+/*
+ * Checks the amino acid and codon prevalence tables of MutationCounts
+ * against counts that are computed by hand, for a small reference with
+ * a single region and given alignments: an identical target, a
+ * substitution, a target that covers only part of the region, an
+ * ambiguous codon, and a codon insertion and deletion. The counts must
+ * not depend on the number of threads that count them.
+ *
+ * Usage: MutationCountsFixture counts.fasta
+ *
+ * counts.fasta holds the reference, followed by the aligned reference
+ * and the aligned target of each alignment.
+ */
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "Alignment.h"
+#include "MutationCounts.h"
+
+using namespace seq;
+
+namespace {
+  /*
+   * ATG AAA CCC GGG TTT: M K P G F, covered by all but the partial
+   * target, which covers K P G only.
+   *
+   * K: AAA (identical, partial, indels), AGA (substitution), and MAA
+   *    (ambiguous), which is AAA (K) or CAA (Q).
+   * P: CCC, and CCA (partial).
+   * G: GGG, and deleted (indels). The insertion after K is not counted.
+   */
+  const char *AMINO_ACIDS =
+    "region,position,reference,aminoacid,count,coverage,prevalence\n"
+    "R,1,M,M,4,4,1\n"
+    "R,2,K,K,4,5,0.8\n"
+    "R,2,K,Q,1,5,0.2\n"
+    "R,2,K,R,1,5,0.2\n"
+    "R,3,P,P,5,5,1\n"
+    "R,4,G,G,4,5,0.8\n"
+    "R,4,G,-,1,5,0.2\n"
+    "R,5,F,F,4,4,1\n";
+
+  const char *CODONS =
+    "region,position,reference,codon,count,coverage,prevalence\n"
+    "R,1,ATG,ATG,4,4,1\n"
+    "R,2,AAA,AAA,3,5,0.6\n"
+    "R,2,AAA,AGA,1,5,0.2\n"
+    "R,2,AAA,MAA,1,5,0.2\n"
+    "R,3,CCC,CCA,1,5,0.2\n"
+    "R,3,CCC,CCC,4,5,0.8\n"
+    "R,4,GGG,GGG,4,5,0.8\n"
+    "R,4,GGG,---,1,5,0.2\n"
+    "R,5,TTT,TTT,4,4,1\n";
+
+  bool check(const ReferenceSequence& reference,
+	     const std::vector<Alignment>& results, ExportAlphabet alphabet,
+	     unsigned threads, const std::string& expected)
+  {
+    MutationCounts counts(reference, alphabet);
+    counts.add(results, threads);
+
+    std::ostringstream table;
+    counts.streamCsv(table);
+
+    if (table.str() != expected) {
+      std::cerr << (alphabet == AminoAcids ? "amino acids" : "codons")
+		<< " with " << threads << " threads: expected" << std::endl
+		<< expected << "got" << std::endl << table.str();
+      return false;
+    }
+
+    return true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " counts.fasta" << std::endl;
+    return 1;
+  }
+
+  std::ifstream f(argv[1]);
+
+  NTSequence sequence;
+  f >> sequence;
+  ReferenceSequence reference(sequence);
+  reference.addRegion(ReferenceSequence::Region(0, reference.size() / 3,
+						"R"));
+
+  std::vector<Alignment> results;
+  for (;;) {
+    NTSequence alignedRef, target;
+    f >> alignedRef >> target;
+    if (!f)
+      break;
+    results.push_back(Alignment::given(reference, alignedRef, target));
+  }
+
+  bool ok = true;
+  for (unsigned threads = 1; threads <= 3; threads += 2) {
+    ok = check(reference, results, AminoAcids, threads, AMINO_ACIDS) && ok;
+    ok = check(reference, results, Nucleotides, threads, CODONS) && ok;
+  }
+
+  std::cout << results.size() << " alignments "
+	    << (ok ? "counted as expected" : "miscounted") << std::endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/*
+ * Checks that a ReferencePanel of the ORFs of a genome locates each ORF
+ * within genomes that are assembled from the ORFs, with random spacers
+ * between them (so that the ORFs are in every reading frame) and random
+ * substitutions, and that each ORF is then aligned in its own reading
+ * frame, from its first to its last codon.
+ *
+ * Usage: OrfLocation orf.xml...
+ */
+#include <iostream>
+#include <vector>
+
+#include <NeedlemanWunsh.h>
+
+#include "Alignment.h"
+#include "IsolateMutation.h"
+#include "ReferencePanel.h"
+
+using namespace seq;
+
+namespace {
+  const int GENOMES = 3;
+
+  unsigned long state = 12345;
+
+  int random(int n)
+  {
+    state = state * 1103515245 + 12345;
+    return (state >> 16) % n;
+  }
+
+  Nucleotide randomNucleotide()
+  {
+    return Nucleotide::fromRep(random(Nucleotide::NT_T + 1));
+  }
+
+  /*
+   * A genome with the ORFs in order, each preceded by a spacer of 20 to
+   * 300 random nucleotides, with one in fifty nucleotides substituted.
+   * Returns the position of each ORF in the genome.
+   */
+  NTSequence genome(const std::vector<ReferenceSequence>& orfs, int number,
+		    std::vector<int>& positions)
+  {
+    NTSequence result;
+    result.setName("genome_" + std::to_string(number));
+
+    positions.clear();
+    for (unsigned r = 0; r < orfs.size(); ++r) {
+      for (int spacer = 20 + random(281); spacer > 0; --spacer)
+	result.push_back(randomNucleotide());
+      positions.push_back(result.size());
+      result.insert(result.end(), orfs[r].begin(), orfs[r].end());
+    }
+
+    for (unsigned i = 0; i < result.size(); ++i)
+      if (random(50) == 0)
+	result[i] = randomNucleotide();
+
+    return result;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " orf.xml..." << std::endl;
+    return 1;
+  }
+
+  std::vector<ReferenceSequence> orfs;
+  for (int i = 1; i < argc; ++i)
+    orfs.push_back(ReferenceSequence::parseOrfReferenceFile(argv[i]));
+
+  ReferencePanel panel(orfs);
+  NeedlemanWunsh algorithm;
+
+  int failed = 0, number = 0;
+
+  for (int g = 0; g < GENOMES; ++g) {
+    std::vector<int> positions;
+    NTSequence target = genome(orfs, g, positions);
+
+    std::vector<std::pair<int, int> > windows;
+    panel.locate(target, windows);
+
+    std::vector<Alignment> results;
+    panel.alignAll(target, &algorithm, 3, results);
+
+    for (unsigned r = 0; r < orfs.size(); ++r, ++number) {
+      std::string orf = target.name() + " " + orfs[r].name();
+      int begin = positions[r], end = begin + orfs[r].size();
+
+      if (windows[r].first > begin || windows[r].second < end
+	  || windows[r].second - windows[r].first == (int)target.size()) {
+	std::cerr << orf << " at [" << begin << ", " << end
+		  << "[: located at [" << windows[r].first << ", "
+		  << windows[r].second << "[" << std::endl;
+	++failed;
+	continue;
+      }
+
+      const Alignment& result = results[r];
+      if (!result.success) {
+	std::cerr << orf << ": not aligned" << std::endl;
+	++failed;
+	continue;
+      }
+
+      /*
+       * In another reading frame, most codons would differ.
+       */
+      std::vector<IsolateMutation> mutations;
+      result.isolateMutations(0, mutations);
+
+      const ReferenceSequence::Region& region = orfs[r].regions()[0];
+      const Alignment::AlignedRegion& aligned = result.alignedRegion(0);
+      int codons = region.end() - region.begin();
+      if (aligned.targetBegin != region.begin()
+	  || aligned.targetEnd != region.end() - 1
+	  || (int)mutations.size() > codons / 5) {
+	std::cerr << orf << ": aligned from " << aligned.targetBegin
+		  << " to " << aligned.targetEnd << " with "
+		  << mutations.size() << " mutations in " << codons
+		  << " codons" << std::endl;
+	++failed;
+      }
+    }
+  }
+
+  std::cout << failed << " of " << number << " ORFs misaligned"
+	    << std::endl;
+
+  return failed == 0 ? 0 : 1;
+}
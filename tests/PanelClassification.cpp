@@ -0,0 +1,117 @@
+/*
+ * Checks that a ReferencePanel classifies fragments of each of its
+ * references, with random substitutions and indels, as that reference, and
+ * that aligning against the panel keeps the alignment with that
+ * reference.
+ *
+ * Usage: PanelClassification reference.xml...
+ */
+#include <iostream>
+#include <vector>
+
+#include <NeedlemanWunsh.h>
+
+#include "Alignment.h"
+#include "ReferencePanel.h"
+
+using namespace seq;
+
+namespace {
+  const int FRAGMENTS = 10; // per reference
+  const int ALIGNED = 2;    // of which are aligned against the panel
+  const int TOP_K = 2;
+
+  unsigned long state = 12345;
+
+  int random(int n)
+  {
+    state = state * 1103515245 + 12345;
+    return (state >> 16) % n;
+  }
+
+  Nucleotide randomNucleotide()
+  {
+    return Nucleotide::fromRep(random(Nucleotide::NT_T + 1));
+  }
+
+  /*
+   * A fragment of the reference of 300 to 1500 nucleotides, with one in
+   * ten nucleotides substituted, and a few codon insertions and
+   * deletions.
+   */
+  NTSequence fragment(const NTSequence& reference, int number)
+  {
+    int size = 300 + random(1200);
+    int start = random(reference.size() - size + 1);
+    NTSequence result(reference.begin() + start,
+		      reference.begin() + start + size);
+    result.setName(reference.name() + "_" + std::to_string(number));
+
+    for (unsigned i = 0; i < result.size(); ++i)
+      if (random(10) == 0)
+	result[i] = randomNucleotide();
+
+    for (int k = 0; k < 3; ++k) {
+      int position = random(result.size() - 10);
+      if (random(2) == 0)
+	result.erase(result.begin() + position,
+		     result.begin() + position + 3);
+      else
+	result.insert(result.begin() + position, 3, randomNucleotide());
+    }
+
+    return result;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " reference.xml..." << std::endl;
+    return 1;
+  }
+
+  std::vector<ReferenceSequence> references;
+  for (int i = 1; i < argc; ++i)
+    references.push_back(ReferenceSequence::parseOrfReferenceFile(argv[i]));
+
+  ReferencePanel panel(references);
+  NeedlemanWunsh algorithm;
+
+  int failed = 0, number = 0;
+
+  for (unsigned r = 0; r < references.size(); ++r)
+    for (int f = 0; f < FRAGMENTS; ++f, ++number) {
+      NTSequence target = fragment(references[r], number);
+
+      std::vector<int> ranking = panel.classify(target, 0);
+      if (ranking.size() != references.size() || ranking[0] != (int)r) {
+	std::cerr << target.name() << ": classified as "
+		  << references[ranking[0]].name() << std::endl;
+	++failed;
+	continue;
+      }
+
+      if (panel.classify(target, TOP_K).size() != TOP_K) {
+	std::cerr << target.name() << ": not " << TOP_K << " candidates"
+		  << std::endl;
+	++failed;
+	continue;
+      }
+
+      if (f < ALIGNED) {
+	Alignment result = panel.align(target, &algorithm, 3, TOP_K);
+	if (!result.success
+	    || result.reference().name() != references[r].name()) {
+	  std::cerr << target.name() << ": aligned against "
+		    << result.reference().name() << std::endl;
+	  ++failed;
+	}
+      }
+    }
+
+  std::cout << failed << " of " << number << " fragments misclassified"
+	    << std::endl;
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+# run_virulign(output args...): runs VIRULIGN with args, writing its
+# standard output to WORK_DIR/output, and fails if it fails.
+
+FUNCTION(run_virulign output)
+  EXECUTE_PROCESS(COMMAND ${VIRULIGN} ${ARGN}
+                  OUTPUT_FILE ${WORK_DIR}/${output}
+                  ERROR_QUIET
+                  RESULT_VARIABLE result)
+  IF(NOT result EQUAL 0)
+    MESSAGE(FATAL_ERROR "virulign ${ARGN} failed: ${result}")
+  ENDIF()
+ENDFUNCTION()
@@ -0,0 +1,202 @@
+/*
+ * Checks that ScoringMatrix reads the NCBI matrices that come with BLAST
+ * (BLOSUM62 and NUC.4.4) with the weights of the files, and that
+ * malformed matrices, and matrices of the other alphabet, are rejected
+ * with the line and the reason.
+ *
+ * Usage: ScoringMatrices BLOSUM62 NUC.4.4
+ */
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <AminoAcid.h>
+#include <Nucleotide.h>
+#include <ParseException.h>
+#include <ScoringMatrix.h>
+
+#include "CLIUtils.h"
+
+using namespace seq;
+
+namespace {
+  struct Weight {
+    char   symbol1, symbol2;
+    double weight;
+  };
+
+  const Weight BLOSUM62[] = {
+    { 'A', 'A', 4 }, { 'W', 'W', 11 }, { 'C', 'C', 9 }, { 'A', 'R', -1 },
+    { 'R', 'A', -1 }, { 'W', 'F', 1 }, { 'B', 'D', 4 }, { 'Z', 'E', 4 },
+    { 'X', 'P', -2 }, { '*', 'A', -4 }, { '*', '*', 1 },
+    { 'U', 'C', 0 } // not in the file
+  };
+
+  const Weight NUC_4_4[] = {
+    { 'A', 'A', 5 }, { 'A', 'T', -4 }, { 'T', 'A', -4 }, { 'G', 'S', 1 },
+    { 'A', 'W', 1 }, { 'S', 'S', -1 }, { 'B', 'A', -4 }, { 'N', 'N', -1 },
+    { 'N', 'A', -2 }
+  };
+
+  /*
+   * Malformed nucleotide matrices, and the errors that they must raise.
+   */
+  struct Malformed {
+    const char *matrix;
+    const char *error;
+  };
+
+  const Malformed MALFORMED[] = {
+    { "", "no weight for A and A" },
+    { "A C G T\nA 1 0 0 0\nC 0 1 0 0\nG 0 0 1 0\n",
+      "no weight for T and A" },
+    { "A C G\nA 1 0 0\nC 0 1 0\nG 0 0 1\nT 0 0 0\n",
+      "no weight for A and T" },
+    { "A C G T\nA 1 0 x 0\n", "line 2: expected a weight for every column" },
+    { "# comment\n\nA C G T\nA 1 0 0\n",
+      "line 4: expected a weight for every column" },
+    { "A C G T\nA 1 0 0 0 0\n", "line 2: more weights than columns" },
+    { "A C G T\nA 1 0 0 0\nA 1 0 0 0\n", "line 3: duplicate row A" },
+    { "A C G A\n", "line 1: duplicate column A" },
+    { "A C G T E\n", "line 1: unsupported symbol E" },
+    { "A C G T -\n", "line 1: unsupported symbol -" },
+    { "AC G T\n", "line 1: unsupported symbol AC" },
+    { "A C G T\nQ 1 0 0 0\n", "line 2: unsupported symbol Q" }
+  };
+
+  int rep(ScoringMatrix::Alphabet alphabet, char symbol)
+  {
+    return alphabet == ScoringMatrix::Nucleotides
+      ? Nucleotide(symbol).intRep() : AminoAcid(symbol).intRep();
+  }
+
+  bool checkWeights(const std::string& name, const ScoringMatrix& matrix,
+		    const Weight *weights, unsigned count)
+  {
+    bool ok = true;
+
+    for (unsigned i = 0; i < count; ++i) {
+      const Weight& w = weights[i];
+      double weight = matrix.weight(rep(matrix.alphabet(), w.symbol1),
+				    rep(matrix.alphabet(), w.symbol2));
+      if (weight != w.weight) {
+	std::cerr << name << ": " << w.symbol1 << " and " << w.symbol2
+		  << ": expected " << w.weight << ", got " << weight
+		  << std::endl;
+	ok = false;
+      }
+    }
+
+    for (int i = 0; i < matrix.size(); ++i)
+      for (int j = 0; j < i; ++j)
+	if (matrix.weight(i, j) != matrix.weight(j, i)) {
+	  std::cerr << name << ": not symmetric in " << i << " and " << j
+		    << std::endl;
+	  ok = false;
+	}
+
+    return ok;
+  }
+
+  /*
+   * Checks that reading the matrix raises a ParseException with the name
+   * and the error.
+   */
+  bool checkError(ScoringMatrix::Alphabet alphabet, std::istream& matrix,
+		  const std::string& name, const std::string& error)
+  {
+    std::string got = "no error";
+    try {
+      ScoringMatrix(alphabet, matrix, name);
+    } catch (ParseException& e) {
+      if (e.name() == name && e.message() == error)
+	return true;
+      got = e.name() + ": " + e.message();
+    }
+
+    std::cerr << name << ": expected " << error << ", got " << got
+	      << std::endl;
+    return false;
+  }
+
+  /*
+   * Checks that loadScoringMatrix() (of the command line options) fails
+   * with the error.
+   */
+  bool checkLoadError(ScoringMatrix::Alphabet alphabet,
+		      const std::string& fileName, const std::string& error)
+  {
+    std::string got = "no error";
+    try {
+      loadScoringMatrix(alphabet, fileName);
+    } catch (std::runtime_error& e) {
+      if (e.what() == error)
+	return true;
+      got = e.what();
+    }
+
+    std::cerr << fileName << ": expected " << error << ", got " << got
+	      << std::endl;
+    return false;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " BLOSUM62 NUC.4.4" << std::endl;
+    return 1;
+  }
+
+  std::string blosum62 = argv[1], nuc44 = argv[2];
+  bool ok = true;
+
+  try {
+    ScoringMatrix aa = loadScoringMatrix(ScoringMatrix::AminoAcids,
+					 blosum62);
+    ok = checkWeights(blosum62, aa, BLOSUM62,
+		      sizeof(BLOSUM62) / sizeof(BLOSUM62[0])) && ok;
+
+    ScoringMatrix nt = loadScoringMatrix(ScoringMatrix::Nucleotides, nuc44);
+    ok = checkWeights(nuc44, nt, NUC_4_4,
+		      sizeof(NUC_4_4) / sizeof(NUC_4_4[0])) && ok;
+
+    /*
+     * The default nucleotide matrix, IUB, is NUC.4.4.
+     */
+    if (loadScoringMatrix(ScoringMatrix::Nucleotides, std::string())
+	!= nt) {
+      std::cerr << nuc44 << ": not the same as the default matrix"
+		<< std::endl;
+      ok = false;
+    }
+  } catch (std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    ok = false;
+  }
+
+  for (unsigned i = 0; i < sizeof(MALFORMED) / sizeof(MALFORMED[0]); ++i) {
+    std::istringstream matrix(MALFORMED[i].matrix);
+    ok = checkError(ScoringMatrix::Nucleotides, matrix,
+		    "malformed " + std::to_string(i), MALFORMED[i].error) && ok;
+  }
+
+  /*
+   * Matrices of the other alphabet: BLOSUM62 has symbols that are not
+   * nucleotides, the symbols of NUC.4.4 are amino acids as well, but not
+   * all of them.
+   */
+  std::ifstream f(nuc44.c_str());
+  ok = checkError(ScoringMatrix::AminoAcids, f, nuc44,
+		  "no weight for A and E") && ok;
+  ok = checkLoadError(ScoringMatrix::Nucleotides, blosum62,
+		      blosum62 + ": line 7: unsupported symbol Q") && ok;
+  ok = checkLoadError(ScoringMatrix::Nucleotides, nuc44 + ".missing",
+		      "Could not open " + nuc44 + ".missing") && ok;
+
+  std::cout << (ok ? "All matrices are read as expected"
+		: "Some matrices are not read as expected") << std::endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * Serves a reference with AlignmentServer on a socket, and checks that
+ * requests sent over the socket get the same response as the request
+ * handled directly, that invalid requests get an error, and that the
+ * server keeps serving requests, also concurrent ones, after errors.
+ *
+ * Usage: ServerRoundTrip reference.xml targets.fasta socket
+ */
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "AlignmentServer.h"
+#include "CLIUtils.h"
+#include "ReferenceSequence.h"
+
+namespace {
+  const int CLIENTS = 4;
+
+  /*
+   * Sends the request to the server on socketPath, returns the response.
+   * The server is started on another thread, and may not be listening
+   * yet.
+   */
+  std::string send(const std::string& socketPath, const std::string& request)
+  {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, socketPath.c_str());
+
+    int fd = -1;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (connect(fd, (sockaddr *)&address, sizeof(address)) == 0)
+	break;
+      close(fd);
+      fd = -1;
+      usleep(50000);
+    }
+
+    if (fd < 0)
+      return "Could not connect to " + socketPath;
+
+    const char *p = request.data();
+    size_t left = request.size();
+    while (left > 0) {
+      ssize_t n = write(fd, p, left);
+      if (n <= 0)
+	break;
+      p += n;
+      left -= n;
+    }
+    shutdown(fd, SHUT_WR);
+
+    std::string response;
+    char buf[65536];
+    for (;;) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n <= 0)
+	break;
+      response.append(buf, n);
+    }
+    close(fd);
+
+    return response;
+  }
+
+  std::string handle(AlignmentServer& server, const std::string& request)
+  {
+    std::istringstream in(request);
+    std::ostringstream out;
+    server.handle(in, out);
+    return out.str();
+  }
+
+  bool check(const std::string& what, const std::string& response,
+	     const std::string& expected)
+  {
+    if (response != expected) {
+      std::cerr << what << ": expected" << std::endl << expected
+		<< "got" << std::endl << response << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  bool checkError(AlignmentServer& server, const std::string& socketPath,
+		  const std::string& request)
+  {
+    std::string response = send(socketPath, request);
+    if (response.compare(0, 7, "Error: ") != 0
+	|| response.find('\n') != response.size() - 1) {
+      std::cerr << request << ": expected an error, got" << std::endl
+		<< response << std::endl;
+      return false;
+    }
+
+    return check(request, response, handle(server, request));
+  }
+
+  void sendConcurrently(const std::string *socketPath,
+			const std::string *request, std::string *response)
+  {
+    *response = send(*socketPath, *request);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+	      << " reference.xml targets.fasta socket" << std::endl;
+    return 1;
+  }
+
+  ReferenceSequence reference
+    = ReferenceSequence::parseOrfReferenceFile(argv[1]);
+
+  std::ifstream f(argv[2]);
+  std::stringstream targets;
+  targets << f.rdbuf();
+
+  std::string socketPath = argv[3];
+
+  /*
+   * The server serves until the process exits: it is never destroyed,
+   * as its workers keep waiting for connections.
+   */
+  AlignmentServer& server
+    = *new AlignmentServer(reference, 10.0, 3.3, 3, 0,
+			   loadScoringMatrix(seq::ScoringMatrix::Nucleotides,
+					     std::string()),
+			   loadScoringMatrix(seq::ScoringMatrix::AminoAcids,
+					     std::string()));
+  std::thread(&AlignmentServer::serve, &server, socketPath, 2u).detach();
+
+  bool ok = true;
+
+  std::vector<std::string> requests;
+  requests.push_back(targets.str());
+  requests.push_back("# --exportKind PositionTable --exportAlphabet "
+		     "Nucleotides\n" + targets.str());
+  requests.push_back("# --exportKind PositionTable --exportFormat Arrow\n"
+		     + targets.str());
+  requests.push_back("# --exportKind MutationTable\n" + targets.str());
+
+  std::vector<std::string> expected;
+  for (unsigned i = 0; i < requests.size(); ++i) {
+    expected.push_back(handle(server, requests[i]));
+    ok = check("request " + std::to_string(i),
+	       send(socketPath, requests[i]), expected[i]) && ok;
+  }
+
+  if (expected[0].compare(0, 5, "seqid") != 0) {
+    std::cerr << "not a Mutations export:" << std::endl << expected[0];
+    ok = false;
+  }
+
+  ok = checkError(server, socketPath, "# --exportKind\n") && ok;
+  ok = checkError(server, socketPath, "# --exportKind Unknown\n") && ok;
+  ok = checkError(server, socketPath, "# --unknown Mutations\n") && ok;
+  ok = checkError(server, socketPath, "# --exportFormat Arrow\n"
+		  + targets.str()) && ok;
+
+  /*
+   * More concurrent requests than workers, after the errors.
+   */
+  std::vector<std::string> responses(CLIENTS);
+  std::vector<std::thread> clients;
+  for (int c = 0; c < CLIENTS; ++c)
+    clients.push_back(std::thread(&sendConcurrently, &socketPath,
+				  &requests[c % requests.size()],
+				  &responses[c]));
+
+  for (int c = 0; c < CLIENTS; ++c) {
+    clients[c].join();
+    ok = check("concurrent request " + std::to_string(c), responses[c],
+	       expected[c % requests.size()]) && ok;
+  }
+
+  unlink(socketPath.c_str());
+
+  std::cout << (ok ? "All responses are as expected"
+		: "Some responses differ") << std::endl;
+
+  return ok ? 0 : 1;
+}
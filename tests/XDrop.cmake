@@ -0,0 +1,25 @@
+# Aligns TARGETS against REFERENCE with VIRULIGN, with and without
+# X-drop, and checks that the Mutations exports are identical: X-drop
+# only saves work. The targets are a nearly identical target that starts
+# deep in the reference, which must be aligned, and chimeras, which must
+# not be.
+
+INCLUDE(${CMAKE_CURRENT_LIST_DIR}/RunVirulign.cmake)
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+
+run_virulign(mutations ${REFERENCE} ${TARGETS} --exportKind Mutations)
+FILE(READ ${WORK_DIR}/mutations mutations)
+
+IF(NOT mutations MATCHES "\ndeep,Success,")
+  MESSAGE(FATAL_ERROR "the deep target was not aligned")
+ENDIF()
+
+FOREACH(xDrop 50 150 300)
+  run_virulign(mutations.${xDrop}
+               ${REFERENCE} ${TARGETS} --exportKind Mutations --xDrop ${xDrop})
+  FILE(READ ${WORK_DIR}/mutations.${xDrop} xDropMutations)
+  IF(NOT mutations STREQUAL xDropMutations)
+    MESSAGE(FATAL_ERROR "--xDrop ${xDrop}: the Mutations export differs")
+  ENDIF()
+ENDFOREACH()